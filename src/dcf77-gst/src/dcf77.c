@@ -247,9 +247,7 @@ dcf77_chain (GstPad * pad, GstBuffer * buf)
   gint16 *data;
   gint32 samples;
   gint16 *sample;
-  gboolean high_level;
-  gint32 i;
-  gboolean resync;
+  gint result;
   const gchar *eval_retval;
 
   filter = DCF77 (GST_OBJECT_PARENT (pad));
@@ -280,104 +278,28 @@ dcf77_chain (GstPad * pad, GstBuffer * buf)
 
       if (filter->calibration_cycles <= 0)
       {
-        filter->threshold = filter->calibration_highest * 0.7;
+        filter->core.threshold = filter->calibration_highest * 0.7;
         init_get_time (filter);
       }
     break;
 
 
     case DCF77_STATE_GET_TIME:
-      resync = FALSE;
+      result = dcf77_core_get_time (&filter->core, sample, samples);
 
-      if (filter->frames_since_last_min_pulse >= 0)
-        filter->frames_since_last_min_pulse += samples;
-
-      for (i = 0; i < (samples - (samples % 4)); i += 4)
+      if (result & DCF77_CORE_MINUTE_PULSE)
       {
-        high_level = (*sample >= filter->threshold
-                     || *(sample + 1) >= filter->threshold
-                     || *(sample + 2) >= filter->threshold
-                     || *(sample + 3) >= filter->threshold) ? TRUE : FALSE;
-        if (high_level != filter->last_level)
+        eval_retval = eval_min_pulse (filter);
+        if (eval_retval && filter->verbose)
+          g_message ("%s", eval_retval);
+        else
         {
-          const float ms_since_last_pulse = (float)((filter->frames_since_last_pulse + i) * 1000.0 / 48000);
-          
-          filter->last_level = high_level;          
-          
-          if (  (-1 == filter->last_bit && ms_since_last_pulse >  60.0 && ms_since_last_pulse < 140.0)  /* ~ 100 ms */
-              ||(-1 == filter->last_bit && ms_since_last_pulse > 160.0 && ms_since_last_pulse < 240.0)  /* ~ 200 ms */
-             )
-          {
-            filter->last_bit = (ms_since_last_pulse < 150.0) ? 0 : 1;
-            /* DCF bits 28 .. 0: add 1 new bit from Hi and shift old bits */
-            filter->value_mask_low = ((filter->value_mask_high & 1) << 28) | (filter->value_mask_low >> 1);
-            filter->valid_mask_low = ((filter->valid_mask_high & 1) << 28) | (filter->valid_mask_low >> 1);
-            /* DCF bits 58 .. 29 == 29 .. 0: add 1 new bit and shift old bits */
-            filter->value_mask_high = (filter->last_bit << 29) | (filter->value_mask_high >> 1);
-            filter->valid_mask_high = (1 << 29) | (filter->valid_mask_high >> 1);
-
-            filter->diff_frames[filter->diff_index] = filter->frames_since_last_pulse + i;
-            filter->diff_index = 1 - filter->diff_index;
-            filter->frames_since_last_pulse = - (int)i;
-          }
-          else if (  (0 == filter->last_bit && ms_since_last_pulse > 860.0 && ms_since_last_pulse < 940.0)  /* ~ 900 ms */
-                   ||(1 == filter->last_bit && ms_since_last_pulse > 760.0 && ms_since_last_pulse < 840.0)  /* ~ 800 ms */
-                  )
-          {
-            filter->last_bit = -1;   /* after 100 ms or 200 ms Pulse at Second pulse */
-
-            filter->diff_frames[filter->diff_index] = filter->frames_since_last_pulse + i;
-            filter->diff_index = 1 - filter->diff_index;
-            filter->frames_since_last_pulse = - i;
-          }
-          else if (  (0 == filter->last_bit && ms_since_last_pulse > 1860.0 && ms_since_last_pulse < 1940.0)  /* ~ 1900 ms */
-                   ||(1 == filter->last_bit && ms_since_last_pulse > 1760.0 && ms_since_last_pulse < 1840.0)  /* ~ 1800 ms */
-                  )
-          {
-            filter->last_bit = -1; /* after 100 ms or 200 ms Pulse at Minute pulse */
-            filter->frames_since_last_min_pulse = 48000 - i;
-            filter->eval_value_mask_low = filter->value_mask_low;
-            filter->eval_valid_mask_low = filter->valid_mask_low;
-            filter->eval_value_mask_high = filter->value_mask_high;
-            filter->eval_valid_mask_high = filter->valid_mask_high;
-            filter->diff_frames[filter->diff_index] = filter->frames_since_last_pulse + i;
-            filter->diff_index = 1 - filter->diff_index;
-            filter->frames_since_last_pulse = - i;
-            
-            eval_retval = eval_min_pulse (filter);
-            if (eval_retval && filter->verbose)
-              g_message ("%s", eval_retval);
-            else
-            {
-//              printf ("%i:%i\n", filter->tms.tm_hour, filter->tms.tm_min);
-              g_signal_emit (G_OBJECT (filter), dcf77_signals[SIGNAL_MINUTE_PULSE], 0);
-            }
-          }
-          else if (ms_since_last_pulse >= 20000.0 && ms_since_last_pulse < 50000.0)  /* initial pulse search? */
-          {
-            filter->last_bit = -1;   /* ignore */
-            filter->frames_since_last_pulse = - i;
-          }
-          else if ( -1 == filter->last_bit && ms_since_last_pulse < 30.0 )
-          {
-            /* filter noise! */
-            filter->last_bit = -1;
-          }
-          else
-          {
-            resync = TRUE;
-            filter->last_bit = -1;
-            filter->frames_since_last_pulse = - i;
-          }
+//          printf ("%i:%i\n", filter->tms.tm_hour, filter->tms.tm_min);
+          g_signal_emit (G_OBJECT (filter), dcf77_signals[SIGNAL_MINUTE_PULSE], 0);
         }
-        sample += 4;
-      } /* end for */
-      filter->frames_since_last_pulse += samples;
-
-      if (( filter->frames_since_last_pulse > 10.0 * 48000
-          && filter->frames_since_last_pulse < 20.0 * 48000)
-          || resync
-         )
+      }
+
+      if (result & DCF77_CORE_RESYNC)
       {
         init_get_threshold(filter);
       }
@@ -431,25 +353,7 @@ init_get_time (Dcf77 *filter)
   filter->state = DCF77_STATE_GET_TIME;
   filter->frame_index = 0;
 
-  filter->diff_frames[0] = 0;
-  filter->diff_frames[1] = 0;
-  
-  filter->diff_index = 0;
-  filter->last_level = FALSE;
-  filter->frames_since_last_min_pulse = -1;
-  filter->frames_since_last_pulse = 21 * 48000;
-
-  filter->last_bit = -1;
-
-  filter->value_mask_low = 0;
-  filter->valid_mask_low = 0;
-  filter->value_mask_high = 0;
-  filter->valid_mask_high = 0;
-
-  filter->eval_value_mask_low = 0;
-  filter->eval_valid_mask_low = 0;
-  filter->eval_value_mask_high = 0;
-  filter->eval_valid_mask_high = 0;
+  dcf77_core_init_get_time (&filter->core);
 }
 
 
@@ -467,8 +371,8 @@ eval_min_pulse(Dcf77 *filter)
   // 876543210987654321098765432109
   // 111111111111111111111111111111 == 0x3FFFFFFF == ValidMaskHi
 
-  //int DST_change    = ( (filter->eval_value_mask_low >> 16) & 0x01);
-//  int TimeZone      = ( (filter->eval_value_mask_low >> 17) & 0x03);
+  //int DST_change    = ( (filter->core.eval_value_mask_low >> 16) & 0x01);
+//  int TimeZone      = ( (filter->core.eval_value_mask_low >> 17) & 0x03);
 
 
   guint8 MinuteBCDLo, MinuteBCDHi, ParityMinute, Minute;
@@ -482,76 +386,76 @@ eval_min_pulse(Dcf77 *filter)
 
   filter->tms_is_valid = FALSE;
 
-  MinuteBCDLo   = ( (filter->eval_value_mask_low >> 21) & 0x0f);
-  MinuteBCDHi   = ( (filter->eval_value_mask_low >> 25) & 0x07);
-  ParityMinute  = ( (filter->eval_value_mask_low >> 21)  // 21 Start Minute
-                   ^ (filter->eval_value_mask_low >> 22)  // 22
-                   ^ (filter->eval_value_mask_low >> 23)  // 23
-                   ^ (filter->eval_value_mask_low >> 24)  // 24
-                   ^ (filter->eval_value_mask_low >> 25)  // 25
-                   ^ (filter->eval_value_mask_low >> 26)  // 26
-                   ^ (filter->eval_value_mask_low >> 27)  // 27 End Minute
-                   ^ (filter->eval_value_mask_low >> 28)  // 28 Parity Minute
+  MinuteBCDLo   = ( (filter->core.eval_value_mask_low >> 21) & 0x0f);
+  MinuteBCDHi   = ( (filter->core.eval_value_mask_low >> 25) & 0x07);
+  ParityMinute  = ( (filter->core.eval_value_mask_low >> 21)  // 21 Start Minute
+                   ^ (filter->core.eval_value_mask_low >> 22)  // 22
+                   ^ (filter->core.eval_value_mask_low >> 23)  // 23
+                   ^ (filter->core.eval_value_mask_low >> 24)  // 24
+                   ^ (filter->core.eval_value_mask_low >> 25)  // 25
+                   ^ (filter->core.eval_value_mask_low >> 26)  // 26
+                   ^ (filter->core.eval_value_mask_low >> 27)  // 27 End Minute
+                   ^ (filter->core.eval_value_mask_low >> 28)  // 28 Parity Minute
                   ) & 1;
   Minute = MinuteBCDLo + 10 * MinuteBCDHi;
 
-  HourBCDLo     = ( (filter->eval_value_mask_high      ) & 0x0f);
-  HourBCDHi     = ( (filter->eval_value_mask_high >>  4) & 0x03);
-  ParityHour    = ( (filter->eval_value_mask_high)        // 29 Start Hour
-                   ^ (filter->eval_value_mask_high >>  1)  // 30
-                   ^ (filter->eval_value_mask_high >>  2)  // 31
-                   ^ (filter->eval_value_mask_high >>  3)  // 32
-                   ^ (filter->eval_value_mask_high >>  4)  // 33
-                   ^ (filter->eval_value_mask_high >>  5)  // 34 End Hour
-                   ^ (filter->eval_value_mask_high >>  6)  // 35 Parity Hour
+  HourBCDLo     = ( (filter->core.eval_value_mask_high      ) & 0x0f);
+  HourBCDHi     = ( (filter->core.eval_value_mask_high >>  4) & 0x03);
+  ParityHour    = ( (filter->core.eval_value_mask_high)        // 29 Start Hour
+                   ^ (filter->core.eval_value_mask_high >>  1)  // 30
+                   ^ (filter->core.eval_value_mask_high >>  2)  // 31
+                   ^ (filter->core.eval_value_mask_high >>  3)  // 32
+                   ^ (filter->core.eval_value_mask_high >>  4)  // 33
+                   ^ (filter->core.eval_value_mask_high >>  5)  // 34 End Hour
+                   ^ (filter->core.eval_value_mask_high >>  6)  // 35 Parity Hour
                   ) & 1;
   Hour = HourBCDLo + 10 * HourBCDHi;
 
-  DayBCDLo      = ( (filter->eval_value_mask_high >>  7) & 0x0f);
-  DayBCDHi      = ( (filter->eval_value_mask_high >> 11) & 0x03);
-  Weekday       = ( (filter->eval_value_mask_high >> 13) & 0x07);  // 1 .. 7
-  MonthBCDLo    = ( (filter->eval_value_mask_high >> 16) & 0x0f);
-  MonthBCDHi    = ( (filter->eval_value_mask_high >> 20) & 0x01);
-  YearBCDLo     = ( (filter->eval_value_mask_high >> 21) & 0x0f);
-  YearBCDHi     = ( (filter->eval_value_mask_high >> 25) & 0x0f);
+  DayBCDLo      = ( (filter->core.eval_value_mask_high >>  7) & 0x0f);
+  DayBCDHi      = ( (filter->core.eval_value_mask_high >> 11) & 0x03);
+  Weekday       = ( (filter->core.eval_value_mask_high >> 13) & 0x07);  // 1 .. 7
+  MonthBCDLo    = ( (filter->core.eval_value_mask_high >> 16) & 0x0f);
+  MonthBCDHi    = ( (filter->core.eval_value_mask_high >> 20) & 0x01);
+  YearBCDLo     = ( (filter->core.eval_value_mask_high >> 21) & 0x0f);
+  YearBCDHi     = ( (filter->core.eval_value_mask_high >> 25) & 0x0f);
 
   Day           = DayBCDLo    + 10 * DayBCDHi;
   Month         = MonthBCDLo  + 10 * MonthBCDHi;
   Century       = 20;
   Year          = YearBCDLo   + 10 * YearBCDHi;
-  ParityDate    = ( (filter->eval_value_mask_high >>  7)      // 36 Start Day
-                   ^ (filter->eval_value_mask_high >>  8)      // 37
-                   ^ (filter->eval_value_mask_high >>  9)      // 38
-                   ^ (filter->eval_value_mask_high >> 10)      // 39
-                   ^ (filter->eval_value_mask_high >> 11)      // 40
-                   ^ (filter->eval_value_mask_high >> 12)      // 41 End Day
-                   ^ (filter->eval_value_mask_high >> 13)      // 42 Start Weekday
-                   ^ (filter->eval_value_mask_high >> 14)      // 43
-                   ^ (filter->eval_value_mask_high >> 15)      // 44 End Weekday
-                   ^ (filter->eval_value_mask_high >> 16)      // 45 Start Month
-                   ^ (filter->eval_value_mask_high >> 17)      // 46
-                   ^ (filter->eval_value_mask_high >> 18)      // 47
-                   ^ (filter->eval_value_mask_high >> 19)      // 48
-                   ^ (filter->eval_value_mask_high >> 20)      // 49 End Month
-                   ^ (filter->eval_value_mask_high >> 21)      // 50 Start Year
-                   ^ (filter->eval_value_mask_high >> 22)      // 51
-                   ^ (filter->eval_value_mask_high >> 23)      // 52
-                   ^ (filter->eval_value_mask_high >> 24)      // 53
-                   ^ (filter->eval_value_mask_high >> 25)      // 54
-                   ^ (filter->eval_value_mask_high >> 26)      // 55
-                   ^ (filter->eval_value_mask_high >> 27)      // 56
-                   ^ (filter->eval_value_mask_high >> 28)      // 57 End Year
-                   ^ (filter->eval_value_mask_high >> 29)      // 58 Parity Year
+  ParityDate    = ( (filter->core.eval_value_mask_high >>  7)      // 36 Start Day
+                   ^ (filter->core.eval_value_mask_high >>  8)      // 37
+                   ^ (filter->core.eval_value_mask_high >>  9)      // 38
+                   ^ (filter->core.eval_value_mask_high >> 10)      // 39
+                   ^ (filter->core.eval_value_mask_high >> 11)      // 40
+                   ^ (filter->core.eval_value_mask_high >> 12)      // 41 End Day
+                   ^ (filter->core.eval_value_mask_high >> 13)      // 42 Start Weekday
+                   ^ (filter->core.eval_value_mask_high >> 14)      // 43
+                   ^ (filter->core.eval_value_mask_high >> 15)      // 44 End Weekday
+                   ^ (filter->core.eval_value_mask_high >> 16)      // 45 Start Month
+                   ^ (filter->core.eval_value_mask_high >> 17)      // 46
+                   ^ (filter->core.eval_value_mask_high >> 18)      // 47
+                   ^ (filter->core.eval_value_mask_high >> 19)      // 48
+                   ^ (filter->core.eval_value_mask_high >> 20)      // 49 End Month
+                   ^ (filter->core.eval_value_mask_high >> 21)      // 50 Start Year
+                   ^ (filter->core.eval_value_mask_high >> 22)      // 51
+                   ^ (filter->core.eval_value_mask_high >> 23)      // 52
+                   ^ (filter->core.eval_value_mask_high >> 24)      // 53
+                   ^ (filter->core.eval_value_mask_high >> 25)      // 54
+                   ^ (filter->core.eval_value_mask_high >> 26)      // 55
+                   ^ (filter->core.eval_value_mask_high >> 27)      // 56
+                   ^ (filter->core.eval_value_mask_high >> 28)      // 57 End Year
+                   ^ (filter->core.eval_value_mask_high >> 29)      // 58 Parity Year
                   ) & 1;
 
 
 
 
-  if ((filter->eval_valid_mask_low & 0x1FF70000) != 0x1FF70000
-      || (filter->eval_valid_mask_high & 0x3FFFFFFF) != 0x3FFFFFFF)
+  if ((filter->core.eval_valid_mask_low & 0x1FF70000) != 0x1FF70000
+      || (filter->core.eval_valid_mask_high & 0x3FFFFFFF) != 0x3FFFFFFF)
     return "Error: Not enough bits collected\0";
 
-  if ((filter->eval_value_mask_low & 0x100000) != 0x100000)
+  if ((filter->core.eval_value_mask_low & 0x100000) != 0x100000)
     return "Error: Startbit 20 not set\0";
 
 
@@ -27,6 +27,8 @@
 #include <time.h>
 #include <gst/gst.h>
 
+#include "dcf77core.h"
+
 G_BEGIN_DECLS
 
 
@@ -63,30 +65,13 @@ struct _Dcf77
   gint32   calibration_cycles;
   gint32   calibration_highest;
   gint32   calibration_mean;
-  gint16   threshold;
   gint32   last_rising_edge;
   
   
   guint32  sample_rate;
   guint32  frame_index;
 
-  guint32  diff_frames[2];
-  guint32  diff_index;
-  
-  gboolean last_level;
-  gint32   frames_since_last_min_pulse;
-  gint32   frames_since_last_pulse;
-  gint8    last_bit;
-  
-  guint32  value_mask_low;  /* DCF bits 28 .. 0 */
-  guint32  valid_mask_low;
-  guint32  value_mask_high;  /* DCF bits 58 .. 29 */
-  guint32  valid_mask_high;
-  
-  guint32  eval_value_mask_low;  /* DCF bits 28 .. 0 */
-  guint32  eval_valid_mask_low;
-  guint32  eval_value_mask_high;  /* DCF bits 58 .. 29 */
-  guint32  eval_valid_mask_high;
+  Dcf77Core core;
 
   struct tm tms;
   gboolean tms_is_valid;
@@ -0,0 +1,142 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Detlef Reichl <detlef!reichl()gmx!org>
+ *                    Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser General Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77core.h"
+
+
+void
+dcf77_core_init_get_time (Dcf77Core *core)
+{
+  core->diff_frames[0] = 0;
+  core->diff_frames[1] = 0;
+  
+  core->diff_index = 0;
+  core->last_level = 0;
+  core->frames_since_last_min_pulse = -1;
+  core->frames_since_last_pulse = 21 * 48000;
+
+  core->last_bit = -1;
+
+  core->value_mask_low = 0;
+  core->valid_mask_low = 0;
+  core->value_mask_high = 0;
+  core->valid_mask_high = 0;
+
+  core->eval_value_mask_low = 0;
+  core->eval_valid_mask_low = 0;
+  core->eval_value_mask_high = 0;
+  core->eval_valid_mask_high = 0;
+}
+
+
+int
+dcf77_core_get_time (Dcf77Core *core, const short *sample, int samples)
+{
+  int high_level;
+  int i;
+  int result = 0;
+
+  if (core->frames_since_last_min_pulse >= 0)
+    core->frames_since_last_min_pulse += samples;
+
+  for (i = 0; i < (samples - (samples % 4)); i += 4)
+  {
+    high_level = (*sample >= core->threshold
+                 || *(sample + 1) >= core->threshold
+                 || *(sample + 2) >= core->threshold
+                 || *(sample + 3) >= core->threshold) ? 1 : 0;
+    if (high_level != core->last_level)
+    {
+      const float ms_since_last_pulse = (float)((core->frames_since_last_pulse + i) * 1000.0 / 48000);
+      
+      core->last_level = high_level;          
+      
+      if (  (-1 == core->last_bit && ms_since_last_pulse >  60.0 && ms_since_last_pulse < 140.0)  /* ~ 100 ms */
+          ||(-1 == core->last_bit && ms_since_last_pulse > 160.0 && ms_since_last_pulse < 240.0)  /* ~ 200 ms */
+         )
+      {
+        core->last_bit = (ms_since_last_pulse < 150.0) ? 0 : 1;
+        /* DCF bits 28 .. 0: add 1 new bit from Hi and shift old bits */
+        core->value_mask_low = ((core->value_mask_high & 1) << 28) | (core->value_mask_low >> 1);
+        core->valid_mask_low = ((core->valid_mask_high & 1) << 28) | (core->valid_mask_low >> 1);
+        /* DCF bits 58 .. 29 == 29 .. 0: add 1 new bit and shift old bits */
+        core->value_mask_high = (core->last_bit << 29) | (core->value_mask_high >> 1);
+        core->valid_mask_high = (1 << 29) | (core->valid_mask_high >> 1);
+
+        core->diff_frames[core->diff_index] = core->frames_since_last_pulse + i;
+        core->diff_index = 1 - core->diff_index;
+        core->frames_since_last_pulse = - (int)i;
+      }
+      else if (  (0 == core->last_bit && ms_since_last_pulse > 860.0 && ms_since_last_pulse < 940.0)  /* ~ 900 ms */
+               ||(1 == core->last_bit && ms_since_last_pulse > 760.0 && ms_since_last_pulse < 840.0)  /* ~ 800 ms */
+              )
+      {
+        core->last_bit = -1;   /* after 100 ms or 200 ms Pulse at Second pulse */
+
+        core->diff_frames[core->diff_index] = core->frames_since_last_pulse + i;
+        core->diff_index = 1 - core->diff_index;
+        core->frames_since_last_pulse = - i;
+      }
+      else if (  (0 == core->last_bit && ms_since_last_pulse > 1860.0 && ms_since_last_pulse < 1940.0)  /* ~ 1900 ms */
+               ||(1 == core->last_bit && ms_since_last_pulse > 1760.0 && ms_since_last_pulse < 1840.0)  /* ~ 1800 ms */
+              )
+      {
+        core->last_bit = -1; /* after 100 ms or 200 ms Pulse at Minute pulse */
+        core->frames_since_last_min_pulse = 48000 - i;
+        core->eval_value_mask_low = core->value_mask_low;
+        core->eval_valid_mask_low = core->valid_mask_low;
+        core->eval_value_mask_high = core->value_mask_high;
+        core->eval_valid_mask_high = core->valid_mask_high;
+        core->diff_frames[core->diff_index] = core->frames_since_last_pulse + i;
+        core->diff_index = 1 - core->diff_index;
+        core->frames_since_last_pulse = - i;
+
+        result |= DCF77_CORE_MINUTE_PULSE;
+      }
+      else if (ms_since_last_pulse >= 20000.0 && ms_since_last_pulse < 50000.0)  /* initial pulse search? */
+      {
+        core->last_bit = -1;   /* ignore */
+        core->frames_since_last_pulse = - i;
+      }
+      else if ( -1 == core->last_bit && ms_since_last_pulse < 30.0 )
+      {
+        /* filter noise! */
+        core->last_bit = -1;
+      }
+      else
+      {
+        result |= DCF77_CORE_RESYNC;
+        core->last_bit = -1;
+        core->frames_since_last_pulse = - i;
+      }
+    }
+    sample += 4;
+  } /* end for */
+  core->frames_since_last_pulse += samples;
+
+  if ( core->frames_since_last_pulse > 10.0 * 48000
+      && core->frames_since_last_pulse < 20.0 * 48000)
+    result |= DCF77_CORE_RESYNC;
+
+  return result;
+}
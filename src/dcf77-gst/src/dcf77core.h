@@ -0,0 +1,73 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Detlef Reichl <detlef!reichl()gmx!org>
+ *                    Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser General Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __DCF77_CORE_H__
+#define __DCF77_CORE_H__
+
+/* GStreamer independent part of dcf77_chain for DCF77_STATE_GET_TIME:
+ * pulse detection on 16 bit mono samples at 48000 Hz.
+ * Used by the element and by benchmarks without GStreamer. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _Dcf77Core Dcf77Core;
+
+struct _Dcf77Core
+{
+  short     threshold;
+
+  unsigned  diff_frames[2];
+  unsigned  diff_index;
+
+  int       last_level;
+  int       frames_since_last_min_pulse;
+  int       frames_since_last_pulse;
+  signed char last_bit;
+
+  unsigned  value_mask_low;  /* DCF bits 28 .. 0 */
+  unsigned  valid_mask_low;
+  unsigned  value_mask_high;  /* DCF bits 58 .. 29 */
+  unsigned  valid_mask_high;
+
+  unsigned  eval_value_mask_low;  /* DCF bits 28 .. 0 */
+  unsigned  eval_valid_mask_low;
+  unsigned  eval_value_mask_high;  /* DCF bits 58 .. 29 */
+  unsigned  eval_valid_mask_high;
+};
+
+/* result flags of dcf77_core_get_time() */
+#define DCF77_CORE_MINUTE_PULSE   1   /* eval_*_mask hold a complete minute */
+#define DCF77_CORE_RESYNC         2   /* lost sync: restart calibration */
+
+void  dcf77_core_init_get_time  (Dcf77Core *core);
+int   dcf77_core_get_time       (Dcf77Core *core,
+                                 const short *sample,
+                                 int samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DCF77_CORE_H__ */
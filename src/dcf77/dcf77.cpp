@@ -23,6 +23,9 @@
 
 #include "dcf77.h"
 
+#include <math.h>
+#include <string.h>
+
 
 DCF77::DCF77()
 {
@@ -32,12 +35,46 @@ DCF77::DCF77()
   ChanIdx = 0;
   FramesPerBuffer = 480; // = 10 * 48000 / 1000 == 10 ms
   frameIndex = 0;
+  TotalFrames = 0;
+  LastAdcTime = 0.0;
+  LastAdcFrame = -1;
+  SecEdgeFrame = -1;
+  MinEdgeFrame = -1;
+  FastFix = false;
+  Hysteresis = 0.3F;
+  DebounceMs = 0.5F;
+  AdaptiveWindows = true;
+  MLBits = false;
+  PulseOffsetMs = 0.0F;
+  PulseSigmaMs[0] = PulseSigmaMs[1] = 10.0F;
+  GapSigmaMs = 10.0F;
+  LastPulseMs = 0.0F;
+  UseTrellis = false;
+  Invert = false;
+  PulseCount[0] = PulseCount[1] = 0;
+  GapCount = 0;
+  memset( PulseHist, 0, sizeof(PulseHist) );
+  PulseHistSum = 0.0F;
+  PrnCorrValid = false;
+  PrnCorrFrames = 0.0;
+  PrnEpochFrame = -1.0;
+  FramesSinceLastMinPulse = -1;
+  EvaluatedMinPulse = true;
 
   aiDiffFrames[0] = aiDiffFrames[1] = 0;
   iDiffIdx = 0;
   PrintDiff = 0;
 
   SetSysTime = 0;
+  EvalError = EVAL_ERR_BITS_MISSING;
+
+  MeasuredRate = 0.0;
+  MeasuredRatePpm = 0.0;
+  RateMinSpan = 60.0;
+  RateWindow = 3600.0;
+  RateRefFrame = -1;
+  RateOutliers = 0;
+  RateKeepOld = false;
 
   initGetThreshold();
 }
@@ -56,12 +93,34 @@ void DCF77::initGetThreshold()
   Max = -1.0F;
   ThreshStartMessage = true;
   ThreshFinishMessage = false;
+  PrnCorrValid = false;
+  PrnEpochFrame = -1.0;
+}
+
+void DCF77::warmStart( float mean, float max, float threshold, float thresholdLow )
+{
+  Mean = mean;
+  Max = max;
+  Threshold = threshold;
+  ThresholdLow = thresholdLow;
+  // learned statistics are worth some pulses
+  PulseCount[0] = PulseCount[1] = GapCount = 16;
+  ThreshStartMessage = false;
+  ThreshFinishMessage = false;
+  initGetTime();
 }
 
 void DCF77::initGetTime()
 {
   frameIndex = 0;
   LastSample = 2.0F;
+  CmpHigh = true;       // first edge after a low phase
+  CmpPending = false;
+  CmpPendingAt = 0;
+  CmpDwell = 0;
+  DebounceFrames = (unsigned)( DebounceMs * 1E-3 * SampleRate + 0.5 );
+  if ( !DebounceFrames )
+    DebounceFrames = 1;
   FramesSinceLastPulse = (int)( 0.5 + 20.0 * SampleRate );
   FramesSinceLastMinPulse = -1;
   EvaluatedMinPulse = true;
@@ -76,15 +135,55 @@ void DCF77::initGetTime()
   EvalValueMaskHi = 0;
   EvalValidMaskHi = 0;
 
+  SecInMinute = -1;
+  CurValueMaskLo = CurValidMaskLo = 0;
+  CurValueMaskHi = CurValidMaskHi = 0;
+  FastFixPending = false;
+  FastFixDone = false;
+
   eState = STATE_GET_TIME;
 }
 
 
+const char * DCF77::evalErrorText( int evalError )
+{
+  static const char * ErrTxt[] =
+  {   "OK"
+    , "Not enough bits collected"
+    , "Startbit 20 not set"
+    , "TimeZone neither MEZ nor MESZ"
+    , "Defect Parity for Minute"
+    , "Lower digit for Minute not in range 0 .. 9"
+    , "Higher digit for Minute not in range 0 .. 5"
+    , "Defect Parity for Hour"
+    , "Lower digit for Hour not in range 0 .. 9"
+    , "Higher digit for Hour not in range 0 .. 2"
+    , "Hour not in range 0 .. 23"
+    , "Defect Parity for Date"
+    , "Lower digit for Day not in range 0 .. 9"
+    , "Higher digit for Day not in range 0 .. 2"
+    , "Day not in range 1 .. 31"
+    , "Weekday not in range 1 .. 7"
+    , "Lower digit for Month not in range 0 .. 9"
+    , "Higher digit for Month not in range 0 .. 1"
+    , "Month not in range 1 .. 12"
+    , "Lower digit for Year not in range 0 .. 9"
+    , "Higher digit for Year not in range 0 .. 9"
+  };
+
+  if ( evalError < 0 || evalError >= (int)( sizeof(ErrTxt) / sizeof(ErrTxt[0]) ) )
+    return "Unknown error";
+  return ErrTxt[evalError];
+}
+
+
 bool DCF77::evalMinPulse(struct tm * tms, int * DCF_TZ_idx, FILE * errstream)
 {
   // assume error
   bool retval = false;
 
+  snapMinEdgeToPrn();
+
   // Lo: 28 .. 0
   // 22222222211111111110000000000
   // 87654321098765432109876543210
@@ -163,103 +262,84 @@ bool DCF77::evalMinPulse(struct tm * tms, int * DCF_TZ_idx, FILE * errstream)
   if ( (EvalValidMaskLo & 0x1FF70000) != 0x1FF70000
     || (EvalValidMaskHi & 0x3FFFFFFF) != 0x3FFFFFFF )
   {
-    /* fprintf(errstream, "Error: Not enough bits collected\n"); */
+    EvalError = EVAL_ERR_BITS_MISSING;
   }
   else if ( (EvalValueMaskLo &   0x100000) != 0x100000 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Startbit 20 not set\n");
+    EvalError = EVAL_ERR_STARTBIT;
   }
   else if ( 0 == TimeZone || 3 == TimeZone )
   {
-    if (errstream)
-      fprintf(errstream, "Error: TimeZone neither MEZ nor MESZ\n");
+    EvalError = EVAL_ERR_TIMEZONE;
   }
   else if ( 0 != ParityMinute )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Defect Parity for Minute\n");
+    EvalError = EVAL_ERR_PARITY_MINUTE;
   }
   else if ( MinuteBCDLo < 0 || MinuteBCDLo > 9 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Lower digit for Minute not in range 0 .. 9\n");
+    EvalError = EVAL_ERR_MINUTE_LO;
   }
   else if ( MinuteBCDHi < 0 || MinuteBCDHi >= 6 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Higher digit for Minute not in range 0 .. 5\n");
+    EvalError = EVAL_ERR_MINUTE_HI;
   }
   else if ( 0 != ParityHour )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Defect Parity for Hour\n");
+    EvalError = EVAL_ERR_PARITY_HOUR;
   }
   else if ( HourBCDLo < 0 || HourBCDLo > 9 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Lower digit for Hour not in range 0 .. 9\n");
+    EvalError = EVAL_ERR_HOUR_LO;
   }
   else if ( HourBCDHi < 0 || HourBCDHi >= 3 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Higher digit for Hour not in range 0 .. 2\n");
+    EvalError = EVAL_ERR_HOUR_HI;
   }
   else if ( Hour >= 24 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Hour not in range 0 .. 23\n");
+    EvalError = EVAL_ERR_HOUR;
   }
 
   else if ( 0 != ParityDate )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Defect Parity for Date\n");
+    EvalError = EVAL_ERR_PARITY_DATE;
   }
   else if ( DayBCDLo < 0 || DayBCDLo > 9 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Lower digit for Day not in range 0 .. 9\n");
+    EvalError = EVAL_ERR_DAY_LO;
   }
   else if ( DayBCDHi < 0 || DayBCDHi > 3 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Higher digit for Day not in range 0 .. 2\n");
+    EvalError = EVAL_ERR_DAY_HI;
   }
   else if ( Day < 1 || Day > 31 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Day not in range 1 .. 31\n");
+    EvalError = EVAL_ERR_DAY;
   }
   else if ( Weekday < 1 || Weekday > 7 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Weekday not in range 1 .. 7\n");
+    EvalError = EVAL_ERR_WEEKDAY;
   }
   else if ( MonthBCDLo < 0 || MonthBCDLo > 9 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Lower digit for Month not in range 0 .. 9\n");
+    EvalError = EVAL_ERR_MONTH_LO;
   }
   else if ( MonthBCDHi < 0 || MonthBCDHi > 1 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Higher digit for Month not in range 0 .. 1\n");
+    EvalError = EVAL_ERR_MONTH_HI;
   }
   else if ( Month < 1 || Month > 12 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Month not in range 1 .. 12\n");
+    EvalError = EVAL_ERR_MONTH;
   }
   else if ( YearBCDLo < 0 || YearBCDLo > 9 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Lower digit for Year not in range 0 .. 9\n");
+    EvalError = EVAL_ERR_YEAR_LO;
   }
   else if ( YearBCDHi < 0 || YearBCDHi > 9 )
   {
-    if (errstream)
-      fprintf(errstream, "Error: Higher digit for Year not in range 0 .. 9\n");
+    EvalError = EVAL_ERR_YEAR_HI;
   }
   else
   {
@@ -274,137 +354,700 @@ bool DCF77::evalMinPulse(struct tm * tms, int * DCF_TZ_idx, FILE * errstream)
     tms->tm_yday  = 0; // mktime() ignores this
     tms->tm_isdst = (1 == TimeZone) ? 1 : 0; //positive if daylight saving time is in effect, zero if it is not, and negative if unknown
     *DCF_TZ_idx   = TimeZone;
+    EvalError = EVAL_OK;
     retval = true;
   }
 
+  // missing bits are normal after (re)sync: don't report them
+  if ( errstream && !retval && EVAL_ERR_BITS_MISSING != EvalError )
+    fprintf(errstream, "Error: %s\n", evalErrorText(EvalError));
+
   return retval;
 }
 
 
-void DCF77::newData( unsigned int framecount, const float * data )
+// fields of a partial frame. ok: all bits there, parity and range fine
+struct DCF77Fields
+{
+  bool  startOk;    // bit 20 missing or set
+  bool  tzOk;
+  int   tz;
+  bool  announce;   // bit 16 set or missing: time zone may change
+  bool  minOk;
+  int   minute;
+  bool  hourOk;
+  int   hour;
+  bool  dateOk;
+  int   day, weekday, month, year;
+};
+
+static int parity( unsigned v )
+{
+  int p = 0;
+  for ( ; v; v >>= 1 )
+    p ^= v & 1;
+  return p;
+}
+
+static void decodeFields( int valueLo, int validLo, int valueHi, int validHi, DCF77Fields * f )
+{
+  f->startOk = !( validLo & 0x100000 ) || ( valueLo & 0x100000 );
+  f->tz = ( valueLo >> 17 ) & 0x03;
+  f->tzOk = ( 0x60000 == ( validLo & 0x60000 ) ) && ( 1 == f->tz || 2 == f->tz );
+  f->announce = !( validLo & 0x10000 ) || ( valueLo & 0x10000 );
+
+  const int minLo = ( valueLo >> 21 ) & 0x0f;
+  const int minHi = ( valueLo >> 25 ) & 0x07;
+  f->minute = minLo + 10 * minHi;
+  f->minOk = ( 0x1FE00000 == ( validLo & 0x1FE00000 ) )
+          && !parity( valueLo & 0x1FE00000 ) && minLo <= 9 && minHi < 6;
+
+  const int hourLo = valueHi & 0x0f;
+  const int hourHi = ( valueHi >> 4 ) & 0x03;
+  f->hour = hourLo + 10 * hourHi;
+  f->hourOk = ( 0x7F == ( validHi & 0x7F ) )
+           && !parity( valueHi & 0x7F ) && hourLo <= 9 && f->hour < 24;
+
+  const int dayLo = ( valueHi >> 7 ) & 0x0f;
+  const int monLo = ( valueHi >> 16 ) & 0x0f;
+  const int yearLo = ( valueHi >> 21 ) & 0x0f;
+  const int yearHi = ( valueHi >> 25 ) & 0x0f;
+  f->day = dayLo + 10 * ( ( valueHi >> 11 ) & 0x03 );
+  f->weekday = ( valueHi >> 13 ) & 0x07;
+  f->month = monLo + 10 * ( ( valueHi >> 20 ) & 0x01 );
+  f->year = yearLo + 10 * yearHi;
+  f->dateOk = ( 0x3FFFFF80 == ( validHi & 0x3FFFFF80 ) )
+           && !parity( valueHi & 0x3FFFFF80 ) && dayLo <= 9 && monLo <= 9
+           && yearLo <= 9 && yearHi <= 9
+           && f->day >= 1 && f->day <= 31 && f->weekday >= 1
+           && f->month >= 1 && f->month <= 12;
+}
+
+
+bool DCF77::evalFastFix(struct tm * tms, int * DCF_TZ_idx, FILE * errstream)
+{
+  // P: frame before last minute mark, announces its time (as evalMinPulse)
+  // C: frame since last minute mark, announces the following minute
+  DCF77Fields P, C;
+  snapMinEdgeToPrn();
+  decodeFields( EvalValueMaskLo, EvalValidMaskLo, EvalValueMaskHi, EvalValidMaskHi, &P );
+  decodeFields( CurValueMaskLo, CurValidMaskLo, CurValueMaskHi, CurValidMaskHi, &C );
+
+  if ( SecInMinute < 0 || !P.startOk || !C.startOk )
+    return false;
+  // fields known in both frames have to fit each other
+  if ( ( P.minOk && C.minOk && C.minute != ( P.minute + 1 ) % 60 )
+    || ( P.hourOk && C.hourOk && C.minOk && C.minute && C.hour != P.hour ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: fast fix: frames inconsistent\n");
+    return false;
+  }
+
+  int minute, hour, tz;
+  const DCF77Fields * date;
+  if ( P.minOk )
+    minute = P.minute;
+  else if ( C.minOk )
+    minute = ( C.minute + 59 ) % 60;
+  else
+    return false;
+  // C has the same hour and date, unless its minute starts a new hour
+  if ( P.hourOk )
+    hour = P.hour;
+  else if ( C.hourOk && C.minOk && C.minute )
+    hour = C.hour;
+  else
+    return false;
+  if ( P.dateOk )
+    date = &P;
+  else if ( C.dateOk && C.minOk && C.hourOk && ( C.minute || C.hour ) )
+    date = &C;
+  else
+    return false;
+  if ( P.tzOk )
+    tz = P.tz;
+  else if ( C.tzOk && !C.announce )
+    tz = C.tz;
+  else
+    return false;
+
+  tms->tm_sec   = 0;
+  tms->tm_min   = minute;
+  tms->tm_hour  = hour;
+  tms->tm_mday  = date->day;
+  tms->tm_mon   = date->month -1;
+  tms->tm_year  = 2000 + date->year - 1900;
+  tms->tm_wday  = (date->weekday == 7) ? 0 : date->weekday;
+  tms->tm_yday  = 0;
+  tms->tm_isdst = (1 == tz) ? 1 : 0;
+  *DCF_TZ_idx   = tz;
+  FastFixDone = true;
+  return true;
+}
+
+
+void DCF77::setPrnEpoch( double epochFrame )
+{
+  PrnEpochFrame = epochFrame;
+}
+
+
+// PRN epochs repeat every second: snap the minute edge to the nearest one.
+// epochs further than PrnMaxAgeSec from the edge are stale
+void DCF77::snapMinEdgeToPrn()
+{
+  const double PrnMaxAgeSec = 3.0;
+  const double rate = frameRate();
+  const double epoch = PrnEpochFrame;
+
+  PrnCorrValid = false;
+  if ( epoch < 0.0 || MinEdgeFrame < 0
+    || fabs( epoch - (double)MinEdgeFrame ) > PrnMaxAgeSec * rate )
+    return;
+  PrnCorrFrames = remainder( epoch - (double)MinEdgeFrame, rate );
+  PrnCorrValid = true;
+}
+
+
+double DCF77::adcTimeOfMinEdge() const
+{
+  const double t = adcTimeOfFrame( MinEdgeFrame );
+  if ( !PrnCorrValid || 0.0 == t )
+    return t;
+  return t + PrnCorrFrames / frameRate();
+}
+
+
+void DCF77::setAdcTime( double adcTime )
+{
+  if ( adcTime > 0.0 )
+  {
+    LastAdcFrame = TotalFrames;
+    LastAdcTime = adcTime;
+  }
+}
+
+
+void DCF77::pushData( unsigned int framecount, const float * data, double adcTime )
+{
+  setAdcTime( adcTime );
+  newData( framecount, data );
+}
+
+
+void DCF77::pushData( unsigned int framecount, const short * data, double adcTime )
+{
+  setAdcTime( adcTime );
+  newData( framecount, data );
+}
+
+
+void DCF77::pushData( unsigned int framecount, const int * data, double adcTime )
+{
+  setAdcTime( adcTime );
+  newData( framecount, data );
+}
+
+
+double DCF77::adcTimeOfFrame( long long frame ) const
+{
+  if ( LastAdcFrame < 0 )
+    return 0.0;
+  return LastAdcTime + ( frame - LastAdcFrame ) / frameRate();
+}
+
+
+void DCF77::addSecondMark( long long frame )
+{
+  if ( UseTrellis )
+    Trellis.secondMark( frame );
+
+  // current fit for the index, until then nominal rate
+  const double rate = ( RateCount >= 2.0 && RateCnn > 0.0 ) ? RateCny / RateCnn : SampleRate;
+
+  if ( RateRefFrame >= 0 )
+  {
+    const double n = floor( ( frame - RateRefFrame ) / rate + 0.5 );
+    const double y = (double)( frame - RateRefFrame );
+    // off by more than 50 ms: noise edge or lost frames
+    const double resid = ( RateCount >= 2.0 ) ? y - ( RateMeanY + rate * ( n - RateMeanN ) ) : 0.0;
+    if ( fabs( resid ) > 0.05 * SampleRate || n <= RateSpan )
+    {
+      if ( ++RateOutliers < 5 )
+        return;
+      RateRefFrame = -1;    // restart
+    }
+    else if ( n > RateWindow )
+    {
+      RateRefFrame = -1;    // restart, but keep MeasuredRate
+    }
+    else
+    {
+      // Welford style update, numerically stable over long fits
+      RateOutliers = 0;
+      RateCount += 1.0;
+      const double dn = n - RateMeanN;
+      RateMeanN += dn / RateCount;
+      const double dy = y - RateMeanY;
+      RateMeanY += dy / RateCount;
+      RateCnn += dn * ( n - RateMeanN );
+      RateCny += dn * ( y - RateMeanY );
+      RateSpan = n;
+      // a restarted fit replaces the old result only when it is as good
+      if ( n >= RateMinSpan && ( !RateKeepOld || n >= RateWindow / 4.0 ) )
+      {
+        MeasuredRate = RateCny / RateCnn;
+        MeasuredRatePpm = 1E6 * ( MeasuredRate / SampleRate - 1.0 );
+      }
+      return;
+    }
+  }
+
+  RateRefFrame = frame;
+  RateCount = 1.0;
+  RateMeanN = RateMeanY = 0.0;
+  RateCnn = RateCny = 0.0;
+  RateSpan = 0.0;
+  RateOutliers = 0;
+  RateKeepOld = ( MeasuredRate > 0.0 );
+}
+
+
+// rising edge at frame i of current buffer (< 0: in previous one).
+// returns true on sync error
+bool DCF77::risingEdge( int i, unsigned int framecount )
+{
+  bool ReSync = false;
+
+  const float MSecsSinceLastPulse = (float)( ( FramesSinceLastPulse + i ) * 1000.0 / frameRate() );
+  if ( -1 == LastBit && MSecsSinceLastPulse >= 30.0 && MSecsSinceLastPulse < 400.0 )  // ~ 100 / 200 ms
+  {
+    int valid;
+    LastBit = classifyPulse( MSecsSinceLastPulse, &valid );
+    LastPulseMs = MSecsSinceLastPulse;
+    if ( SecInMinute >= 0 )
+    {
+      if ( SecInMinute <= 28 )
+      {
+        CurValueMaskLo |= LastBit << SecInMinute;
+        CurValidMaskLo |= valid << SecInMinute;
+      }
+      else if ( SecInMinute <= 58 )
+      {
+        CurValueMaskHi |= LastBit << ( SecInMinute - 29 );
+        CurValidMaskHi |= valid << ( SecInMinute - 29 );
+      }
+      // parity bits of minute, hour and date
+      if ( FastFix && !FastFixDone
+        && ( 28 == SecInMinute || 35 == SecInMinute || 58 == SecInMinute ) )
+        FastFixPending = true;
+    }
+    // DCF bits 28 .. 0: add 1 new bit from Hi and shift old bits
+    ValueMaskLo = ( (ValueMaskHi & 1) << 28 ) | ( ValueMaskLo >> 1 );
+    ValidMaskLo = ( (ValidMaskHi & 1) << 28 ) | ( ValidMaskLo >> 1 );
+    // DCF bits 58 .. 29 == 29 .. 0: add 1 new bit and shift old bits
+    ValueMaskHi = ( LastBit << 29 ) | ( ValueMaskHi >> 1 );
+    ValidMaskHi =   ( valid << 29 ) | ( ValidMaskHi >> 1 );
+
+    aiDiffFrames[iDiffIdx] = FramesSinceLastPulse + i;
+    iDiffIdx = 1 - iDiffIdx;
+    PrintDiff = 1;
+    FramesSinceLastPulse = - (int)i;
+  }
+  else if ( LastBit >= 0 && isGap( MSecsSinceLastPulse, 1000.0F ) )  // ~ 900 / 800 ms
+  {
+    LastBit = -1;   // after 100 ms or 200 ms Pulse at Second pulse
+    if ( SecInMinute >= 0 && SecInMinute < 59 )
+      ++SecInMinute;
+    SecEdgeFrame = TotalFrames + i;
+    addSecondMark( SecEdgeFrame );
+
+    aiDiffFrames[iDiffIdx] = FramesSinceLastPulse + i;
+    iDiffIdx = 1 - iDiffIdx;
+    PrintDiff = 1;
+    FramesSinceLastPulse = - (int)i;
+  }
+  else if ( LastBit >= 0 && isGap( MSecsSinceLastPulse, 2000.0F ) )  // ~ 1900 / 1800 ms
+  {
+    LastBit = -1; // after 100 ms or 200 ms Pulse at Minute pulse
+    FramesSinceLastMinPulse = (int)framecount - i;
+    SecInMinute = 0;
+    CurValueMaskLo = CurValidMaskLo = 0;
+    CurValueMaskHi = CurValidMaskHi = 0;
+    FastFixDone = false;
+    SecEdgeFrame = MinEdgeFrame = TotalFrames + i;
+    addSecondMark( SecEdgeFrame );
+    if ( !UseTrellis )
+    {
+      EvalValueMaskLo = ValueMaskLo;
+      EvalValidMaskLo = ValidMaskLo;
+      EvalValueMaskHi = ValueMaskHi;
+      EvalValidMaskHi = ValidMaskHi;
+      EvaluatedMinPulse = false;
+    }
+
+    aiDiffFrames[iDiffIdx] = FramesSinceLastPulse + i;
+    iDiffIdx = 1 - iDiffIdx;
+    PrintDiff = 1;
+    FramesSinceLastPulse = - (int)i;
+  }
+  else if ( MSecsSinceLastPulse >= 20000.0 && MSecsSinceLastPulse < 50000.0 )  // initial pulse search?
+  {
+    LastBit = -1;   // ignore
+    FramesSinceLastPulse = - (int)i;
+  }
+  else if ( -1 == LastBit && MSecsSinceLastPulse < 30.0 )
+  {
+    // filter noise!
+    LastBit = -1;
+    //fprintf(stderr, "ignore after %f ms\n", MSecsSinceLastPulse);
+    // do not set FramesSinceLastPulse !!!
+  }
+  else
+  {
+    //fprintf(stderr, "resync: with LastBit=%d after %f ms\n", LastBit, MSecsSinceLastPulse);
+    ReSync = true;  // sync error!
+    LastBit = -1;
+    FramesSinceLastPulse = - (int)i;
+  }
+
+  return ReSync;
+}
+
+
+// minute from trellis decoder: bits and minute mark, when the edge decoder
+// saw none on the grid
+void DCF77::takeTrellisMinute()
+{
+  const long long tol = (long long)( Trellis.TolMs * 1E-3 * frameRate() );
+  const long long edge = MinEdgeFrame;
+
+  Trellis.MinuteReady = false;
+  if ( edge < 0 || edge < Trellis.MinEdgeFrame - tol || edge > Trellis.MinEdgeFrame + tol )
+    MinEdgeFrame = Trellis.MinEdgeFrame;
+  FramesSinceLastMinPulse = (int)( TotalFrames - MinEdgeFrame );
+  EvalValueMaskLo = Trellis.ValueMaskLo;
+  EvalValidMaskLo = Trellis.ValidMaskLo;
+  EvalValueMaskHi = Trellis.ValueMaskHi;
+  EvalValidMaskHi = Trellis.ValidMaskHi;
+  EvaluatedMinPulse = false;
+}
+
+
+// falling edge at frame i of current buffer. end of a 100 / 200 ms level
+// pulse: same as the rising edge of the spike at its end. the falling
+// edge of a spike comes a few ms after its rise and is ignored
+bool DCF77::fallingEdge( int i, unsigned int framecount )
+{
+  const float MSecsSinceLastPulse = (float)( ( FramesSinceLastPulse + i ) * 1000.0 / frameRate() );
+  if ( -1 == LastBit && MSecsSinceLastPulse >= 30.0 && MSecsSinceLastPulse < 400.0 )
+    return risingEdge( i, framecount );
+  return false;
+}
+
+
+// windows: learned mean +/- 4 sigma, at least +/- 40 ms
+static float windowMs( float sigma )
+{
+  return ( 4.0F * sigma > 40.0F ) ? 4.0F * sigma : 40.0F;
+}
+
+// weight of new value in running statistics: average of first values,
+// then exponential over ~ 64 values
+static float learnRate( unsigned * count )
+{
+  if ( *count < 60 )
+    ++*count;
+  return 1.0F / ( *count + 4 );
+}
+
+
+// bit of pulse with width ms. valid: 0, if outside the windows
+int DCF77::classifyPulse( float ms, int * valid )
+{
+  const float m0 = 100.0F + PulseOffsetMs;
+  const float m1 = 200.0F + PulseOffsetMs;
+  const float w0 = windowMs( PulseSigmaMs[0] );
+  const float w1 = windowMs( PulseSigmaMs[1] );
+  int bit;
+
+  if ( MLBits )
+  {
+    // gaussian log likelihood of both bits
+    const float z0 = ( ms - m0 ) / PulseSigmaMs[0];
+    const float z1 = ( ms - m1 ) / PulseSigmaMs[1];
+    bit = ( z1 * z1 + 2.0F * logf( PulseSigmaMs[1] ) < z0 * z0 + 2.0F * logf( PulseSigmaMs[0] ) ) ? 1 : 0;
+    *valid = ( ms > m0 - w0 && ms < m1 + w1 ) ? 1 : 0;
+  }
+  else
+  {
+    bit = ( ms < 0.5F * ( m0 + m1 ) ) ? 0 : 1;
+    *valid = ( fabsf( ms - ( bit ? m1 : m0 ) ) < ( bit ? w1 : w0 ) ) ? 1 : 0;
+  }
+
+  if ( AdaptiveWindows )
+  {
+    if ( *valid )
+    {
+      const float r = ms - ( bit ? m1 : m0 );
+      const float b = learnRate( &PulseCount[bit] );
+      const float var = ( 1.0F - b ) * ( PulseSigmaMs[bit] * PulseSigmaMs[bit] + b * r * r );
+      PulseSigmaMs[bit] = ( var > 1.0F ) ? sqrtf( var ) : 1.0F;
+    }
+    learnPulseOffset( ms );
+  }
+  return bit;
+}
+
+
+// slow output stages stretch both pulses alike. zeros are more frequent
+// than ones, so the offset is not simply learned from the nearest bit:
+// it is the one, that explains most pulses of the recent ones with a
+// 100 / 200 ms pair, refined by their mean deviation
+void DCF77::learnPulseOffset( float ms )
+{
+  float cum[PULSE_HIST_BINS + 1];
+  float bestScore = -1.0F;
+  int best = 0;
+  int k, o;
+
+  for ( k = 0; k < PULSE_HIST_BINS; ++k )
+    PulseHist[k] *= 63.0F / 64.0F;
+  k = (int)( ( ms - 30.0F ) * 0.5F );
+  PulseHist[ k < 0 ? 0 : ( k >= PULSE_HIST_BINS ? PULSE_HIST_BINS - 1 : k ) ] += 1.0F;
+  PulseHistSum = PulseHistSum * 63.0F / 64.0F + 1.0F;
+  if ( PulseHistSum < 16.0F )
+    return;
+
+  cum[0] = 0.0F;
+  for ( k = 0; k < PULSE_HIST_BINS; ++k )
+    cum[k + 1] = cum[k] + PulseHist[k];
+
+  // offset -40 .. 120 ms in steps of 2 ms (o); +/- 20 ms around 100 and
+  // 200 ms: bins 25 + o .. 45 + o and 75 + o .. 95 + o
+  for ( o = -20; o <= 60; ++o )
+  {
+    const float score = ( cum[46 + o] - cum[25 + o] ) + ( cum[96 + o] - cum[75 + o] );
+    if ( score > bestScore )
+    {
+      bestScore = score;
+      best = o;
+    }
+  }
+  if ( bestScore <= 0.0F )
+    return;
+
+  // bin centers 31 + 2 k ms
+  float dev = 0.0F;
+  for ( k = 25 + best; k <= 45 + best; ++k )
+    dev += PulseHist[k] * ( 2 * ( k - best ) - 69 );
+  for ( k = 75 + best; k <= 95 + best; ++k )
+    dev += PulseHist[k] * ( 2 * ( k - best ) - 169 );
+  PulseOffsetMs = 2.0F * best + dev / bestScore;
+}
+
+
+// is ms after end of last pulse the next mark, period ms after the last one?
+bool DCF77::isGap( float ms, float periodMs )
+{
+  const float pulse = AdaptiveWindows ? LastPulseMs : ( LastBit ? 200.0F : 100.0F );
+  const float r = ms + pulse - periodMs;
+  if ( fabsf( r ) >= windowMs( GapSigmaMs ) )
+    return false;
+  if ( AdaptiveWindows )
+  {
+    const float a = learnRate( &GapCount );
+    const float var = ( 1.0F - a ) * ( GapSigmaMs * GapSigmaMs + a * r * r );
+    GapSigmaMs = ( var > 1.0F ) ? sqrtf( var ) : 1.0F;
+  }
+  return true;
+}
+
+
+// threshold in sample units: x >= result  <=>  x * scale >= threshold
+static inline float sampleThreshold( float threshold, double, const float * )
+{
+  return threshold;
+}
+
+static inline short sampleThreshold( float threshold, double scale, const short * )
+{
+  const double t = ceil( threshold / scale );
+  return (short)( t > 32767.0 ? 32767.0 : ( t < -32768.0 ? -32768.0 : t ) );
+}
+
+static inline int sampleThreshold( float threshold, double scale, const int * )
+{
+  const double t = ceil( threshold / scale );
+  return (int)( t > 2147483647.0 ? 2147483647.0 : ( t < -2147483648.0 ? -2147483648.0 : t ) );
+}
+
+// sample of inverted input; saturating for the integer types
+static inline float invertSample( float v )
+{
+  return -v;
+}
+
+static inline short invertSample( short v )
+{
+  return ( v == -32768 ) ? (short)32767 : (short)-v;
+}
+
+static inline int invertSample( int v )
+{
+  return ( v == -2147483647 - 1 ) ? 2147483647 : -v;
+}
+
+
+// block of STATE_GET_THRESH: maximum and sum of its (scaled) samples
+void DCF77::thresholdBlock( unsigned int framecount, double localMax, double localSum )
+{
+  if ( localMax > Max )
+    Max = (float)localMax;
+  Sum += localSum;
+  frameIndex += framecount;
+  TotalFrames += framecount;
+
+  // evaluate statistics after 10 seconds
+  if ( (double)frameIndex >= 10.0 * SampleRate )
+  {
+    const double dMean = Sum / frameIndex;
+    Mean      = (float)dMean;
+    // Signal Power should not exceed 7/10 th of Mean to Max voltage
+    Threshold = (float)( dMean + 0.7 * ( Max - dMean ) );
+    ThresholdLow = (float)( Threshold - Hysteresis * ( Max - dMean ) );
+    ThreshFinishMessage = true;
+    // State finished --> next state := STATE_GET_TIME
+    initGetTime();
+  }
+}
+
+
+void DCF77::timeBlockBegin( unsigned int framecount )
+{
+  if ( FramesSinceLastMinPulse >= 0 )
+    FramesSinceLastMinPulse += framecount;
+}
+
+
+// comparator switched to high / low at frame at of current block.
+// returns true on sync error
+bool DCF77::comparatorEdge( int at, bool high, unsigned int framecount )
+{
+  if ( UseTrellis )
+    Trellis.addEdge( TotalFrames + at, high );
+  return high ? risingEdge( at, framecount ) : fallingEdge( at, framecount );
+}
+
+
+void DCF77::timeBlockEnd( unsigned int framecount, bool resync )
+{
+  FramesSinceLastPulse += framecount;
+  TotalFrames += framecount;
+
+  if ( UseTrellis )
+  {
+    Trellis.advance( TotalFrames, frameRate(), PulseOffsetMs, PulseSigmaMs );
+    if ( Trellis.MinuteReady )
+      takeTrellisMinute();
+  }
+
+  if ( ( FramesSinceLastPulse > 10.0 * SampleRate
+      && FramesSinceLastPulse < 20.0 * SampleRate )
+      || ( resync && !UseTrellis )
+      )
+  {
+    initGetThreshold();
+  }
+  else if ( resync )
+  {
+    // trellis keeps the grid, but the PRN epoch may belong to the lost one
+    PrnCorrValid = false;
+    PrnEpochFrame = -1.0;
+  }
+}
+
+
+// shared by all sample formats: samples * scale == float samples.
+// per sample only compares and adds in the type of the samples
+template <class T, class SumT>
+void DCF77::newDataT( unsigned int framecount, const T * data, double scale )
 {
   unsigned int i;
   unsigned int idx;
   bool  ReSync;
-  float LocalLastSample;
+
+  if ( !framecount )
+    return;
 
   switch( eState )
   {
     case STATE_GET_THRESH:
-      idx = ChanIdx;
-      for ( i = 0; i < framecount; ++i, idx += ChanCount )
-      {
-        // gather statistics
-        if ( data[idx] > Max )
-          Max = data[idx];
-        Sum += data[idx];
-      }
-      frameIndex += framecount;
-
-      // evaluate statistics after 10 seconds
-      if ( (double)frameIndex >= 10.0 * SampleRate )
       {
-        const double dMean = Sum / frameIndex;
-        Mean      = (float)dMean;
-        // Signal Power should not exceed 7/10 th of Mean to Max voltage
-        Threshold = (float)( dMean + 0.7 * ( Max - dMean ) );
-        ThreshFinishMessage = true;
-        // State finished --> next state := STATE_GET_TIME
-        initGetTime();
+        const bool Inv = Invert;
+        T     LocalMax = Inv ? invertSample( data[ChanIdx] ) : data[ChanIdx];
+        SumT  LocalSum = 0;
+        idx = ChanIdx;
+        for ( i = 0; i < framecount; ++i, idx += ChanCount )
+        {
+          // gather statistics
+          const T v = Inv ? invertSample( data[idx] ) : data[idx];
+          if ( v > LocalMax )
+            LocalMax = v;
+          LocalSum += v;
+        }
+        thresholdBlock( framecount, LocalMax * scale, LocalSum * scale );
       }
       break;
 
     case STATE_GET_TIME:
+      {
+        const T ThreshHigh = sampleThreshold( Threshold, scale, data );
+        const T ThreshLow = sampleThreshold( ThresholdLow, scale, data );
+        const unsigned Debounce = DebounceFrames;
+        const bool Inv = Invert;
+        bool      High = CmpHigh;
+        bool      Pending = CmpPending;
+        int       PendingAt = CmpPendingAt;
+        unsigned  Dwell = CmpDwell;
 
-      LocalLastSample = LastSample;
-      idx = ChanIdx;
-      ReSync = false;
-
-      if ( FramesSinceLastMinPulse >= 0 )
-        FramesSinceLastMinPulse += framecount;
+        idx = ChanIdx;
+        ReSync = false;
+        timeBlockBegin( framecount );
 
-      for ( i = 0; i < framecount; ++i, idx += ChanCount )
-      {
-        if ( LocalLastSample < Threshold && data[idx] >= Threshold )
+        for ( i = 0; i < framecount; ++i, idx += ChanCount )
         {
-          const float MSecsSinceLastPulse = (float)( ( FramesSinceLastPulse + i ) * 1000.0 / SampleRate );
-          if      ( ( -1 == LastBit && MSecsSinceLastPulse >  60.0 && MSecsSinceLastPulse < 140.0 )  // ~ 100 ms
-                  ||( -1 == LastBit && MSecsSinceLastPulse > 160.0 && MSecsSinceLastPulse < 240.0 )  // ~ 200 ms
-                  )
-          {
-            LastBit = ( MSecsSinceLastPulse < 150.0 ) ? 0 : 1;
-            // DCF bits 28 .. 0: add 1 new bit from Hi and shift old bits
-            ValueMaskLo = ( (ValueMaskHi & 1) << 28 ) | ( ValueMaskLo >> 1 );
-            ValidMaskLo = ( (ValidMaskHi & 1) << 28 ) | ( ValidMaskLo >> 1 );
-            // DCF bits 58 .. 29 == 29 .. 0: add 1 new bit and shift old bits
-            ValueMaskHi = ( LastBit << 29 ) | ( ValueMaskHi >> 1 );
-            ValidMaskHi =       ( 1 << 29 ) | ( ValidMaskHi >> 1 );
-
-            aiDiffFrames[iDiffIdx] = FramesSinceLastPulse + i;
-            iDiffIdx = 1 - iDiffIdx;
-            PrintDiff = 1;
-            FramesSinceLastPulse = - (int)i;
-          }
-          else if ( ( 0 == LastBit && MSecsSinceLastPulse > 860.0 && MSecsSinceLastPulse < 940.0 )  // ~ 900 ms
-                  ||( 1 == LastBit && MSecsSinceLastPulse > 760.0 && MSecsSinceLastPulse < 840.0 )  // ~ 800 ms
-                  )
+          const T v = Inv ? invertSample( data[idx] ) : data[idx];
+          if ( !Pending )
           {
-            LastBit = -1;   // after 100 ms or 200 ms Pulse at Second pulse
-
-            aiDiffFrames[iDiffIdx] = FramesSinceLastPulse + i;
-            iDiffIdx = 1 - iDiffIdx;
-            PrintDiff = 1;
-            FramesSinceLastPulse = - (int)i;
+            // still on this side of the hysteresis band?
+            if ( High ? ( v >= ThreshLow ) : ( v < ThreshHigh ) )
+              continue;
+            Pending = true;
+            PendingAt = (int)i;
+            Dwell = 0;
           }
-          else if ( ( 0 == LastBit && MSecsSinceLastPulse > 1860.0 && MSecsSinceLastPulse < 1940.0 )  // ~ 1900 ms
-                  ||( 1 == LastBit && MSecsSinceLastPulse > 1760.0 && MSecsSinceLastPulse < 1840.0 )  // ~ 1800 ms
-                  )
+          else if ( High ? ( v >= ThreshHigh ) : ( v < ThreshLow ) )
           {
-            LastBit = -1; // after 100 ms or 200 ms Pulse at Minute pulse
-            FramesSinceLastMinPulse = framecount - i;
-            EvalValueMaskLo = ValueMaskLo;
-            EvalValidMaskLo = ValidMaskLo;
-            EvalValueMaskHi = ValueMaskHi;
-            EvalValidMaskHi = ValidMaskHi;
-            EvaluatedMinPulse = false;
-
-            aiDiffFrames[iDiffIdx] = FramesSinceLastPulse + i;
-            iDiffIdx = 1 - iDiffIdx;
-            PrintDiff = 1;
-            FramesSinceLastPulse = - (int)i;
+            Pending = false;    // bounced back before Debounce frames
+            continue;
           }
-          else if ( MSecsSinceLastPulse >= 20000.0 && MSecsSinceLastPulse < 50000.0 )  // initial pulse search?
-          {
-            LastBit = -1;   // ignore
-            FramesSinceLastPulse = - (int)i;
-          }
-          else if ( -1 == LastBit && MSecsSinceLastPulse < 30.0 )
-          {
-            // filter noise!
-            LastBit = -1;
-            //fprintf(stderr, "ignore after %f ms\n", MSecsSinceLastPulse);
-            // do not set FramesSinceLastPulse !!!
-          }
-          else
-          {
-            //fprintf(stderr, "resync: with LastBit=%d after %f ms\n", LastBit, MSecsSinceLastPulse);
-            ReSync = true;  // sync error!
-            LastBit = -1;
-            FramesSinceLastPulse = - (int)i;
-          }
-        }
-        LocalLastSample = data[idx];
-      } // end for
-      FramesSinceLastPulse += framecount;
-      LastSample = LocalLastSample;
-
-      if ( ( FramesSinceLastPulse > 10.0 * SampleRate
-          && FramesSinceLastPulse < 20.0 * SampleRate )
-          || ReSync
-          )
-      {
-        initGetThreshold();
+          if ( ++Dwell < Debounce )
+            continue;
+          Pending = false;
+          High = !High;
+          ReSync = comparatorEdge( PendingAt, High, framecount ) || ReSync;
+        } // end for
+        CmpHigh = High;
+        CmpPending = Pending;
+        CmpPendingAt = PendingAt - (int)framecount;
+        CmpDwell = Dwell;
+        LastSample = (float)( data[ idx - ChanCount ] * scale );
+        if ( Inv )
+          LastSample = -LastSample;
       }
+      timeBlockEnd( framecount, ReSync );
       break;
 
     default:
@@ -412,3 +1055,21 @@ void DCF77::newData( unsigned int framecount, const float * data )
   }
 }
 
+
+void DCF77::newData( unsigned int framecount, const float * data )
+{
+  newDataT<float, double>( framecount, data, 1.0 );
+}
+
+
+void DCF77::newData( unsigned int framecount, const short * data )
+{
+  newDataT<short, long long>( framecount, data, 1.0 / 32768.0 );
+}
+
+
+void DCF77::newData( unsigned int framecount, const int * data )
+{
+  newDataT<int, long long>( framecount, data, 1.0 / 2147483648.0 );
+}
+
@@ -29,6 +29,8 @@
 #include <time.h>
 #include <stdio.h>
 
+#include "dcf77trellis.h"
+
 class DCF77
 {
 public:
@@ -37,8 +39,32 @@ public:
 
   void initGetThreshold();
   void initGetTime();
+  // begin in STATE_GET_TIME with the levels of an earlier run instead of
+  // the threshold phase (see DCF77WarmState). set the pulse statistics and
+  // MeasuredRate before
+  void warmStart( float mean, float max, float threshold, float thresholdLow );
   void newData( unsigned int framecount, const float * data );
+  // native integer samples: no float conversion per sample.
+  // int samples: full 32 bit scale (24 bit in 32 bit containers, as ALSA S32)
+  void newData( unsigned int framecount, const short * data );
+  void newData( unsigned int framecount, const int * data );
+  // newData() with capture time of first frame (0: unknown), see dcf77source.h
+  void pushData( unsigned int framecount, const float * data, double adcTime );
+  void pushData( unsigned int framecount, const short * data, double adcTime );
+  void pushData( unsigned int framecount, const int * data, double adcTime );
+  // capture time of absolute frame, from last pushData() with adcTime. 0 if unknown
+  double adcTimeOfFrame( long long frame ) const;
+  // sample clock for frame <-> time conversions: MeasuredRate, if known
+  double frameRate() const { return MeasuredRate > 0.0 ? MeasuredRate : SampleRate; }
   bool evalMinPulse(struct tm * tms, int * DCF_TZ_idx, FILE * errstream);
+  // fast fix: time of last minute mark from partial frames, as soon as
+  // minute, hour and date are known from the frame before or the current one
+  bool evalFastFix(struct tm * tms, int * DCF_TZ_idx, FILE * errstream);
+  static const char * evalErrorText( int evalError );
+  // last PRN epoch (see dcf77prn.h): evalMinPulse() snaps the minute edge to it
+  void setPrnEpoch( double epochFrame );
+  // capture time of last minute mark, with PRN correction if valid
+  double adcTimeOfMinEdge() const;
 
   typedef enum
   {
@@ -47,12 +73,42 @@ public:
   }
     State;
 
+  typedef enum
+  {
+      EVAL_OK = 0
+    , EVAL_ERR_BITS_MISSING
+    , EVAL_ERR_STARTBIT
+    , EVAL_ERR_TIMEZONE
+    , EVAL_ERR_PARITY_MINUTE
+    , EVAL_ERR_MINUTE_LO
+    , EVAL_ERR_MINUTE_HI
+    , EVAL_ERR_PARITY_HOUR
+    , EVAL_ERR_HOUR_LO
+    , EVAL_ERR_HOUR_HI
+    , EVAL_ERR_HOUR
+    , EVAL_ERR_PARITY_DATE
+    , EVAL_ERR_DAY_LO
+    , EVAL_ERR_DAY_HI
+    , EVAL_ERR_DAY
+    , EVAL_ERR_WEEKDAY
+    , EVAL_ERR_MONTH_LO
+    , EVAL_ERR_MONTH_HI
+    , EVAL_ERR_MONTH
+    , EVAL_ERR_YEAR_LO
+    , EVAL_ERR_YEAR_HI
+    , EVAL_ERR_COUNT
+  }
+    EvalErrorCode;
+
   double          SampleRate;
   State            eState;
   unsigned        ChanCount;
   unsigned        ChanIdx;
   unsigned        FramesPerBuffer;
   unsigned        frameIndex;  /* Index into sample array. */
+  long long       TotalFrames; // frames processed since construction
+  volatile double LastAdcTime;  // capture time of frame LastAdcFrame
+  volatile long long LastAdcFrame;
 
   // vars for state STATE_GET_THRESH
   double          Sum;
@@ -61,7 +117,35 @@ public:
   volatile bool  ThreshStartMessage;
   volatile bool  ThreshFinishMessage;
   volatile float Mean;
-  volatile float Threshold;
+  volatile float Threshold;     // comparator switches high at or above
+  volatile float ThresholdLow;  // comparator switches low below
+
+  // input of inverted polarity: pulses go negative (see DCF77PulseScan).
+  // samples are negated before threshold statistics and comparator
+  bool            Invert;
+
+  // comparator: hysteresis band below Threshold as fraction of Max - Mean
+  // (0: single threshold), and minimum dwell on the new side of the band
+  // before an edge counts. set before STATE_GET_TIME
+  float           Hysteresis;
+  float           DebounceMs;
+
+  // pulse classification. windows: nominal 100 / 200 ms + PulseOffsetMs
+  // +/- max(40, 4 sigma); second / minute marks 1000 / 2000 ms after the
+  // start of the last pulse +/- max(40, 4 GapSigmaMs). learned from the
+  // received pulses, if AdaptiveWindows. pulses outside the windows give
+  // an invalid bit. MLBits: bit of higher likelihood instead of nearest
+  bool            AdaptiveWindows;
+  bool            MLBits;
+  float           PulseOffsetMs;    // stretch of output stage
+  float           PulseSigmaMs[2];  // bit 0 / 1
+  float           GapSigmaMs;
+  float           LastPulseMs;
+
+  // minutes from the trellis decoder (see dcf77trellis.h) instead of the
+  // edge state machine. sync errors then do not restart the threshold phase
+  bool            UseTrellis;
+  DCF77Trellis    Trellis;
 
   // vars for state STATE_GET_TIME
   float           LastSample;
@@ -78,12 +162,81 @@ public:
   volatile int   EvalValidMaskLo;
   volatile int   EvalValueMaskHi;  // DCF bits 58 .. 29
   volatile int   EvalValidMaskHi;
+  volatile long long SecEdgeFrame;  // absolute frame of last second mark
+  volatile long long MinEdgeFrame;  // absolute frame of last minute mark
+  // current frame, indexed by second since last minute mark (fast fix)
+  volatile int   SecInMinute;      // -1 until first minute mark
+  volatile int   CurValueMaskLo;   // DCF bits 28 .. 0
+  volatile int   CurValidMaskLo;
+  volatile int   CurValueMaskHi;   // DCF bits 58 .. 29
+  volatile int   CurValidMaskHi;
+  bool           FastFix;          // set FastFixPending, when a field completes
+  volatile bool  FastFixPending;   // call evalFastFix(); reset by consumer
+  volatile bool  FastFixDone;      // for current minute; reset at minute mark
+  // correction of minute mark from PRN, set by evalMinPulse():
+  // true edge = MinEdgeFrame + PrnCorrFrames
+  volatile bool   PrnCorrValid;
+  volatile double PrnCorrFrames;
+  volatile double PrnEpochFrame;   // absolute frame of last PRN epoch. < 0: none
 
   volatile int   aiDiffFrames[2];
   volatile int   iDiffIdx;
   volatile int   PrintDiff;
 
+  // result of last evalMinPulse()
+  EvalErrorCode  EvalError;
+
+  // actual sample rate, from least squares fit of second marks to their
+  // index. 0 until RateMinSpan seconds are covered. a new fit is started
+  // every RateWindow seconds, following temperature drift
+  volatile double MeasuredRate;
+  volatile double MeasuredRatePpm;  // deviation from nominal SampleRate
+  double          RateMinSpan;
+  double          RateWindow;
+
   int            SetSysTime;
+
+private:
+  friend class DCF77Multi;
+
+  template <class T, class SumT>
+  void newDataT( unsigned int framecount, const T * data, double scale );
+  // per block of newDataT(); the comparator itself is in the caller
+  void thresholdBlock( unsigned int framecount, double localMax, double localSum );
+  void timeBlockBegin( unsigned int framecount );
+  bool comparatorEdge( int at, bool high, unsigned int framecount );
+  void timeBlockEnd( unsigned int framecount, bool resync );
+  bool risingEdge( int i, unsigned int framecount );
+  bool fallingEdge( int i, unsigned int framecount );
+  int classifyPulse( float ms, int * valid );
+  bool isGap( float ms, float periodMs );
+  void setAdcTime( double adcTime );
+  void addSecondMark( long long frame );
+  void takeTrellisMinute();
+  void snapMinEdgeToPrn();
+
+  // comparator state. pending edge at frame CmpPendingAt of current buffer
+  bool            CmpHigh;
+  bool            CmpPending;
+  int             CmpPendingAt;
+  unsigned        CmpDwell;
+  unsigned        DebounceFrames;
+  void learnPulseOffset( float ms );
+  unsigned        PulseCount[2];  // learned values of bit 0, 1
+  unsigned        GapCount;
+  enum { PULSE_HIST_BINS = 185 }; // widths 30 .. 400 ms in 2 ms
+  float           PulseHist[PULSE_HIST_BINS];
+  float           PulseHistSum;
+
+  long long       RateRefFrame;   // frame of second index 0
+  double          RateCount;      // incremental regression: frame = a + rate * index
+  double          RateMeanN;
+  double          RateMeanY;
+  double          RateCnn;
+  double          RateCny;
+  double          RateSpan;       // seconds covered by current fit
+  int             RateOutliers;   // in a row
+  bool            RateKeepOld;    // MeasuredRate from previous fit
 };
 
 #endif /* _U775_DCF77_H_ */
@@ -0,0 +1,309 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77alsa.h"
+
+#include <string.h>
+
+#ifdef HAVE_ALSA
+
+#include <alsa/asoundlib.h>
+
+#define PCM   ( (snd_pcm_t *)pcm )
+
+
+DCF77AlsaCapture::DCF77AlsaCapture()
+  : Running( false )
+  , StopReq( false )
+{
+  SampleRate = 48000.0;
+  ChanCount = 2;
+  FramesPerBuffer = 480;
+  Periods = 4;
+  MonotonicAdcTime = true;
+  HwTimestamps = false;
+  Xruns = 0;
+  CapturedFrames = 0;
+  pcm = 0;
+  PcmFormat = SND_PCM_FORMAT_UNKNOWN;
+  cb = 0;
+  cbUserData = 0;
+  TsFrame = -1;
+  TsTime = 0.0;
+}
+
+
+DCF77AlsaCapture::~DCF77AlsaCapture()
+{
+  close();
+}
+
+
+bool DCF77AlsaCapture::open( const char * device, FILE * errstream )
+{
+  // by SampleFormat; order of preference after the requested Format
+  static const snd_pcm_format_t PcmFormats[] =
+  { SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S32_LE };
+  static const SampleFormat Formats[] = { FMT_FLOAT32, FMT_INT32, FMT_INT16 };
+  snd_pcm_t * handle = 0;
+  snd_pcm_hw_params_t * hw;
+  snd_pcm_sw_params_t * sw;
+  unsigned rate = (unsigned)( SampleRate + 0.5 );
+  snd_pcm_uframes_t period = FramesPerBuffer;
+  snd_pcm_uframes_t bufsize = (snd_pcm_uframes_t)FramesPerBuffer * Periods;
+  const char * step = "snd_pcm_open";
+  unsigned i;
+  int err;
+
+  close();
+  err = snd_pcm_open( &handle, device, SND_PCM_STREAM_CAPTURE, 0 );
+  if ( err < 0 )
+    goto fail;
+
+  snd_pcm_hw_params_alloca( &hw );
+  step = "snd_pcm_hw_params_any";
+  if ( ( err = snd_pcm_hw_params_any( handle, hw ) ) < 0 )
+    goto fail;
+  step = "mmap interleaved access";
+  if ( ( err = snd_pcm_hw_params_set_access( handle, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED ) ) < 0 )
+    goto fail;
+  step = "sample format FLOAT_LE, S32_LE or S16_LE";
+  err = -EINVAL;
+  for ( i = 0; i <= sizeof(Formats) / sizeof(Formats[0]); ++i )
+  {
+    const SampleFormat fmt = i ? Formats[i - 1] : Format;
+    if ( 0 == snd_pcm_hw_params_test_format( handle, hw, PcmFormats[fmt] ) )
+    {
+      err = snd_pcm_hw_params_set_format( handle, hw, PcmFormats[fmt] );
+      PcmFormat = PcmFormats[fmt];
+      Format = fmt;
+      break;
+    }
+  }
+  if ( err < 0 )
+    goto fail;
+  step = "channel count";
+  if ( ( err = snd_pcm_hw_params_set_channels( handle, hw, ChanCount ) ) < 0 )
+    goto fail;
+  step = "sample rate";
+  if ( ( err = snd_pcm_hw_params_set_rate_resample( handle, hw, 0 ) ) < 0
+    || ( err = snd_pcm_hw_params_set_rate( handle, hw, rate, 0 ) ) < 0 )
+    goto fail;
+  step = "period size";
+  if ( ( err = snd_pcm_hw_params_set_period_size_near( handle, hw, &period, 0 ) ) < 0 )
+    goto fail;
+  bufsize = period * Periods;
+  step = "buffer size";
+  if ( ( err = snd_pcm_hw_params_set_buffer_size_near( handle, hw, &bufsize ) ) < 0 )
+    goto fail;
+  step = "snd_pcm_hw_params";
+  if ( ( err = snd_pcm_hw_params( handle, hw ) ) < 0 )
+    goto fail;
+
+  snd_pcm_sw_params_alloca( &sw );
+  step = "snd_pcm_sw_params";
+  if ( ( err = snd_pcm_sw_params_current( handle, sw ) ) < 0
+    || ( err = snd_pcm_sw_params_set_avail_min( handle, sw, period ) ) < 0
+    || ( err = snd_pcm_sw_params_set_tstamp_mode( handle, sw, SND_PCM_TSTAMP_ENABLE ) ) < 0
+    || ( err = snd_pcm_sw_params_set_tstamp_type( handle, sw, SND_PCM_TSTAMP_TYPE_MONOTONIC ) ) < 0
+    || ( err = snd_pcm_sw_params( handle, sw ) ) < 0 )
+    goto fail;
+
+  pcm = handle;
+  FramesPerBuffer = (unsigned)period;
+  HwTimestamps = false;
+  Xruns = 0;
+  CapturedFrames = 0;
+  TsFrame = -1;
+  return true;
+
+fail:
+  if ( errstream )
+    fprintf(errstream, "Error: ALSA device '%s': %s: %s\n", device, step, snd_strerror( err ));
+  if ( handle )
+    snd_pcm_close( handle );
+  return false;
+}
+
+
+void DCF77AlsaCapture::close()
+{
+  stop();
+  if ( pcm )
+    snd_pcm_close( PCM );
+  pcm = 0;
+}
+
+
+bool DCF77AlsaCapture::start( Callback callback, void * userData, FILE * errstream )
+{
+  int err;
+
+  if ( !pcm || Running )
+    return false;
+  cb = callback;
+  cbUserData = userData;
+  if ( ( err = snd_pcm_prepare( PCM ) ) < 0 || ( err = snd_pcm_start( PCM ) ) < 0 )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: ALSA start: %s\n", snd_strerror( err ));
+    return false;
+  }
+  StopReq = false;
+  Running = true;
+  Capture = std::thread( &DCF77AlsaCapture::captureLoop, this );
+  return true;
+}
+
+
+void DCF77AlsaCapture::stop()
+{
+  StopReq = true;
+  if ( Capture.joinable() )
+    Capture.join();
+  if ( pcm )
+    snd_pcm_drop( PCM );
+  Running = false;
+}
+
+
+double DCF77AlsaCapture::adcTimeOfFrame( long long frame )
+{
+  if ( TsFrame < 0 )
+    return 0.0;
+  return TsTime - ( TsFrame - frame ) / SampleRate;
+}
+
+
+void DCF77AlsaCapture::captureLoop()
+{
+  snd_pcm_status_t * status;
+  unsigned flags = 0;
+
+  snd_pcm_status_alloca( &status );
+
+  while ( !StopReq )
+  {
+    int err = snd_pcm_wait( PCM, 100 );
+    if ( 0 == err )
+      continue;   // timeout: check StopReq
+
+    // timestamp of hardware position: frame CapturedFrames + avail was
+    // captured at tstamp
+    if ( err > 0 && 0 == snd_pcm_status( PCM, status ) && snd_pcm_status_get_avail( status ) > 0 )
+    {
+      snd_htimestamp_t ts;
+      snd_pcm_status_get_htstamp( status, &ts );
+      HwTimestamps = ( ts.tv_sec || ts.tv_nsec );
+      TsTime = ts.tv_sec + 1E-9 * ts.tv_nsec;
+      TsFrame = HwTimestamps ? CapturedFrames + (long long)snd_pcm_status_get_avail( status ) : -1;
+    }
+
+    snd_pcm_sframes_t avail = ( err >= 0 ) ? snd_pcm_avail_update( PCM ) : err;
+    if ( avail < 0 )
+    {
+      // xrun or suspend: restart
+      ++Xruns;
+      flags |= FLAG_INPUT_OVERFLOW;
+      TsFrame = -1;
+      if ( snd_pcm_recover( PCM, (int)avail, 1 ) < 0 || snd_pcm_start( PCM ) < 0 )
+        break;
+      continue;
+    }
+
+    while ( avail > 0 )
+    {
+      const snd_pcm_channel_area_t * areas;
+      snd_pcm_uframes_t offset;
+      snd_pcm_uframes_t frames = (snd_pcm_uframes_t)avail;
+
+      if ( snd_pcm_mmap_begin( PCM, &areas, &offset, &frames ) < 0 || !frames )
+        break;
+      // interleaved: all channels in area 0, step is one frame
+      const unsigned char * base = (const unsigned char *)areas[0].addr
+                                 + ( areas[0].first + offset * areas[0].step ) / 8;
+      const double adcTime = adcTimeOfFrame( CapturedFrames );
+
+      cb( (unsigned)frames, base, adcTime, flags, cbUserData );
+      flags = 0;
+
+      snd_pcm_sframes_t committed = snd_pcm_mmap_commit( PCM, offset, frames );
+      if ( committed < 0 || (snd_pcm_uframes_t)committed != frames )
+        break;  // xrun: next avail_update() reports it
+      CapturedFrames += frames;
+      avail -= frames;
+    }
+  }
+  Running = false;
+}
+
+
+#else   /* HAVE_ALSA */
+
+
+DCF77AlsaCapture::DCF77AlsaCapture()
+  : Running( false )
+  , StopReq( false )
+{
+  SampleRate = 48000.0;
+  ChanCount = 2;
+  FramesPerBuffer = 480;
+  Periods = 4;
+  MonotonicAdcTime = true;
+  HwTimestamps = false;
+  Xruns = 0;
+  CapturedFrames = 0;
+  pcm = 0;
+  PcmFormat = 0;
+  cb = 0;
+  cbUserData = 0;
+  TsFrame = -1;
+  TsTime = 0.0;
+}
+
+DCF77AlsaCapture::~DCF77AlsaCapture()
+{
+}
+
+bool DCF77AlsaCapture::open( const char * device, FILE * errstream )
+{
+  if ( errstream )
+    fprintf(errstream, "Error: ALSA device '%s': compiled without ALSA support\n", device);
+  return false;
+}
+
+void DCF77AlsaCapture::close()
+{
+}
+
+bool DCF77AlsaCapture::start( Callback, void *, FILE * )
+{
+  return false;
+}
+
+void DCF77AlsaCapture::stop()
+{
+}
+
+#endif  /* HAVE_ALSA */
+
@@ -0,0 +1,84 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77ALSA_H_
+#define _U775_DCF77ALSA_H_
+
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+#include "dcf77source.h"
+
+// Native ALSA capture with mmap access (Linux, needs HAVE_ALSA and -lasound).
+//
+// A capture thread waits for each period, takes the captured frames with
+// snd_pcm_mmap_begin() and passes them to the callback directly from the
+// DMA ring, before handing them back with snd_pcm_mmap_commit(): no copy
+// and no conversion. The requested Format is preferred, else FLOAT_LE,
+// S32_LE or S16_LE, whatever the hardware takes first.
+// ADC times are derived from the driver timestamp in snd_pcm_status(),
+// which is taken at the hardware pointer update (CLOCK_MONOTONIC).
+
+// FramesPerBuffer is the period size; adcTime is CLOCK_MONOTONIC.
+
+class DCF77AlsaCapture : public DCF77AudioSource
+{
+public:
+  DCF77AlsaCapture();
+  virtual ~DCF77AlsaCapture();
+
+  // set before open()
+  unsigned        Periods;
+
+  virtual const char * name() const { return "alsa"; }
+  virtual bool open( const char * device, FILE * errstream );
+  virtual void close();
+  bool isOpen() const { return 0 != pcm; }
+
+  virtual bool start( Callback cb, void * userData, FILE * errstream );
+  virtual void stop();
+  virtual bool isRunning() const { return Running.load(); }
+
+  // results of open()
+  bool            HwTimestamps;     // driver delivers timestamps
+  volatile unsigned Xruns;
+  volatile long long CapturedFrames;
+
+private:
+  void captureLoop();
+  double adcTimeOfFrame( long long frame );
+
+  void *            pcm;            // snd_pcm_t *
+  int               PcmFormat;      // snd_pcm_format_t
+  Callback          cb;
+  void *            cbUserData;
+  std::atomic<bool> Running;
+  std::atomic<bool> StopReq;
+  std::thread       Capture;
+  // last timestamp: hardware frame position and its time
+  long long         TsFrame;
+  double            TsTime;
+};
+
+#endif /* _U775_DCF77ALSA_H_ */
+
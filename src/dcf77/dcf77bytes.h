@@ -0,0 +1,97 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77BYTES_H_
+#define _U775_DCF77BYTES_H_
+
+#include <string.h>
+
+// little endian serialization helpers of the file formats (capture,
+// recordings, minute log) and of dcf77net datagrams
+
+inline void put16( unsigned char * p, unsigned v )
+{
+  p[0] = (unsigned char)( v );
+  p[1] = (unsigned char)( v >> 8 );
+}
+
+inline void put32( unsigned char * p, unsigned v )
+{
+  p[0] = (unsigned char)( v );
+  p[1] = (unsigned char)( v >> 8 );
+  p[2] = (unsigned char)( v >> 16 );
+  p[3] = (unsigned char)( v >> 24 );
+}
+
+inline void put64( unsigned char * p, long long v )
+{
+  put32( p, (unsigned)( v & 0xFFFFFFFF ) );
+  put32( p + 4, (unsigned)( (unsigned long long)v >> 32 ) );
+}
+
+inline void putFloat( unsigned char * p, float f )
+{
+  unsigned v;
+  memcpy( &v, &f, 4 );
+  put32( p, v );
+}
+
+inline void putDouble( unsigned char * p, double d )
+{
+  long long v;
+  memcpy( &v, &d, 8 );
+  put64( p, v );
+}
+
+inline unsigned get16( const unsigned char * p )
+{
+  return (unsigned)p[0] | ( (unsigned)p[1] << 8 );
+}
+
+inline unsigned get32( const unsigned char * p )
+{
+  return (unsigned)p[0] | ( (unsigned)p[1] << 8 ) | ( (unsigned)p[2] << 16 ) | ( (unsigned)p[3] << 24 );
+}
+
+inline long long get64( const unsigned char * p )
+{
+  return (long long)( (unsigned long long)get32( p ) | ( (unsigned long long)get32( p + 4 ) << 32 ) );
+}
+
+inline float getFloat( const unsigned char * p )
+{
+  unsigned v = get32( p );
+  float f;
+  memcpy( &f, &v, 4 );
+  return f;
+}
+
+inline double getDouble( const unsigned char * p )
+{
+  long long v = get64( p );
+  double d;
+  memcpy( &d, &v, 8 );
+  return d;
+}
+
+#endif /* _U775_DCF77BYTES_H_ */
+
@@ -0,0 +1,180 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "dcf77file.h"
+#include "dcf77bytes.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+DCF77CaptureFile::DCF77CaptureFile()
+{
+  SampleRate = 48000.0;
+  ChanCount = 1;
+  SampleFormat = FMT_FLOAT32;
+  FrameCount = 0;
+  IsWav = false;
+
+  fd = -1;
+  Map = 0;
+  MapSize = 0;
+  Data = 0;
+}
+
+
+DCF77CaptureFile::~DCF77CaptureFile()
+{
+  close();
+}
+
+
+void DCF77CaptureFile::close()
+{
+  if ( Map )
+    munmap( (void*)Map, MapSize );
+  if ( fd >= 0 )
+    ::close( fd );
+  Map = Data = 0;
+  fd = -1;
+  MapSize = 0;
+  FrameCount = 0;
+}
+
+
+bool DCF77CaptureFile::open( const char * filename, FILE * errstream )
+{
+  struct stat st;
+
+  close();
+  fd = ::open( filename, O_RDONLY );
+  if ( fd < 0 || fstat( fd, &st ) || st.st_size <= 0 )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not open capture file '%s': %s\n", filename, strerror(errno) );
+    close();
+    return false;
+  }
+
+  MapSize = st.st_size;
+  void * p = mmap( 0, MapSize, PROT_READ, MAP_SHARED, fd, 0 );
+  if ( MAP_FAILED == p )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not map capture file '%s': %s\n", filename, strerror(errno) );
+    Map = 0;
+    close();
+    return false;
+  }
+  Map = (const unsigned char *)p;
+  // data is read sequentially by each reader
+  madvise( p, MapSize, MADV_SEQUENTIAL );
+
+  IsWav = ( MapSize >= 12 && !memcmp( Map, "RIFF", 4 ) && !memcmp( Map + 8, "WAVE", 4 ) );
+  if ( IsWav )
+    return parseWav( errstream );
+
+  Data = Map;
+  const unsigned bytesPerFrame = ChanCount * ( FMT_INT16 == SampleFormat ? 2 : 4 );
+  FrameCount = MapSize / bytesPerFrame;
+  return true;
+}
+
+
+bool DCF77CaptureFile::parseWav( FILE * errstream )
+{
+  long long off = 12;
+  bool haveFmt = false;
+
+  while ( off + 8 <= MapSize )
+  {
+    const unsigned char * ck = Map + off;
+    long long size = get32( ck + 4 );
+
+    if ( !memcmp( ck, "fmt ", 4 ) && size >= 16 )
+    {
+      const unsigned tag = get16( ck + 8 );
+      const unsigned bits = get16( ck + 22 );
+      ChanCount = get16( ck + 10 );
+      SampleRate = get32( ck + 12 );
+      if ( 1 == tag && 16 == bits )
+        SampleFormat = FMT_INT16;
+      else if ( 3 == tag && 32 == bits )
+        SampleFormat = FMT_FLOAT32;
+      else
+      {
+        if ( errstream )
+          fprintf(errstream, "Error: unsupported WAV format %u with %u bits\n", tag, bits);
+        return false;
+      }
+      haveFmt = true;
+    }
+    else if ( !memcmp( ck, "data", 4 ) && haveFmt )
+    {
+      // size of last chunk is often wrong, when the writer got killed
+      if ( size > MapSize - off - 8 || 0 == size )
+        size = MapSize - off - 8;
+      Data = ck + 8;
+      FrameCount = size / ( ChanCount * ( FMT_INT16 == SampleFormat ? 2 : 4 ) );
+      return true;
+    }
+    off += 8 + size + ( size & 1 );
+  }
+
+  if ( errstream )
+    fprintf(errstream, "Error: WAV file without fmt/data chunk\n");
+  return false;
+}
+
+
+const float * DCF77CaptureFile::floatData( long long frame ) const
+{
+  if ( FMT_FLOAT32 != SampleFormat || !Data )
+    return 0;
+  return (const float *)Data + frame * ChanCount;
+}
+
+
+void DCF77CaptureFile::readFloat( long long frame, unsigned frames, float * out ) const
+{
+  const unsigned n = frames * ChanCount;
+  unsigned i;
+
+  if ( FMT_FLOAT32 == SampleFormat )
+    memcpy( out, floatData( frame ), n * sizeof(float) );
+  else
+  {
+    const short * in = (const short *)Data + frame * ChanCount;
+    for ( i = 0; i < n; ++i )
+      out[i] = in[i] * ( 1.0F / 32768.0F );
+  }
+}
+
@@ -0,0 +1,72 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77FILE_H_
+#define _U775_DCF77FILE_H_
+
+#include <stdio.h>
+
+// Read only, memory mapped capture file: WAV (PCM int16 or float32)
+// or headerless raw PCM. The whole file is mapped, so multiple threads
+// may read different ranges concurrently without any locking.
+// POSIX only (mmap).
+
+class DCF77CaptureFile
+{
+public:
+  DCF77CaptureFile();
+  ~DCF77CaptureFile();
+
+  typedef enum
+  {
+      FMT_INT16
+    , FMT_FLOAT32
+  }
+    Format;
+
+  // for raw files set SampleRate, ChanCount and SampleFormat before open()
+  bool open( const char * filename, FILE * errstream );
+  void close();
+
+  // pointer to interleaved float samples of frame,
+  // NULL if file is not float32 (zero copy access)
+  const float * floatData( long long frame ) const;
+  // convert frames (all channels, interleaved) to float
+  void readFloat( long long frame, unsigned frames, float * out ) const;
+
+  double          SampleRate;
+  unsigned        ChanCount;
+  Format          SampleFormat;
+  long long       FrameCount;
+  bool            IsWav;
+
+private:
+  bool parseWav( FILE * errstream );
+
+  int             fd;
+  const unsigned char * Map;
+  long long       MapSize;
+  const unsigned char * Data;
+};
+
+#endif /* _U775_DCF77FILE_H_ */
+
@@ -0,0 +1,166 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77hold.h"
+
+#include <math.h>
+#include <string.h>
+
+
+DCF77Holdover::DCF77Holdover()
+{
+  MeasSigma = 0.005;
+  QPhase = 1E-8;
+  QFreq = 1E-16;      // ~ 3 ppm per day
+  QDrift = 1E-24;
+  Gate = 5.0;
+  MaxRejects = 3;
+  reset();
+}
+
+
+void DCF77Holdover::reset()
+{
+  Fixes = 0;
+  Rejected = 0;
+  RejectRun = 0;
+  LastFixLocal = 0.0;
+  LastInnovation = 0.0;
+  RefLocal = 0.0;
+  RefUtc = 0;
+  T = 0.0;
+  memset( X, 0, sizeof(X) );
+  memset( P, 0, sizeof(P) );
+}
+
+
+void DCF77Holdover::predict( double dt, double x[3], double p[3][3] ) const
+{
+  const double F[3][3] = { { 1.0, dt, 0.5 * dt * dt }, { 0.0, 1.0, dt }, { 0.0, 0.0, 1.0 } };
+  const double dt2 = dt * dt, dt3 = dt2 * dt;
+  const double Q[3][3] =
+  {   { QPhase * dt + QFreq * dt3 / 3.0 + QDrift * dt3 * dt2 / 20.0
+      , QFreq * dt2 / 2.0 + QDrift * dt2 * dt2 / 8.0
+      , QDrift * dt3 / 6.0 }
+    , { 0.0, QFreq * dt + QDrift * dt3 / 3.0, QDrift * dt2 / 2.0 }
+    , { 0.0, 0.0, QDrift * dt }
+  };
+  double FP[3][3];
+  int i, j, k;
+
+  for ( i = 0; i < 3; ++i )
+  {
+    x[i] = 0.0;
+    for ( k = 0; k < 3; ++k )
+      x[i] += F[i][k] * X[k];
+  }
+  for ( i = 0; i < 3; ++i )
+    for ( j = 0; j < 3; ++j )
+    {
+      FP[i][j] = 0.0;
+      for ( k = 0; k < 3; ++k )
+        FP[i][j] += F[i][k] * P[k][j];
+    }
+  for ( i = 0; i < 3; ++i )
+    for ( j = 0; j < 3; ++j )
+    {
+      p[i][j] = ( i <= j ) ? Q[i][j] : Q[j][i];
+      for ( k = 0; k < 3; ++k )
+        p[i][j] += FP[i][k] * F[j][k];
+    }
+}
+
+
+bool DCF77Holdover::addFix( double localTime, long long utc )
+{
+  if ( !Fixes )
+  {
+    RefLocal = localTime;
+    RefUtc = utc;
+    T = 0.0;
+    memset( X, 0, sizeof(X) );
+    memset( P, 0, sizeof(P) );
+    P[0][0] = MeasSigma * MeasSigma;
+    P[1][1] = 100E-6 * 100E-6;          // unknown oscillator: +/- 100 ppm
+    P[2][2] = 1E-11 * 1E-11;
+    Fixes = 1;
+    RejectRun = 0;
+    LastFixLocal = localTime;
+    LastInnovation = 0.0;
+    return true;
+  }
+
+  const double t = localTime - RefLocal;
+  double x[3], p[3][3];
+  predict( t - T, x, p );
+
+  // measured phase: UTC - local
+  const double z = (double)( utc - RefUtc ) - t;
+  const double innov = z - x[0];
+  const double S = p[0][0] + MeasSigma * MeasSigma;
+  LastInnovation = innov;
+
+  if ( fabs( innov ) > Gate * sqrt( S ) + 2.0 * MeasSigma )
+  {
+    ++Rejected;
+    if ( ++RejectRun >= MaxRejects )
+    {
+      // the model is wrong, not the decoder: e.g. local clock was stepped
+      Fixes = 0;
+      return addFix( localTime, utc );
+    }
+    return false;
+  }
+
+  int i, j;
+  double K[3];
+  for ( i = 0; i < 3; ++i )
+    K[i] = p[i][0] / S;
+  for ( i = 0; i < 3; ++i )
+  {
+    X[i] = x[i] + K[i] * innov;
+    for ( j = 0; j < 3; ++j )
+      P[i][j] = p[i][j] - K[i] * p[0][j];
+  }
+  T = t;
+  ++Fixes;
+  RejectRun = 0;
+  LastFixLocal = localTime;
+  return true;
+}
+
+
+bool DCF77Holdover::estimate( double localTime, double * utc, double * sigma ) const
+{
+  if ( !Fixes )
+    return false;
+  const double t = localTime - RefLocal;
+  double x[3], p[3][3];
+  predict( t - T, x, p );
+  if ( utc )
+    *utc = (double)RefUtc + t + x[0];
+  if ( sigma )
+    *sigma = sqrt( p[0][0] );
+  return true;
+}
+
@@ -0,0 +1,79 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77HOLD_H_
+#define _U775_DCF77HOLD_H_
+
+// Holdover clock model: UTC as function of a local clock (seconds of
+// CLOCK_MONOTONIC / steady_clock), learned from valid minute edges.
+//
+// Kalman filter with state phase (UTC - local), frequency offset and
+// frequency drift of the local clock. Between fixes the estimate keeps
+// running with the learned frequency and drift, its error bound grows
+// with the process noise. Fixes far off the prediction are rejected as
+// wrong decodes; several in a row restart the model.
+
+class DCF77Holdover
+{
+public:
+  DCF77Holdover();
+
+  // model parameters (seconds)
+  double      MeasSigma;      // of a minute edge
+  double      QPhase;         // white phase noise, s^2 / s
+  double      QFreq;          // random walk of frequency, 1 / s
+  double      QDrift;         // random walk of drift, 1 / s^3
+  double      Gate;           // reject fixes off by more than Gate sigma
+  unsigned    MaxRejects;     // restart after that many rejects in a row
+
+  void reset();
+
+  // valid minute: local time of minute edge and its decoded UTC (unix time).
+  // false if rejected
+  bool addFix( double localTime, long long utc );
+
+  bool valid() const { return Fixes > 0; }
+  // UTC at localTime with 1 sigma error bound. false without any fix
+  bool estimate( double localTime, double * utc, double * sigma ) const;
+
+  double freqPpm() const { return X[1] * 1E6; }
+  double driftPpmPerDay() const { return X[2] * 1E6 * 86400.0; }
+
+  unsigned    Fixes;          // accepted since reset()
+  unsigned    Rejected;       // since reset()
+  double      LastFixLocal;
+  double      LastInnovation; // of last addFix(), seconds
+
+private:
+  // X, P at localTime + dt
+  void predict( double dt, double x[3], double p[3][3] ) const;
+
+  double      RefLocal;       // model time origin
+  long long   RefUtc;
+  double      T;              // local time of X, P, relative to RefLocal
+  double      X[3];
+  double      P[3][3];
+  unsigned    RejectRun;
+};
+
+#endif /* _U775_DCF77HOLD_H_ */
+
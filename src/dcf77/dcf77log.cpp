@@ -0,0 +1,431 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "dcf77log.h"
+#include "dcf77.h"
+#include "dcf77bytes.h"
+
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <string>
+
+#ifdef _MSC_VER
+  #define log_fseek   _fseeki64
+  #define log_ftell   _ftelli64
+  #define timegm      _mkgmtime
+  #define log_truncate( fp, size )  _chsize_s( _fileno( fp ), size )
+  #include <io.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #define log_fseek   fseeko
+  #define log_ftell   ftello
+  #define log_truncate( fp, size )  ftruncate( fileno( fp ), size )
+#endif
+
+#define LOG_HEADER_SIZE   16
+#define LOG_IDXREC_SIZE   40
+
+
+long long dcf77ToUtc( const struct tm * tms, int tzIdx )
+{
+  struct tm t = *tms;
+  t.tm_isdst = 0;
+  // 1 == MESZ (UTC+2), 2 == MEZ (UTC+1)
+  return (long long)timegm( &t ) - ( 1 == tzIdx ? 7200 : 3600 );
+}
+
+
+void DCF77MinuteRecord::fromDecoder( const DCF77 & dcf, const struct tm * tms, int tzIdx, bool ok )
+{
+  double sinceEdge = dcf.FramesSinceLastMinPulse;
+
+  if ( dcf.PrnCorrValid )
+    sinceEdge -= dcf.PrnCorrFrames;
+  EdgeTimeNs = (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::system_clock::now().time_since_epoch() ).count()
+             - (long long)( 1E9 * sinceEdge / dcf.frameRate() );
+  UtcMinute = ok ? dcf77ToUtc( tms, tzIdx ) : -1;
+  ValueMask = (unsigned long long)( dcf.EvalValueMaskLo & 0x1FFFFFFF )
+            | ( (unsigned long long)( dcf.EvalValueMaskHi & 0x3FFFFFFF ) << 29 );
+  ValidMask = (unsigned long long)( dcf.EvalValidMaskLo & 0x1FFFFFFF )
+            | ( (unsigned long long)( dcf.EvalValidMaskHi & 0x3FFFFFFF ) << 29 );
+  ErrorCode = dcf.EvalError;
+  Threshold = dcf.Threshold;
+  PrnCorrUs = dcf.PrnCorrValid ? (float)( 1E6 * dcf.PrnCorrFrames / dcf.frameRate() ) : 0.0F;
+  TzIdx = ok ? tzIdx : 0;
+}
+
+
+void DCF77MinuteRecord::encode( unsigned char * r ) const
+{
+  memset( r, 0, Size );
+  put64( r, EdgeTimeNs );
+  put64( r + 8, UtcMinute );
+  put64( r + 16, (long long)ValueMask );
+  put64( r + 24, (long long)ValidMask );
+  put32( r + 32, DeviceId );
+  put32( r + 36, (unsigned)ErrorCode );
+  putFloat( r + 40, JitterMeanMs );
+  putFloat( r + 44, JitterMaxMs );
+  putFloat( r + 48, Threshold );
+  putFloat( r + 52, PrnCorrUs );
+  put32( r + 56, PulseCount );
+  r[60] = (unsigned char)TzIdx;
+}
+
+
+void DCF77MinuteRecord::decode( const unsigned char * r )
+{
+  EdgeTimeNs = get64( r );
+  UtcMinute = get64( r + 8 );
+  ValueMask = (unsigned long long)get64( r + 16 );
+  ValidMask = (unsigned long long)get64( r + 24 );
+  DeviceId = get32( r + 32 );
+  ErrorCode = (int)get32( r + 36 );
+  JitterMeanMs = getFloat( r + 40 );
+  JitterMaxMs = getFloat( r + 44 );
+  Threshold = getFloat( r + 48 );
+  PrnCorrUs = getFloat( r + 52 );
+  PulseCount = get32( r + 56 );
+  TzIdx = r[60];
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+DCF77MinuteLog::DCF77MinuteLog()
+{
+  fp = fpIdx = 0;
+  RecordCount = 0;
+}
+
+
+DCF77MinuteLog::~DCF77MinuteLog()
+{
+  close();
+}
+
+
+bool DCF77MinuteLog::open( const char * filename, FILE * errstream )
+{
+  unsigned char hdr[LOG_HEADER_SIZE];
+  const std::string idxname = std::string( filename ) + ".idx";
+
+  close();
+  // not "ab": a partial record at the end has to be cut off first
+  fp = fopen( filename, "r+b" );
+  if ( !fp && ENOENT == errno )
+    fp = fopen( filename, "w+b" );
+  if ( !fp )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not open minute log '%s': %s\n", filename, strerror(errno) );
+    close();
+    return false;
+  }
+
+  log_fseek( fp, 0, SEEK_END );
+  const long long size = log_ftell( fp );
+  if ( 0 == size )
+  {
+    memset( hdr, 0, sizeof(hdr) );
+    memcpy( hdr, "U775LOG1", 8 );
+    put32( hdr + 8, RecordSize );
+    fwrite( hdr, sizeof(hdr), 1, fp );
+    RecordCount = 0;
+  }
+  else
+  {
+    log_fseek( fp, 0, SEEK_SET );
+    if ( size < LOG_HEADER_SIZE || 1 != fread( hdr, sizeof(hdr), 1, fp )
+      || memcmp( hdr, "U775LOG1", 8 ) || RecordSize != get32( hdr + 8 ) )
+    {
+      if ( errstream )
+        fprintf(errstream, "Error: '%s' is no U77,5 minute log or has another record size\n", filename);
+      close();
+      return false;
+    }
+    RecordCount = ( size - LOG_HEADER_SIZE ) / RecordSize;
+    const long long used = LOG_HEADER_SIZE + RecordCount * RecordSize;
+    if ( used != size )
+    {
+      // crash while appending
+      if ( errstream )
+        fprintf(errstream, "Warning: partial record at end of minute log '%s'. truncating it\n", filename);
+      fflush( fp );
+      if ( log_truncate( fp, used ) )
+      {
+        if ( errstream )
+          fprintf(errstream, "Error: could not truncate minute log '%s': %s\n", filename, strerror(errno) );
+        close();
+        return false;
+      }
+    }
+    log_fseek( fp, 0, SEEK_END );
+  }
+
+  fpIdx = fopen( idxname.c_str(), "ab" );
+  if ( !fpIdx )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not open index of minute log '%s': %s\n", filename, strerror(errno) );
+    close();
+    return false;
+  }
+
+  // index entries exist only for complete blocks: drop a half written one
+  log_fseek( fpIdx, 0, SEEK_END );
+  const long long idxCount = log_ftell( fpIdx ) / LOG_IDXREC_SIZE;
+  if ( idxCount * BlockRecords > RecordCount || log_ftell( fpIdx ) % LOG_IDXREC_SIZE )
+  {
+    if ( errstream )
+      fprintf(errstream, "Warning: index of minute log '%s' inconsistent. removing it\n", filename);
+    fclose( fpIdx );
+    fpIdx = fopen( idxname.c_str(), "wb" );
+    if ( !fpIdx )
+    {
+      close();
+      return false;
+    }
+  }
+
+  // records of current block written before open() are not summarized
+  BlockPartial = ( 0 != RecordCount % BlockRecords );
+  BlockErrors = 0;
+  BlockMinEdge = 0x7FFFFFFFFFFFFFFFLL;
+  BlockMaxEdge = -BlockMinEdge;
+  BlockDevices = 0;
+  return true;
+}
+
+
+void DCF77MinuteLog::close()
+{
+  if ( fp )
+    fclose( fp );
+  if ( fpIdx )
+    fclose( fpIdx );
+  fp = fpIdx = 0;
+}
+
+
+bool DCF77MinuteLog::append( const DCF77MinuteRecord & rec )
+{
+  unsigned char r[RecordSize];
+
+  if ( !fp )
+    return false;
+
+  rec.encode( r );
+  if ( 1 != fwrite( r, sizeof(r), 1, fp ) )
+    return false;
+  fflush( fp );
+  ++RecordCount;
+
+  if ( rec.ErrorCode )
+    ++BlockErrors;
+  if ( rec.EdgeTimeNs < BlockMinEdge )
+    BlockMinEdge = rec.EdgeTimeNs;
+  if ( rec.EdgeTimeNs > BlockMaxEdge )
+    BlockMaxEdge = rec.EdgeTimeNs;
+  BlockDevices |= 1ULL << ( rec.DeviceId & 63 );
+
+  if ( 0 == RecordCount % BlockRecords )
+    flushBlock();
+  return true;
+}
+
+
+void DCF77MinuteLog::flushBlock()
+{
+  unsigned char r[LOG_IDXREC_SIZE];
+
+  // incomplete summary: mark block as "all devices, whole time range"
+  if ( BlockPartial )
+  {
+    BlockMinEdge = -0x7FFFFFFFFFFFFFFFLL;
+    BlockMaxEdge = 0x7FFFFFFFFFFFFFFFLL;
+    BlockDevices = ~0ULL;
+  }
+
+  memset( r, 0, sizeof(r) );
+  put64( r, RecordCount - BlockRecords );
+  put32( r + 8, BlockErrors );
+  put64( r + 16, BlockMinEdge );
+  put64( r + 24, BlockMaxEdge );
+  put64( r + 32, (long long)BlockDevices );
+  fwrite( r, sizeof(r), 1, fpIdx );
+  fflush( fpIdx );
+
+  BlockErrors = 0;
+  BlockMinEdge = 0x7FFFFFFFFFFFFFFFLL;
+  BlockMaxEdge = -BlockMinEdge;
+  BlockDevices = 0;
+  BlockPartial = false;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+DCF77MinuteLogReader::DCF77MinuteLogReader()
+{
+  Map = 0;
+  MapSize = 0;
+  fd = -1;
+  RecordCount = 0;
+  BlocksScanned = 0;
+}
+
+
+DCF77MinuteLogReader::~DCF77MinuteLogReader()
+{
+  close();
+}
+
+
+void DCF77MinuteLogReader::close()
+{
+#ifndef _MSC_VER
+  if ( Map )
+    munmap( (void*)Map, MapSize );
+  if ( fd >= 0 )
+    ::close( fd );
+#endif
+  Map = 0;
+  fd = -1;
+  RecordCount = 0;
+  Blocks.clear();
+}
+
+
+bool DCF77MinuteLogReader::open( const char * filename, FILE * errstream )
+{
+#ifdef _MSC_VER
+  // queries need mmap. writing the log works everywhere
+  close();
+  if ( errstream )
+    fprintf(errstream, "Error: minute log queries not available on this platform: '%s'\n", filename);
+  return false;
+#else
+  struct stat st;
+  const std::string idxname = std::string( filename ) + ".idx";
+  unsigned char r[LOG_IDXREC_SIZE];
+
+  close();
+  fd = ::open( filename, O_RDONLY );
+  if ( fd < 0 || fstat( fd, &st ) || st.st_size < LOG_HEADER_SIZE )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not open minute log '%s'\n", filename);
+    close();
+    return false;
+  }
+  MapSize = st.st_size;
+  void * p = mmap( 0, MapSize, PROT_READ, MAP_SHARED, fd, 0 );
+  if ( MAP_FAILED == p )
+  {
+    close();
+    return false;
+  }
+  Map = (const unsigned char *)p;
+  if ( memcmp( Map, "U775LOG1", 8 ) || DCF77MinuteLog::RecordSize != get32( Map + 8 ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: '%s' is no U77,5 minute log\n", filename);
+    close();
+    return false;
+  }
+  RecordCount = ( MapSize - LOG_HEADER_SIZE ) / DCF77MinuteLog::RecordSize;
+
+  FILE * f = fopen( idxname.c_str(), "rb" );
+  while ( f && 1 == fread( r, sizeof(r), 1, f ) )
+  {
+    Block b;
+    b.first = get64( r );
+    b.errors = get32( r + 8 );
+    b.minEdge = get64( r + 16 );
+    b.maxEdge = get64( r + 24 );
+    b.devices = (unsigned long long)get64( r + 32 );
+    if ( b.first + DCF77MinuteLog::BlockRecords > RecordCount )
+      break;
+    Blocks.push_back( b );
+  }
+  if ( f )
+    fclose( f );
+  return true;
+#endif
+}
+
+
+long long DCF77MinuteLogReader::query( long long fromNs, long long toNs, int device, Callback cb, void * ctx )
+{
+  long long found = 0;
+  long long rno = 0;
+  size_t bno = 0;
+
+  BlocksScanned = 0;
+  while ( rno < RecordCount )
+  {
+    long long end = RecordCount;
+    if ( bno < Blocks.size() && Blocks[bno].first > rno )
+      end = Blocks[bno].first;    // records without index entry
+    else if ( bno < Blocks.size() )
+    {
+      const Block & b = Blocks[bno++];
+      rno = b.first;
+      end = b.first + DCF77MinuteLog::BlockRecords;
+      if ( b.maxEdge < fromNs || b.minEdge >= toNs
+        || ( device >= 0 && !( b.devices & ( 1ULL << ( device & 63 ) ) ) ) )
+      {
+        rno = end;
+        continue;
+      }
+    }
+    ++BlocksScanned;
+
+    for ( ; rno < end; ++rno )
+    {
+      const unsigned char * r = Map + LOG_HEADER_SIZE + rno * DCF77MinuteLog::RecordSize;
+      const long long edge = get64( r );
+      if ( edge < fromNs || edge >= toNs )
+        continue;
+      if ( device >= 0 && get32( r + 32 ) != (unsigned)device )
+        continue;
+      DCF77MinuteRecord rec;
+      rec.decode( r );
+      ++found;
+      if ( !cb( rec, ctx ) )
+        return found;
+    }
+  }
+  return found;
+}
+
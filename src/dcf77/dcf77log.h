@@ -0,0 +1,130 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77LOG_H_
+#define _U775_DCF77LOG_H_
+
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+class DCF77;
+
+// Append-only binary log of evaluated minutes.
+//
+// <file>      header "U775LOG1", record size; then fixed size records
+// <file>.idx  one summary per complete block of BlockRecords records:
+//             first record, error count, min/max edge time, device bits
+// Queries read the index and only touch blocks overlapping the requested
+// time range and device. Records after the last complete block are
+// always scanned. All values little endian.
+
+struct DCF77MinuteRecord
+{
+  long long     EdgeTimeNs;     // host clock (UTC) at minute edge
+  long long     UtcMinute;      // decoded minute as unix time, -1 if invalid
+  unsigned long long ValueMask; // DCF bits 58 .. 0
+  unsigned long long ValidMask;
+  unsigned      DeviceId;
+  int           ErrorCode;      // DCF77::EvalErrorCode
+  float         JitterMeanMs;   // mean absolute second jitter of minute
+  float         JitterMaxMs;
+  float         Threshold;
+  float         PrnCorrUs;      // 0 if not available
+  unsigned      PulseCount;     // evaluated second pulses in minute
+  int           TzIdx;
+
+  // fill masks, error code, decoded time and edge time from decoder
+  void fromDecoder( const DCF77 & dcf, const struct tm * tms, int tzIdx, bool ok );
+
+  // Size bytes, little endian: record of the log file and of dcf77net
+  enum { Size = 64 };
+  void encode( unsigned char * r ) const;
+  void decode( const unsigned char * r );
+};
+
+
+class DCF77MinuteLog
+{
+public:
+  DCF77MinuteLog();
+  ~DCF77MinuteLog();
+
+  enum { RecordSize = DCF77MinuteRecord::Size, BlockRecords = 256 };
+
+  bool open( const char * filename, FILE * errstream );
+  void close();
+  bool append( const DCF77MinuteRecord & rec );
+
+private:
+  void flushBlock();
+
+  FILE *          fp;
+  FILE *          fpIdx;
+  long long       RecordCount;
+  // summary of current block
+  bool            BlockPartial;
+  unsigned        BlockErrors;
+  long long       BlockMinEdge;
+  long long       BlockMaxEdge;
+  unsigned long long BlockDevices;
+};
+
+
+class DCF77MinuteLogReader
+{
+public:
+  DCF77MinuteLogReader();
+  ~DCF77MinuteLogReader();
+
+  bool open( const char * filename, FILE * errstream );
+  void close();
+
+  // records with edge time in [fromNs, toNs) of device (< 0: any device)
+  // in file order. callback returns false to stop
+  typedef bool (*Callback)( const DCF77MinuteRecord & rec, void * ctx );
+  long long query( long long fromNs, long long toNs, int device, Callback cb, void * ctx );
+
+  long long       RecordCount;
+  long long       BlocksScanned;    // statistics of last query
+
+private:
+  struct Block
+  {
+    long long     first;
+    unsigned      errors;
+    long long     minEdge;
+    long long     maxEdge;
+    unsigned long long devices;
+  };
+
+  const unsigned char * Map;
+  long long       MapSize;
+  int             fd;
+  std::vector<Block> Blocks;
+};
+
+// unix time from DCF local time (MEZ / MESZ)
+long long dcf77ToUtc( const struct tm * tms, int tzIdx );
+
+#endif /* _U775_DCF77LOG_H_ */
+
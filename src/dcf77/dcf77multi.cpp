@@ -0,0 +1,200 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77multi.h"
+
+
+DCF77Multi::DCF77Multi()
+{
+}
+
+
+DCF77Multi::~DCF77Multi()
+{
+  init( 0, 48000.0 );
+}
+
+
+void DCF77Multi::init( unsigned streams, double sampleRate )
+{
+  size_t s;
+
+  for ( s = 0; s < Streams.size(); ++s )
+    delete Streams[s];
+  Streams.resize( streams );
+  for ( s = 0; s < streams; ++s )
+  {
+    Streams[s] = new DCF77();
+    Streams[s]->SampleRate = sampleRate;
+    Streams[s]->ChanCount = 1;
+    Streams[s]->ChanIdx = 0;
+    Streams[s]->initGetThreshold();
+  }
+  InTime.resize( streams );
+  Sign.resize( streams );
+  ThreshHigh.resize( streams );
+  ThreshLow.resize( streams );
+  High.resize( streams );
+  Pending.resize( streams );
+  PendingAt.resize( streams );
+  Dwell.resize( streams );
+  Debounce.resize( streams );
+  ReSync.resize( streams );
+  Max.resize( streams );
+  Sum.resize( streams );
+}
+
+
+// W streams from s0: same steps as DCF77::newDataT() for float samples,
+// with ifs turned into masks
+template <unsigned W>
+void DCF77Multi::group( unsigned s0, unsigned framecount, const float * data, unsigned stride )
+{
+  float     sign[W], thHigh[W], thLow[W], mx[W];
+  double    sum[W];
+  int       inTime[W], high[W], pend[W], at[W], dwell[W], deb[W], edge[W];
+  unsigned  i, l;
+  int       anyTime = 0, anyThresh = 0;
+
+  for ( l = 0; l < W; ++l )
+  {
+    sign[l] = Sign[s0 + l];
+    thHigh[l] = ThreshHigh[s0 + l];
+    thLow[l] = ThreshLow[s0 + l];
+    inTime[l] = InTime[s0 + l];
+    high[l] = High[s0 + l];
+    pend[l] = Pending[s0 + l];
+    at[l] = PendingAt[s0 + l];
+    dwell[l] = Dwell[s0 + l];
+    deb[l] = Debounce[s0 + l];
+    mx[l] = data[s0 + l] * sign[l];
+    sum[l] = 0.0;
+    anyTime |= inTime[l];
+    anyThresh |= !inTime[l];
+  }
+
+  if ( anyThresh )
+  {
+    const float * x = data + s0;
+    for ( i = 0; i < framecount; ++i, x += stride )
+      for ( l = 0; l < W; ++l )
+      {
+        const float v = x[l] * sign[l];
+        mx[l] = ( v > mx[l] ) ? v : mx[l];
+        sum[l] += v;
+      }
+  }
+
+  if ( anyTime )
+  {
+    const float * x = data + s0;
+    for ( i = 0; i < framecount; ++i, x += stride )
+    {
+      int any = 0;
+      for ( l = 0; l < W; ++l )
+      {
+        const float v = x[l] * sign[l];
+        const int up = ( v >= thHigh[l] );
+        const int down = ( v < thLow[l] );
+        // leaving this side of the hysteresis band / bouncing back
+        const int other = high[l] ? down : up;
+        const int back = high[l] ? up : down;
+        const int start = ( !pend[l] ) & other;
+        const int keep = pend[l] & ( !back );
+        pend[l] = start | keep;
+        at[l] = start ? (int)i : at[l];
+        dwell[l] = start ? 1 : dwell[l] + keep;
+        edge[l] = pend[l] & ( dwell[l] >= deb[l] ) & inTime[l];
+        any |= edge[l];
+      }
+      if ( !any )
+        continue;
+      for ( l = 0; l < W; ++l )
+      {
+        if ( !edge[l] )
+          continue;
+        pend[l] = 0;
+        high[l] = !high[l];
+        if ( Streams[s0 + l]->comparatorEdge( at[l], 0 != high[l], framecount ) )
+          ReSync[s0 + l] = 1;
+      }
+    }
+  }
+
+  for ( l = 0; l < W; ++l )
+  {
+    High[s0 + l] = high[l];
+    Pending[s0 + l] = pend[l];
+    PendingAt[s0 + l] = at[l];
+    Dwell[s0 + l] = dwell[l];
+    Max[s0 + l] = mx[l];
+    Sum[s0 + l] = sum[l];
+  }
+}
+
+
+void DCF77Multi::newData( unsigned framecount, const float * data, unsigned stride )
+{
+  const unsigned n = size();
+  unsigned s;
+
+  if ( !framecount )
+    return;
+
+  for ( s = 0; s < n; ++s )
+  {
+    DCF77 & d = *Streams[s];
+    InTime[s] = ( DCF77::STATE_GET_TIME == d.eState );
+    Sign[s] = d.Invert ? -1.0F : 1.0F;
+    ThreshHigh[s] = d.Threshold;
+    ThreshLow[s] = d.ThresholdLow;
+    High[s] = d.CmpHigh;
+    Pending[s] = d.CmpPending;
+    PendingAt[s] = d.CmpPendingAt;
+    Dwell[s] = (int)d.CmpDwell;
+    Debounce[s] = (int)d.DebounceFrames;
+    ReSync[s] = 0;
+    if ( InTime[s] )
+      d.timeBlockBegin( framecount );
+  }
+
+  for ( s = 0; s + LANES <= n; s += LANES )
+    group<LANES>( s, framecount, data, stride );
+  for ( ; s < n; ++s )
+    group<1>( s, framecount, data, stride );
+
+  for ( s = 0; s < n; ++s )
+  {
+    DCF77 & d = *Streams[s];
+    if ( !InTime[s] )
+    {
+      d.thresholdBlock( framecount, Max[s], Sum[s] );
+      continue;
+    }
+    d.CmpHigh = ( 0 != High[s] );
+    d.CmpPending = ( 0 != Pending[s] );
+    d.CmpPendingAt = PendingAt[s] - (int)framecount;
+    d.CmpDwell = (unsigned)Dwell[s];
+    d.LastSample = data[ (size_t)( framecount - 1 ) * stride + s ] * Sign[s];
+    d.timeBlockEnd( framecount, 0 != ReSync[s] );
+  }
+}
@@ -0,0 +1,82 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _U775_DCF77MULTI_H_
+#define _U775_DCF77MULTI_H_
+
+#include <vector>
+
+#include "dcf77.h"
+
+// Many independent DCF77 decoders over one interleaved float input, e.g.
+// a replay farm or a multi channel capture: sample of stream s in frame i
+// at data[ i * stride + s ].
+//
+// The per sample work of DCF77::newData() (comparator with hysteresis and
+// debounce, threshold statistics) runs for LANES streams at once on
+// struct-of-arrays state, branch free, so that the compiler vectorizes it.
+// Edges come out as a mask; only streams with an edge enter the scalar
+// pulse logic of their DCF77 object. Results are those of separate
+// DCF77::newData() calls with the same blocks.
+//
+// Comparator state is loaded from the DCF77 objects per block and stored
+// back: set parameters (Invert, Hysteresis, UseTrellis, ..) on stream(s)
+// as for a single decoder; read minutes from it as usual.
+
+class DCF77Multi
+{
+public:
+  DCF77Multi();
+  ~DCF77Multi();
+
+  enum { LANES = 16 };
+
+  // streams decoders at sampleRate, in STATE_GET_THRESH
+  void init( unsigned streams, double sampleRate );
+  unsigned size() const { return (unsigned)Streams.size(); }
+  DCF77 & stream( unsigned s ) { return *Streams[s]; }
+
+  void newData( unsigned framecount, const float * data, unsigned stride );
+
+private:
+  template <unsigned W>
+  void group( unsigned s0, unsigned framecount, const float * data, unsigned stride );
+
+  std::vector<DCF77 *> Streams;
+
+  // struct-of-arrays: one element per stream
+  std::vector<int>      InTime;       // STATE_GET_TIME
+  std::vector<float>    Sign;         // -1 for Invert
+  std::vector<float>    ThreshHigh;
+  std::vector<float>    ThreshLow;
+  std::vector<int>      High;
+  std::vector<int>      Pending;
+  std::vector<int>      PendingAt;
+  std::vector<int>      Dwell;
+  std::vector<int>      Debounce;
+  std::vector<int>      ReSync;
+  std::vector<float>    Max;          // STATE_GET_THRESH
+  std::vector<double>   Sum;
+};
+
+#endif /* _U775_DCF77MULTI_H_ */
@@ -0,0 +1,537 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77net.h"
+#include "dcf77bytes.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <string>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#endif
+
+#define NET_HEADER_SIZE   16
+#define NET_MAX_DATAGRAM  256
+
+
+static unsigned bitCount( unsigned long long v )
+{
+  unsigned n = 0;
+  for ( ; v; v &= v - 1 )
+    ++n;
+  return n;
+}
+
+
+#ifdef _MSC_VER
+
+// no sockets on this platform: open() fails, nothing else is reached
+static int openSocket( const char * addr, bool passive, FILE * errstream )
+{
+  (void)passive;
+  if ( errstream )
+    fprintf(errstream, "Error: network not available on this platform: '%s'\n", addr);
+  return -1;
+}
+
+#else
+
+// "<host>:<port>"; host may be missing for passive sockets. IPv6 in []
+static bool resolve( const char * addr, bool passive, struct addrinfo ** res, FILE * errstream )
+{
+  struct addrinfo hints;
+  std::string host, port;
+  const char * colon = strrchr( addr, ':' );
+
+  if ( colon )
+  {
+    host.assign( addr, colon - addr );
+    port = colon + 1;
+  }
+  else
+    port = addr;
+  if ( host.size() >= 2 && '[' == host[0] && ']' == host[host.size() - 1] )
+    host = host.substr( 1, host.size() - 2 );
+  if ( ( host.empty() && !passive ) || port.empty() )
+  {
+    fprintf(errstream, "Error: missing host or port in '%s'\n", addr);
+    return false;
+  }
+
+  memset( &hints, 0, sizeof(hints) );
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  const int r = getaddrinfo( host.empty() ? NULL : host.c_str(), port.c_str(), &hints, res );
+  if ( r )
+  {
+    fprintf(errstream, "Error: could not resolve '%s': %s\n", addr, gai_strerror(r));
+    return false;
+  }
+  return true;
+}
+
+
+// socket connected to / bound on first usable address. -1 on error
+static int openSocket( const char * addr, bool passive, FILE * errstream )
+{
+  struct addrinfo * res, * ai;
+  int fd = -1;
+
+  if ( !resolve( addr, passive, &res, errstream ) )
+    return -1;
+  for ( ai = res; ai && fd < 0; ai = ai->ai_next )
+  {
+    fd = socket( ai->ai_family, ai->ai_socktype, ai->ai_protocol );
+    if ( fd < 0 )
+      continue;
+    if ( passive )
+    {
+      // bursts of several hosts, e.g. replays
+      const int rcvbuf = 1 << 20;
+      setsockopt( fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf) );
+    }
+    if ( ( passive ? bind( fd, ai->ai_addr, ai->ai_addrlen ) : connect( fd, ai->ai_addr, ai->ai_addrlen ) )
+      || fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK ) )
+    {
+      ::close( fd );
+      fd = -1;
+    }
+  }
+  if ( fd < 0 )
+    fprintf(errstream, "Error: could not %s '%s': %s\n", passive ? "listen on" : "send to", addr, strerror(errno));
+  freeaddrinfo( res );
+  return fd;
+}
+
+#endif
+
+
+DCF77NetSender::DCF77NetSender()
+{
+  fd = -1;
+  HostId = 0;
+  Seq = 0;
+  Sent = 0;
+  Failed = 0;
+}
+
+
+DCF77NetSender::~DCF77NetSender()
+{
+  close();
+}
+
+
+bool DCF77NetSender::open( const char * dest, unsigned hostId, FILE * errstream )
+{
+  close();
+  fd = openSocket( dest, false, errstream );
+  HostId = hostId;
+  return fd >= 0;
+}
+
+
+void DCF77NetSender::close()
+{
+#ifndef _MSC_VER
+  if ( fd >= 0 )
+    ::close( fd );
+#endif
+  fd = -1;
+}
+
+
+void DCF77NetSender::send( unsigned type, const unsigned char * payload, unsigned len )
+{
+  unsigned char d[NET_MAX_DATAGRAM];
+
+  if ( fd < 0 )
+    return;
+  memcpy( d, "U7N1", 4 );
+  put32( d + 4, type );
+  put32( d + 8, HostId );
+  put32( d + 12, Seq++ );
+  memcpy( d + NET_HEADER_SIZE, payload, len );
+#ifndef _MSC_VER
+  // no aggregator (ECONNREFUSED) or full buffer: lost, as on the network
+  if ( ::send( fd, d, NET_HEADER_SIZE + len, 0 ) < 0 )
+    ++Failed;
+  else
+    ++Sent;
+#endif
+}
+
+
+void DCF77NetSender::minute( const DCF77MinuteRecord & rec )
+{
+  unsigned char p[DCF77MinuteRecord::Size];
+  rec.encode( p );
+  send( DCF77NetAggregator::EV_MINUTE, p, sizeof(p) );
+}
+
+
+void DCF77NetSender::second( long long edgeTimeNs, int secInMinute )
+{
+  unsigned char p[12];
+  put64( p, edgeTimeNs );
+  put32( p + 8, (unsigned)secInMinute );
+  send( DCF77NetAggregator::EV_SECOND, p, sizeof(p) );
+}
+
+
+void DCF77NetSender::quality( const DCF77NetQuality & q )
+{
+  unsigned char p[28];
+  put32( p, (unsigned)q.State );
+  put32( p + 4, q.Signal ? 1 : 0 );
+  putFloat( p + 8, q.RatePpm );
+  putFloat( p + 12, q.Threshold );
+  putFloat( p + 16, q.HoldSigmaMs );
+  put32( p + 20, q.ValidMinutes );
+  put32( p + 24, q.FailedMinutes );
+  send( DCF77NetAggregator::EV_QUALITY, p, sizeof(p) );
+}
+
+
+DCF77NetAggregator::DCF77NetAggregator()
+{
+  LingerNs = 45000000000LL;
+  HostTimeoutNs = 120000000000LL;
+  BadDatagrams = 0;
+  LateReports = 0;
+  sock = -1;
+  VotedMinute = -1;
+}
+
+
+DCF77NetAggregator::~DCF77NetAggregator()
+{
+  close();
+}
+
+
+bool DCF77NetAggregator::open( const char * listen, FILE * errstream )
+{
+  close();
+  sock = openSocket( listen, true, errstream );
+  return sock >= 0;
+}
+
+
+void DCF77NetAggregator::close()
+{
+#ifndef _MSC_VER
+  if ( sock >= 0 )
+    ::close( sock );
+#endif
+  sock = -1;
+}
+
+
+DCF77NetAggregator::Host & DCF77NetAggregator::host( unsigned id, long long nowNs )
+{
+  size_t i;
+  for ( i = 0; i < Hosts.size(); ++i )
+    if ( Hosts[i].Id == id )
+      return Hosts[i];
+
+  Host h;
+  memset( &h, 0, sizeof(h) );
+  h.Id = id;
+  h.LastSeenNs = nowNs;
+  h.ClockNs = -1;
+  h.Agreement = 1.0F;
+  Hosts.push_back( h );
+  return Hosts.back();
+}
+
+
+unsigned DCF77NetAggregator::receive( long long nowNs )
+{
+  unsigned char d[NET_MAX_DATAGRAM];
+  unsigned count = 0;
+
+  if ( sock < 0 )
+    return 0;
+  for (;;)
+  {
+#ifdef _MSC_VER
+    const int len = -1;
+#else
+    const int len = (int)recv( sock, d, sizeof(d), 0 );
+#endif
+    if ( len < 0 && EINTR == errno )
+      continue;
+    if ( len < 0 )
+      break;
+    if ( len < NET_HEADER_SIZE || memcmp( d, "U7N1", 4 ) )
+    {
+      ++BadDatagrams;
+      continue;
+    }
+    ++count;
+
+    const unsigned type = get32( d + 4 );
+    const unsigned seq = get32( d + 12 );
+    const unsigned char * p = d + NET_HEADER_SIZE;
+    const int plen = len - NET_HEADER_SIZE;
+    Host & h = host( get32( d + 8 ), nowNs );
+
+    // gaps of sequence: lost. far jumps: restart of sender
+    if ( h.Received && seq != h.NextSeq && seq - h.NextSeq < 0x10000 )
+      h.Lost += seq - h.NextSeq;
+    h.NextSeq = seq + 1;
+    ++h.Received;
+    h.LastSeenNs = nowNs;
+
+    if ( EV_MINUTE == type && plen >= DCF77MinuteRecord::Size )
+    {
+      DCF77MinuteRecord rec;
+      rec.decode( p );
+      rec.DeviceId = h.Id;
+      ++h.Minutes;
+      if ( !rec.ErrorCode )
+        ++h.MinutesOk;
+      const long long minute = ( rec.EdgeTimeNs + 30000000000LL ) / 60000000000LL;
+      if ( rec.EdgeTimeNs > h.ClockNs )
+        h.ClockNs = rec.EdgeTimeNs;
+      if ( minute <= VotedMinute )
+      {
+        ++LateReports;
+        continue;
+      }
+      // all of them: a disturbed receiver may see several minute marks
+      Pending & pm = Minutes[minute];
+      if ( pm.Reports.empty() )
+        pm.FirstNs = nowNs;
+      pm.Reports.push_back( rec );
+    }
+    else if ( EV_SECOND == type && plen >= 12 )
+    {
+      const long long edge = get64( p );
+      if ( edge > h.ClockNs )
+        h.ClockNs = edge;
+      float phase = (float)( ( ( edge % 1000000000LL ) + 1000000000LL ) % 1000000000LL ) * 1E-6F;
+      if ( phase >= 500.0F )
+        phase -= 1000.0F;
+      h.PhaseMs = h.Seconds ? h.PhaseMs + 0.1F * ( phase - h.PhaseMs ) : phase;
+      ++h.Seconds;
+    }
+    else if ( EV_QUALITY == type && plen >= 28 )
+    {
+      h.HasQuality = true;
+      h.Quality.State = (int)get32( p );
+      h.Quality.Signal = ( 0 != get32( p + 4 ) );
+      h.Quality.RatePpm = getFloat( p + 8 );
+      h.Quality.Threshold = getFloat( p + 12 );
+      h.Quality.HoldSigmaMs = getFloat( p + 16 );
+      h.Quality.ValidMinutes = get32( p + 20 );
+      h.Quality.FailedMinutes = get32( p + 24 );
+    }
+    else
+      ++BadDatagrams;
+  }
+  return count;
+}
+
+
+void DCF77NetAggregator::vote( const Pending & p, DCF77NetVote * v )
+{
+  const long long tolNs = 500000000LL;
+  double w[2][59];
+  std::vector<long long> edges;
+  std::vector<const DCF77MinuteRecord *> sel;
+  size_t i, j;
+  int b;
+
+  memset( w, 0, sizeof(w) );
+  memset( v, 0, sizeof(*v) );
+
+  // minute edge of most reports; decoded ones first on a tie
+  size_t best = 0;
+  unsigned bestScore = 0;
+  for ( i = 0; i < p.Reports.size(); ++i )
+  {
+    unsigned score = p.Reports[i].ErrorCode ? 0 : 1;
+    for ( j = 0; j < p.Reports.size(); ++j )
+      if ( llabs( p.Reports[j].EdgeTimeNs - p.Reports[i].EdgeTimeNs ) <= tolNs )
+        score += 2;
+    if ( score > bestScore )
+    {
+      best = i;
+      bestScore = score;
+    }
+  }
+  // per host the report closest to it. others are frames of false minute marks
+  const long long edge0 = p.Reports[best].EdgeTimeNs;
+  for ( i = 0; i < p.Reports.size(); ++i )
+  {
+    const DCF77MinuteRecord & r = p.Reports[i];
+    const long long d = llabs( r.EdgeTimeNs - edge0 );
+    for ( j = 0; j < sel.size() && sel[j]->DeviceId != r.DeviceId; ++j )
+      ;
+    if ( d > tolNs )
+      ++v->Misaligned;
+    else if ( j == sel.size() )
+      sel.push_back( &r );
+    else
+    {
+      ++v->Misaligned;
+      if ( d < llabs( sel[j]->EdgeTimeNs - edge0 ) )
+        sel[j] = &r;
+    }
+  }
+
+  for ( i = 0; i < sel.size(); ++i )
+  {
+    const DCF77MinuteRecord & r = *sel[i];
+    const double weight = host( r.DeviceId, 0 ).Agreement + ( r.ErrorCode ? 0.0 : 2.0 );
+    for ( b = 0; b < 59; ++b )
+      if ( ( r.ValidMask >> b ) & 1 )
+        w[ ( r.ValueMask >> b ) & 1 ][b] += weight;
+    edges.push_back( r.EdgeTimeNs );
+    ++v->Reports;
+    if ( !r.ErrorCode )
+      ++v->ReportsOk;
+  }
+  std::nth_element( edges.begin(), edges.begin() + edges.size() / 2, edges.end() );
+  v->EdgeTimeNs = edges[ edges.size() / 2 ];
+
+  // ties stay invalid
+  for ( b = 0; b < 59; ++b )
+  {
+    if ( w[0][b] > 0.0 && w[1][b] > 0.0 )
+      ++v->Disputed;
+    if ( w[0][b] != w[1][b] )
+    {
+      v->ValidMask |= 1ULL << b;
+      if ( w[1][b] > w[0][b] )
+        v->ValueMask |= 1ULL << b;
+    }
+  }
+
+  struct tm tms;
+  int tzIdx = 0;
+  Eval.EvalValueMaskLo = (int)( v->ValueMask & 0x1FFFFFFF );
+  Eval.EvalValidMaskLo = (int)( v->ValidMask & 0x1FFFFFFF );
+  Eval.EvalValueMaskHi = (int)( ( v->ValueMask >> 29 ) & 0x3FFFFFFF );
+  Eval.EvalValidMaskHi = (int)( ( v->ValidMask >> 29 ) & 0x3FFFFFFF );
+  memset( &tms, 0, sizeof(tms) );
+  const bool ok = Eval.evalMinPulse( &tms, &tzIdx, NULL );
+  v->UtcMinute = ok ? dcf77ToUtc( &tms, tzIdx ) : -1;
+  v->ErrorCode = Eval.EvalError;
+  if ( !ok )
+    return;
+
+  // agreement of each report with a valid vote: weight of its next votes
+  for ( i = 0; i < sel.size(); ++i )
+  {
+    const DCF77MinuteRecord & r = *sel[i];
+    const unsigned long long common = r.ValidMask & v->ValidMask;
+    const unsigned n = bitCount( common );
+    if ( r.ErrorCode )
+      ++v->Recovered;
+    if ( n )
+    {
+      Host & h = host( r.DeviceId, 0 );
+      const float agree = (float)bitCount( ~( r.ValueMask ^ v->ValueMask ) & common ) / n;
+      h.Agreement += 0.2F * ( agree - h.Agreement );
+    }
+  }
+}
+
+
+unsigned DCF77NetAggregator::flush( long long nowNs, bool all, VoteCallback cb, void * ctx )
+{
+  unsigned count = 0;
+
+  while ( !Minutes.empty() )
+  {
+    std::map<long long, Pending>::iterator it = Minutes.begin();
+    // no more reports, when host clocks passed the range of the minute
+    const long long endNs = it->first * 60000000000LL + 30000000000LL;
+    bool complete = all || nowNs - it->second.FirstNs >= LingerNs;
+    size_t i;
+    for ( i = 0; !complete && i < Hosts.size(); ++i )
+    {
+      const Host & h = Hosts[i];
+      if ( nowNs - h.LastSeenNs <= HostTimeoutNs && h.ClockNs < endNs )
+        break;
+    }
+    if ( !complete && i < Hosts.size() )
+      break;    // keep order of votes
+
+    DCF77NetVote v;
+    vote( it->second, &v );
+    VotedMinute = it->first;
+    Minutes.erase( it );
+    ++count;
+    if ( cb )
+      cb( v, ctx );
+  }
+  return count;
+}
+
+
+void DCF77NetAggregator::health( FILE * fp, long long nowNs ) const
+{
+  unsigned active = 0, receiving = 0;
+  size_t i;
+
+  for ( i = 0; i < Hosts.size(); ++i )
+  {
+    const Host & h = Hosts[i];
+    if ( nowNs - h.LastSeenNs <= HostTimeoutNs )
+    {
+      ++active;
+      if ( h.HasQuality && h.Quality.Signal )
+        ++receiving;
+    }
+  }
+  fprintf(fp, "{\"type\":\"health\",\"time\":%.3f,\"hosts\":%u,\"active\":%u,\"receiving\":%u"
+              ",\"pending\":%u,\"late\":%u,\"bad\":%u,\"host\":["
+         , 1E-9 * nowNs, (unsigned)Hosts.size(), active, receiving
+         , (unsigned)Minutes.size(), LateReports, BadDatagrams );
+  for ( i = 0; i < Hosts.size(); ++i )
+  {
+    const Host & h = Hosts[i];
+    fprintf(fp, "%s{\"id\":%u,\"age\":%.1f,\"received\":%u,\"lost\":%u,\"minutes\":%u,\"ok\":%u"
+                ",\"agree\":%.3f,\"phase_ms\":%.2f"
+           , i ? "," : "", h.Id, 1E-9 * ( nowNs - h.LastSeenNs ), h.Received, h.Lost
+           , h.Minutes, h.MinutesOk, h.Agreement, h.PhaseMs );
+    if ( h.HasQuality )
+      fprintf(fp, ",\"state\":\"%s\",\"signal\":%s,\"ppm\":%.2f,\"threshold\":%.3f,\"sigma_ms\":%.2f"
+             , DCF77::STATE_GET_TIME == h.Quality.State ? "time" : "threshold"
+             , h.Quality.Signal ? "true" : "false", h.Quality.RatePpm
+             , h.Quality.Threshold, h.Quality.HoldSigmaMs );
+    fprintf(fp, "}");
+  }
+  fprintf(fp, "]}\n");
+}
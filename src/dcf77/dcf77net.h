@@ -0,0 +1,172 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _U775_DCF77NET_H_
+#define _U775_DCF77NET_H_
+
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+#include "dcf77.h"
+#include "dcf77log.h"
+
+// Aggregation of several receiver hosts over UDP.
+//
+// Each host sends its events to the aggregator (dcf77-aggregate):
+//   datagram: "U7N1", type, 3 reserved, host id, sequence; then payload.
+//   all values little endian
+//   EV_MINUTE   DCF77MinuteRecord of every evaluated minute, valid or not
+//   EV_SECOND   host clock (UTC) of a second mark and its second in minute
+//   EV_QUALITY  periodic state of the receiver, see DCF77NetQuality
+// Sending never blocks; lost datagrams are counted by the aggregator from
+// the sequence numbers.
+//
+// The aggregator groups the minutes by their edge on the host clocks
+// (hosts are expected within a few seconds of each other), takes the
+// edge most reports agree on within 0.5 s and votes every bit over the
+// reports at that edge having it valid. Weight of a report: 2 if the host
+// decoded the minute on its own (parity checked), plus the agreement of
+// the host with earlier votes.
+// So a locally disturbed receiver still contributes its good bits, and
+// the voted telegram is evaluated like one of a single receiver.
+
+struct DCF77NetQuality
+{
+  int       State;          // DCF77::State
+  bool      Signal;         // pulses within the last 2 s
+  float     RatePpm;        // measured deviation of sample clock, 0 if unknown
+  float     Threshold;
+  float     HoldSigmaMs;    // uncertainty of holdover model, < 0 if none
+  unsigned  ValidMinutes;   // since start of receiver
+  unsigned  FailedMinutes;
+};
+
+
+struct DCF77NetVote
+{
+  long long EdgeTimeNs;     // median minute edge of the reports
+  long long UtcMinute;      // of voted telegram, -1 if invalid
+  int       ErrorCode;      // DCF77::EvalErrorCode of voted telegram
+  unsigned long long ValueMask;   // voted DCF bits 58 .. 0
+  unsigned long long ValidMask;
+  unsigned  Reports;        // hosts reporting the minute
+  unsigned  Misaligned;     // reports off the common minute edge, not voting
+  unsigned  ReportsOk;      // of them decoded on their own
+  unsigned  Recovered;      // failed locally, but valid vote
+  unsigned  Disputed;       // bits with valid dissenting reports
+};
+
+
+class DCF77NetSender
+{
+public:
+  DCF77NetSender();
+  ~DCF77NetSender();
+
+  // dest: "<host>:<port>"
+  bool open( const char * dest, unsigned hostId, FILE * errstream );
+  void close();
+  bool isOpen() const { return fd >= 0; }
+
+  void minute( const DCF77MinuteRecord & rec );
+  void second( long long edgeTimeNs, int secInMinute );
+  void quality( const DCF77NetQuality & q );
+
+  unsigned  Sent;
+  unsigned  Failed;         // send errors, e.g. full socket buffer
+
+private:
+  void send( unsigned type, const unsigned char * payload, unsigned len );
+
+  int       fd;
+  unsigned  HostId;
+  unsigned  Seq;
+};
+
+
+class DCF77NetAggregator
+{
+public:
+  DCF77NetAggregator();
+  ~DCF77NetAggregator();
+
+  enum { EV_MINUTE = 1, EV_SECOND, EV_QUALITY };
+
+  // listen: "[<host>:]<port>"
+  bool open( const char * listen, FILE * errstream );
+  void close();
+  // readable, when datagrams are waiting
+  int fd() const { return sock; }
+
+  // read all waiting datagrams, arrived at nowNs (host clock). returns count
+  unsigned receive( long long nowNs );
+
+  // vote minutes, when the clocks of all active hosts passed their range
+  // (edge + 30 s) or after waiting LingerNs; all pending minutes if all
+  typedef void (*VoteCallback)( const DCF77NetVote & v, void * ctx );
+  unsigned flush( long long nowNs, bool all, VoteCallback cb, void * ctx );
+
+  // fleet health as one JSON line
+  void health( FILE * fp, long long nowNs ) const;
+
+  long long LingerNs;       // default 45 s
+  long long HostTimeoutNs;  // host inactive without datagrams. default 120 s
+  unsigned  BadDatagrams;
+  unsigned  LateReports;    // minutes arriving after their vote
+
+  struct Host
+  {
+    unsigned  Id;
+    long long LastSeenNs;
+    long long ClockNs;          // host clock of latest minute or second mark
+    unsigned  NextSeq;
+    unsigned  Received;
+    unsigned  Lost;
+    unsigned  Minutes;
+    unsigned  MinutesOk;
+    unsigned  Seconds;
+    float     Agreement;        // with votes: 0 .. 1
+    float     PhaseMs;          // mean second mark on host clock, +/- 500
+    bool      HasQuality;
+    DCF77NetQuality Quality;
+  };
+  std::vector<Host> Hosts;
+
+private:
+  struct Pending
+  {
+    long long FirstNs;          // arrival of first report
+    std::vector<DCF77MinuteRecord> Reports;
+  };
+
+  Host & host( unsigned id, long long nowNs );
+  void vote( const Pending & p, DCF77NetVote * v );
+
+  int       sock;
+  long long VotedMinute;    // latest voted minute
+  std::map<long long, Pending> Minutes;   // by minute of edge
+  DCF77     Eval;           // evaluation of voted telegrams
+};
+
+#endif /* _U775_DCF77NET_H_ */
@@ -0,0 +1,180 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600   /* posix_openpt() */
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE     /* cfmakeraw() */
+#endif
+
+#include "dcf77nmea.h"
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+
+DCF77NmeaPty::DCF77NmeaPty()
+{
+  Master = Slave = -1;
+  SlaveName[0] = 0;
+  LinkName[0] = 0;
+  Written = Dropped = 0;
+}
+
+
+DCF77NmeaPty::~DCF77NmeaPty()
+{
+  close();
+}
+
+
+bool DCF77NmeaPty::open( const char * linkName, FILE * errstream )
+{
+  close();
+#ifdef _MSC_VER
+  (void)linkName;
+  if ( errstream )
+    fprintf(errstream, "Error: NMEA pty not available on this platform\n");
+  return false;
+#else
+  const char * name;
+  struct termios tio;
+  struct stat st;
+
+  Master = posix_openpt( O_RDWR | O_NOCTTY );
+  if ( Master < 0 || grantpt( Master ) || unlockpt( Master ) || !( name = ptsname( Master ) ) )
+    goto error;
+  strncpy( SlaveName, name, sizeof(SlaveName) - 1 );
+  SlaveName[sizeof(SlaveName) - 1] = 0;
+  Slave = ::open( SlaveName, O_RDWR | O_NOCTTY );
+  if ( Slave < 0 )
+    goto error;
+  // raw 4800 baud line of a GPS: no echo, no CR / NL translation
+  if ( 0 == tcgetattr( Slave, &tio ) )
+  {
+    cfmakeraw( &tio );
+    cfsetispeed( &tio, B4800 );
+    cfsetospeed( &tio, B4800 );
+    tcsetattr( Slave, TCSANOW, &tio );
+  }
+  if ( fcntl( Master, F_SETFL, fcntl( Master, F_GETFL ) | O_NONBLOCK ) )
+    goto error;
+
+  if ( linkName && *linkName )
+  {
+    if ( 0 == lstat( linkName, &st ) )
+    {
+      if ( !S_ISLNK( st.st_mode ) )
+      {
+        if ( errstream )
+          fprintf(errstream, "Error: '%s' exists and is no symlink\n", linkName);
+        close();
+        return false;
+      }
+      unlink( linkName );
+    }
+    if ( symlink( SlaveName, linkName ) )
+      goto error;
+    strncpy( LinkName, linkName, sizeof(LinkName) - 1 );
+    LinkName[sizeof(LinkName) - 1] = 0;
+  }
+  return true;
+
+error:
+  if ( errstream )
+    fprintf(errstream, "Error: NMEA pty: %s\n", strerror(errno));
+  close();
+  return false;
+#endif
+}
+
+
+void DCF77NmeaPty::close()
+{
+#ifndef _MSC_VER
+  if ( LinkName[0] )
+    unlink( LinkName );
+  if ( Slave >= 0 )
+    ::close( Slave );
+  if ( Master >= 0 )
+    ::close( Master );
+#endif
+  Master = Slave = -1;
+  SlaveName[0] = 0;
+  LinkName[0] = 0;
+}
+
+
+void DCF77NmeaPty::sentence( char * buf, size_t len, const char * body )
+{
+  unsigned char cs = 0;
+  const char * p;
+  for ( p = body; *p; ++p )
+    cs ^= (unsigned char)*p;
+  snprintf( buf, len, "$%s*%02X\r\n", body, cs );
+}
+
+
+void DCF77NmeaPty::second( long long utc, bool valid )
+{
+  if ( Master < 0 )
+    return;
+#ifndef _MSC_VER
+  const time_t tt = (time_t)utc;
+  struct tm t;
+  char hms[16], body[96], out[256];
+  size_t n;
+
+  gmtime_r( &tt, &t );
+  snprintf( hms, sizeof(hms), "%02d%02d%02d.00", t.tm_hour, t.tm_min, t.tm_sec );
+  // time, status, no position / speed / course, date, no variation, mode
+  snprintf( body, sizeof(body), "GPRMC,%s,%c,,,,,,,%02d%02d%02d,,,%c"
+          , hms, valid ? 'A' : 'V', t.tm_mday, t.tm_mon + 1, t.tm_year % 100, valid ? 'A' : 'N' );
+  sentence( out, sizeof(out), body );
+  n = strlen( out );
+  snprintf( body, sizeof(body), "GPZDA,%s,%02d,%02d,%04d,00,00"
+          , hms, t.tm_mday, t.tm_mon + 1, t.tm_year + 1900 );
+  sentence( out + n, sizeof(out) - n, body );
+  n = strlen( out );
+
+  // sentences of the last second, that nobody read, are stale now
+  tcflush( Slave, TCIFLUSH );
+  if ( write( Master, out, n ) == (ssize_t)n )
+    ++Written;
+  else
+    ++Dropped;
+#else
+  (void)utc;
+  (void)valid;
+#endif
+}
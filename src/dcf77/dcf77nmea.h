@@ -0,0 +1,66 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77NMEA_H_
+#define _U775_DCF77NMEA_H_
+
+#include <stdio.h>
+
+// NMEA 0183 time output on a pseudo-terminal, for gpsd, chrony and other
+// consumers of a GPS receiver: $GPRMC and $GPZDA of each second, written
+// right after its second mark. No position; RMC status 'V' when the time
+// is not from a recent valid minute.
+//
+// The pty is created by open(); a symlink with a fixed name points to its
+// slave device. Writes never block: sentences of the last second not read
+// by then are dropped as stale. POSIX only.
+
+class DCF77NmeaPty
+{
+public:
+  DCF77NmeaPty();
+  ~DCF77NmeaPty();
+
+  // linkName: symlink to the slave device, NULL for none. an existing
+  // symlink of that name is replaced, other files are not
+  bool open( const char * linkName, FILE * errstream );
+  void close();
+  bool isOpen() const { return Master >= 0; }
+  const char * slaveName() const { return SlaveName; }
+
+  // sentences for the second starting at utc (unix time)
+  void second( long long utc, bool valid );
+
+  // "$<body>*<checksum>\r\n" into buf
+  static void sentence( char * buf, size_t len, const char * body );
+
+  unsigned        Written;      // seconds
+  unsigned        Dropped;      // seconds not written, reader too slow
+
+private:
+  int             Master;
+  int             Slave;        // kept open: settings and buffer survive readers
+  char            SlaveName[64];
+  char            LinkName[256];
+};
+
+#endif /* _U775_DCF77NMEA_H_ */
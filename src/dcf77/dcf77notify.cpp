@@ -0,0 +1,152 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77notify.h"
+
+#include <string.h>
+#include <errno.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#endif
+
+
+DCF77Notify::DCF77Notify()
+{
+  rfd = wfd = -1;
+  hEvent = 0;
+}
+
+
+DCF77Notify::~DCF77Notify()
+{
+  close();
+}
+
+
+bool DCF77Notify::open( FILE * errstream )
+{
+  close();
+#ifdef _MSC_VER
+  hEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+  if ( !hEvent )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: CreateEvent() failed: %lu\n", GetLastError());
+    return false;
+  }
+#elif defined(__linux__)
+  rfd = wfd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+  if ( rfd < 0 )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: eventfd(): %s\n", strerror(errno));
+    return false;
+  }
+#else
+  int p[2];
+  if ( pipe( p ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: pipe(): %s\n", strerror(errno));
+    return false;
+  }
+  fcntl( p[0], F_SETFL, fcntl( p[0], F_GETFL ) | O_NONBLOCK );
+  fcntl( p[1], F_SETFL, fcntl( p[1], F_GETFL ) | O_NONBLOCK );
+  rfd = p[0];
+  wfd = p[1];
+#endif
+  return true;
+}
+
+
+void DCF77Notify::close()
+{
+#ifdef _MSC_VER
+  if ( hEvent )
+    CloseHandle( (HANDLE)hEvent );
+  hEvent = 0;
+#else
+  if ( wfd >= 0 && wfd != rfd )
+    ::close( wfd );
+  if ( rfd >= 0 )
+    ::close( rfd );
+  rfd = wfd = -1;
+#endif
+}
+
+
+void DCF77Notify::signal()
+{
+#ifdef _MSC_VER
+  if ( hEvent )
+    SetEvent( (HANDLE)hEvent );
+#elif defined(__linux__)
+  const unsigned long long one = 1;
+  // EAGAIN: counter full, waiter gets woken anyway
+  const ssize_t r = ( wfd >= 0 ) ? write( wfd, &one, sizeof(one) ) : 0;
+  (void)r;
+#else
+  const char c = 1;
+  // EAGAIN: pipe full, waiter gets woken anyway
+  const ssize_t r = ( wfd >= 0 ) ? write( wfd, &c, 1 ) : 0;
+  (void)r;
+#endif
+}
+
+
+void DCF77Notify::consume()
+{
+#ifndef _MSC_VER
+  unsigned char buf[64];
+  while ( rfd >= 0 && read( rfd, buf, sizeof(buf) ) > 0 )
+    ;
+#endif
+}
+
+
+bool DCF77Notify::wait( int timeoutMs )
+{
+#ifdef _MSC_VER
+  if ( !hEvent )
+    return false;
+  return WAIT_OBJECT_0 == WaitForSingleObject( (HANDLE)hEvent, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs );
+#else
+  struct pollfd pfd;
+  pfd.fd = rfd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if ( rfd < 0 || poll( &pfd, 1, timeoutMs ) <= 0 )
+    return false;   // timeout or EINTR
+  consume();
+  return true;
+#endif
+}
+
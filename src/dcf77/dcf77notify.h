@@ -0,0 +1,62 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77NOTIFY_H_
+#define _U775_DCF77NOTIFY_H_
+
+#include <stdio.h>
+
+// Wakeup of the main thread from the capture thread or a signal handler.
+//
+// Linux: eventfd; other POSIX: non-blocking pipe; MS Windows: auto-reset
+// event. signal() is async-signal-safe and never blocks, several signals
+// before a wait() collapse into one wakeup.
+
+class DCF77Notify
+{
+public:
+  DCF77Notify();
+  ~DCF77Notify();
+
+  bool open( FILE * errstream );
+  void close();
+
+  // wake the waiting thread
+  void signal();
+
+  // sleep until signal() or timeoutMs passed (< 0: no timeout).
+  // true if signalled; the signal is consumed
+  bool wait( int timeoutMs );
+
+  // POSIX: readable after signal(), to poll() it together with other
+  // descriptors; call consume() when readable. -1 on MS Windows
+  int fd() const { return rfd; }
+  void consume();
+
+private:
+  int     rfd;
+  int     wfd;
+  void *  hEvent;   // HANDLE
+};
+
+#endif /* _U775_DCF77NOTIFY_H_ */
+
@@ -0,0 +1,133 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77ntpshm.h"
+
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <atomic>
+
+#ifndef _MSC_VER
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+
+// layout of ntpd refclock_shm.c
+struct shmTime
+{
+  int           mode;           // 1: count protocol
+  volatile int  count;
+  time_t        clockTimeStampSec;
+  int           clockTimeStampUSec;
+  time_t        receiveTimeStampSec;
+  int           receiveTimeStampUSec;
+  int           leap;
+  int           precision;
+  int           nsamples;
+  volatile int  valid;
+  unsigned      clockTimeStampNSec;
+  unsigned      receiveTimeStampNSec;
+  int           dummy[8];
+};
+
+
+DCF77NtpShm::DCF77NtpShm()
+{
+  Precision = -10;
+  Samples = 0;
+  Shm = 0;
+}
+
+
+DCF77NtpShm::~DCF77NtpShm()
+{
+  close();
+}
+
+
+bool DCF77NtpShm::open( int unit, FILE * errstream )
+{
+  close();
+#ifdef _MSC_VER
+  (void)unit;
+  if ( errstream )
+    fprintf(errstream, "Error: NTP SHM not available on this platform\n");
+  return false;
+#else
+  const int id = shmget( (key_t)( 0x4e545030 + unit ), sizeof(struct shmTime)
+                       , IPC_CREAT | ( unit <= 1 ? 0600 : 0666 ) );
+  void * p = ( id >= 0 ) ? shmat( id, NULL, 0 ) : (void *)-1;
+  if ( (void *)-1 == p )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: NTP SHM unit %d: %s\n", unit, strerror(errno));
+    return false;
+  }
+  Shm = p;
+  memset( Shm, 0, sizeof(struct shmTime) );
+  ( (struct shmTime *)Shm )->mode = 1;
+  return true;
+#endif
+}
+
+
+void DCF77NtpShm::close()
+{
+#ifndef _MSC_VER
+  if ( Shm )
+    shmdt( Shm );
+#endif
+  Shm = 0;
+}
+
+
+void DCF77NtpShm::pulse( long long utc, double hostRealtime )
+{
+  struct shmTime * s = (struct shmTime *)Shm;
+  if ( !s )
+    return;
+
+  const double sec = floor( hostRealtime );
+  const unsigned ns = (unsigned)( ( hostRealtime - sec ) * 1E9 );
+
+  // reader takes the sample, if count is the same before and after
+  s->valid = 0;
+  ++s->count;
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+  s->clockTimeStampSec = (time_t)utc;
+  s->clockTimeStampUSec = 0;
+  s->clockTimeStampNSec = 0;
+  s->receiveTimeStampSec = (time_t)sec;
+  s->receiveTimeStampUSec = (int)( ns / 1000 );
+  s->receiveTimeStampNSec = ns;
+  s->leap = 0;
+  s->precision = Precision;
+  s->nsamples = 3;
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+  ++s->count;
+  s->valid = 1;
+  ++Samples;
+}
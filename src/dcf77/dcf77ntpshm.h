@@ -0,0 +1,55 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77NTPSHM_H_
+#define _U775_DCF77NTPSHM_H_
+
+#include <stdio.h>
+
+// Second marks as PPS samples in the shared memory segment of the ntpd
+// SHM refclock (driver 28), which chrony reads too ("refclock SHM <unit>").
+// Each sample pairs the true UTC second with the host clock at the second
+// mark. Key 0x4e545030 + unit; units 0 and 1 are for root only (mode 0600),
+// others are world writable. POSIX only.
+
+class DCF77NtpShm
+{
+public:
+  DCF77NtpShm();
+  ~DCF77NtpShm();
+
+  int             Precision;    // log2 seconds. default -10 (~ 1 ms)
+
+  bool open( int unit, FILE * errstream );
+  void close();
+  bool isOpen() const { return 0 != Shm; }
+
+  // second mark of utc (unix time) at host realtime (seconds since epoch)
+  void pulse( long long utc, double hostRealtime );
+
+  unsigned        Samples;
+
+private:
+  void *          Shm;          // struct shmTime
+};
+
+#endif /* _U775_DCF77NTPSHM_H_ */
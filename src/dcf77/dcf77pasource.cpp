@@ -0,0 +1,371 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77pasource.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <portaudio.h>
+
+// a bit annoying having to discriminate the API version
+// why do they change the API?
+// however: thanks for providing a usable platform independent Sound Lib
+#define VER_18_1  ( ( 18 << 16 ) | 1 )
+#define VER_19    ( ( 19 << 16 ) | 0 )
+
+#ifndef PORTAUDIO_LIB_VERSION
+#ifdef _MSC_VER
+  // i've installed/compiled pa_stable_v19_20071207.tar.gz
+  // on MS Windows with MS Visual C++ 2003.NET
+  // pa_stable_v19_20071207.tar.gz contains PortAudio Version 19.0
+  #define PORTAUDIO_LIB_VERSION  VER_19
+#else
+  // Ubuntu Linux 6.06.1 LTS comes with PortAudio 18.1
+  #define PORTAUDIO_LIB_VERSION  VER_18_1
+#endif
+#endif
+
+
+static double steadyNow()
+{
+  return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+/* This routine will be called by the PortAudio engine when audio is needed.
+** It may be called at interrupt level on some machines so don't do anything
+** that could mess up the system like calling malloc() or free().
+*/
+
+#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
+
+static int recordCallback(
+    const void *inputBuffer
+  , void *outputBuffer
+  , unsigned long framesPerBuffer
+  , const PaStreamCallbackTimeInfo* timeInfo
+  , PaStreamCallbackFlags statusFlags
+  , void *userData
+  )
+{
+  DCF77PortAudioSource *src = (DCF77PortAudioSource*)userData;
+  double adcTime = 0.0;
+
+  // stream clock -> monotonic clock, by the age of the buffer
+  if ( timeInfo->inputBufferAdcTime > 0.0 )
+    adcTime = steadyNow() - ( timeInfo->currentTime - timeInfo->inputBufferAdcTime );
+  src->deliver( framesPerBuffer, inputBuffer, adcTime
+              , ( statusFlags & paInputOverflow ) ? DCF77AudioSource::FLAG_INPUT_OVERFLOW : 0 );
+  return 0; // Continue
+}
+
+#else
+
+static int recordCallback(
+    void *inputBuffer
+  , void *outputBuffer
+  , unsigned long framesPerBuffer
+  , PaTimestamp timeInfo
+  , void *userData
+  )
+{
+  DCF77PortAudioSource *src = (DCF77PortAudioSource*)userData;
+  src->deliver( framesPerBuffer, inputBuffer, timeInfo / src->SampleRate, 0 );
+  return 0; // Continue
+}
+
+#endif
+
+
+DCF77PortAudioSource::DCF77PortAudioSource()
+{
+  DeviceNo = -1;
+  DeviceName[0] = 0;
+  stream = 0;
+  Initialized = false;
+  cb = 0;
+  cbUserData = 0;
+  MonotonicAdcTime = ( PORTAUDIO_LIB_VERSION >= VER_19 );
+}
+
+
+DCF77PortAudioSource::~DCF77PortAudioSource()
+{
+  close();
+}
+
+
+void DCF77PortAudioSource::deliver( unsigned long framecount, const void * data, double adcTime, unsigned flags )
+{
+  cb( (unsigned)framecount, data, adcTime, flags, cbUserData );
+}
+
+
+static int deviceCount()
+{
+#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
+  return Pa_GetDeviceCount();
+#else
+  return Pa_CountDevices();
+#endif
+}
+
+
+static void printDevice( FILE * out, int i, double sampleRate )
+{
+  const PaDeviceInfo *device_info = Pa_GetDeviceInfo(i);
+
+  fprintf(out, "%d: %s\n", i, device_info->name);
+  fprintf(out, "  maxInputChannels = %d\n", device_info->maxInputChannels);
+#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
+  fprintf(out, "  default SampleRate = %f\n", device_info->defaultSampleRate);
+
+  if (device_info->maxInputChannels < 1)
+    return;
+
+  PaStreamParameters input_param;
+  memset (&input_param, 0, sizeof(input_param));
+
+  input_param.device = i;
+  input_param.channelCount = device_info->maxInputChannels;
+  input_param.sampleFormat = paFloat32;
+  input_param.hostApiSpecificStreamInfo = NULL;
+
+  PaError pa_error = Pa_IsFormatSupported(&input_param, NULL, sampleRate);
+  if (pa_error == paFormatIsSupported)
+    fprintf(out, "  supports SampleRate and Format\n");
+  else
+  {
+    fprintf(out, "  does NOT support SampleRate and Format\n");
+    fprintf(out, "  PortAudio error: %s\n", Pa_GetErrorText(pa_error));
+  }
+#else
+  (void)sampleRate;
+#endif
+}
+
+
+bool DCF77PortAudioSource::listDevices( FILE * out, double sampleRate, FILE * errstream )
+{
+  PaError pa_error = Pa_Initialize();
+  if (pa_error != paNoError)
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: PortAudio: %s\n", Pa_GetErrorText(pa_error));
+    return false;
+  }
+  const int n = deviceCount();
+  int i;
+  for ( i = 0; i < n; ++i )
+    printDevice( out, i, sampleRate );
+  Pa_Terminate();
+  return n >= 0;
+}
+
+
+bool DCF77PortAudioSource::inputDevices( std::vector<int> & devices, std::vector<unsigned> & chans, FILE * errstream )
+{
+  PaError pa_error = Pa_Initialize();
+  if (pa_error != paNoError)
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: PortAudio: %s\n", Pa_GetErrorText(pa_error));
+    return false;
+  }
+  const int n = deviceCount();
+  int i;
+  devices.clear();
+  chans.clear();
+  for ( i = 0; i < n; ++i )
+  {
+    const PaDeviceInfo *device_info = Pa_GetDeviceInfo(i);
+    if ( device_info && device_info->maxInputChannels > 0 )
+    {
+      devices.push_back( i );
+      chans.push_back( (unsigned)device_info->maxInputChannels );
+    }
+  }
+  Pa_Terminate();
+  return n >= 0;
+}
+
+
+bool DCF77PortAudioSource::open( const char * device, FILE * errstream )
+{
+  PaError err;
+  int DeviceCount;
+
+  close();
+  err = Pa_Initialize();
+  if ( err != paNoError )
+    goto error;
+  Initialized = true;
+
+  DeviceCount = deviceCount();
+  if ( DeviceCount < 0 )
+  {
+    err = DeviceCount;
+    goto error;
+  }
+  if ( DeviceCount == 0 )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: No PortAudio devices found\n");
+    close();
+    return false;
+  }
+
+  if ( device && *device )
+  {
+    DeviceNo = atoi( device );
+    if ( DeviceNo < 0 || DeviceNo >= DeviceCount )
+    {
+      if ( errstream )
+        fprintf(errstream, "Error: DeviceNo %d not in Range 0 .. %d\n", DeviceNo, DeviceCount-1 );
+      close();
+      return false;
+    }
+  }
+  else
+  {
+#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
+    DeviceNo = Pa_GetDefaultInputDevice(); /* default input device */;
+#else
+    DeviceNo = Pa_GetDefaultInputDeviceID();
+#endif
+  }
+  strncpy( DeviceName, Pa_GetDeviceInfo( DeviceNo )->name, sizeof(DeviceName) - 1 );
+  DeviceName[sizeof(DeviceName) - 1] = 0;
+
+  {
+    PaStream * s = NULL;
+    // PortAudio converts to any of them: take the requested one
+    const PaSampleFormat fmt = ( FMT_INT16 == Format ) ? paInt16
+                             : ( FMT_INT32 == Format ) ? paInt32 : paFloat32;
+#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
+    PaStreamParameters  inputParameters;
+    inputParameters.device = DeviceNo;
+    inputParameters.channelCount = ChanCount;
+    inputParameters.sampleFormat = fmt;
+    inputParameters.suggestedLatency = Pa_GetDeviceInfo( inputParameters.device )->defaultLowInputLatency;
+    inputParameters.hostApiSpecificStreamInfo = NULL;
+
+    err = Pa_OpenStream(
+              &s
+            , &inputParameters
+            , NULL                  /* &outputParameters, */
+            , SampleRate
+            , FramesPerBuffer
+            , paClipOff      /* we won't output out of range samples so don't bother clipping them */
+            , recordCallback
+            , this
+            );
+#else
+    err = Pa_OpenStream(
+              &s
+            , DeviceNo   // inputDevice
+            , ChanCount  // numInputChannels
+            , fmt        // inputSampleFormat
+            , NULL       // void *inputDriverInfo
+            , paNoDevice // outputDevice
+            , 0          // numOutputChannels
+            , 0          // outputSampleFormat
+            , NULL       // void *outputDriverInfo
+            , SampleRate // sampleRate
+            , FramesPerBuffer // framesPerBuffer
+            , (int)ceil(SampleRate * 0.100 / (double)FramesPerBuffer) // numberOfBuffers
+            , paNoFlag   // streamFlags
+            , recordCallback // PortAudioCallback *callback
+            , this       // void *userData
+            );
+#endif
+    if ( err != paNoError )
+      goto error;
+    stream = s;
+  }
+  return true;
+
+error:
+  if ( errstream )
+    fprintf(errstream, "Error: PortAudio: %s\n", Pa_GetErrorText(err));
+  close();
+  return false;
+}
+
+
+void DCF77PortAudioSource::close()
+{
+  if ( stream )
+  {
+    Pa_CloseStream( (PaStream *)stream );
+    stream = 0;
+  }
+  if ( Initialized )
+  {
+    Pa_Terminate();
+    Initialized = false;
+  }
+}
+
+
+bool DCF77PortAudioSource::start( Callback callback, void * userData, FILE * errstream )
+{
+  if ( !stream )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: PortAudio stream not open\n");
+    return false;
+  }
+  cb = callback;
+  cbUserData = userData;
+  PaError err = Pa_StartStream( (PaStream *)stream );
+  if ( err != paNoError )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: PortAudio: %s\n", Pa_GetErrorText(err));
+    return false;
+  }
+  return true;
+}
+
+
+void DCF77PortAudioSource::stop()
+{
+  if ( stream )
+    Pa_StopStream( (PaStream *)stream );
+}
+
+
+bool DCF77PortAudioSource::isRunning() const
+{
+  if ( !stream )
+    return false;
+#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
+  return 1 == Pa_IsStreamActive( (PaStream *)stream );
+#else
+  return 1 == Pa_StreamActive( (PaStream *)stream );
+#endif
+}
+
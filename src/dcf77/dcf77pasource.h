@@ -0,0 +1,66 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77PASOURCE_H_
+#define _U775_DCF77PASOURCE_H_
+
+#include "dcf77source.h"
+
+// PortAudio capture, for PortAudio v18.1 and v19 (see PORTAUDIO_LIB_VERSION
+// in dcf77pasource.cpp). With v19, adcTime is converted to the monotonic
+// clock; v18 only delivers the stream position (adcTime = frames / rate).
+
+class DCF77PortAudioSource : public DCF77AudioSource
+{
+public:
+  DCF77PortAudioSource();
+  virtual ~DCF77PortAudioSource();
+
+  virtual const char * name() const { return "portaudio"; }
+  // device: device number as string, NULL or "" for default input device
+  virtual bool open( const char * device, FILE * errstream );
+  virtual void close();
+  virtual bool start( Callback cb, void * userData, FILE * errstream );
+  virtual void stop();
+  virtual bool isRunning() const;
+
+  // results of open()
+  int             DeviceNo;
+  char            DeviceName[128];
+
+  // print input devices and whether they support sampleRate
+  static bool listDevices( FILE * out, double sampleRate, FILE * errstream );
+  // numbers and channel counts of devices with inputs
+  static bool inputDevices( std::vector<int> & devices, std::vector<unsigned> & chans, FILE * errstream );
+
+  // called from PortAudio callback
+  void deliver( unsigned long framecount, const void * data, double adcTime, unsigned flags );
+
+private:
+  void *          stream;       // PaStream *
+  bool            Initialized;
+  Callback        cb;
+  void *          cbUserData;
+};
+
+#endif /* _U775_DCF77PASOURCE_H_ */
+
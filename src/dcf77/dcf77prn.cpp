@@ -0,0 +1,325 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77prn.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846
+#endif
+
+
+// in place radix-2 complex FFT. n must be a power of 2
+// inverse transform is NOT scaled by 1/n
+static void fft( float * re, float * im, int n, bool inverse )
+{
+  int i, j, k, m;
+
+  // bit reversal permutation
+  for ( i = 1, j = 0; i < n; ++i )
+  {
+    int bit = n >> 1;
+    for ( ; j & bit; bit >>= 1 )
+      j ^= bit;
+    j ^= bit;
+    if ( i < j )
+    {
+      float t;
+      t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+
+  for ( m = 2; m <= n; m <<= 1 )
+  {
+    const double ang = ( inverse ? 2.0 : -2.0 ) * M_PI / m;
+    const double wr = cos(ang);
+    const double wi = sin(ang);
+    for ( k = 0; k < n; k += m )
+    {
+      double cr = 1.0, ci = 0.0;
+      for ( j = 0; j < m/2; ++j )
+      {
+        const int a = k + j;
+        const int b = a + m/2;
+        const float tr = (float)( re[b] * cr - im[b] * ci );
+        const float ti = (float)( re[b] * ci + im[b] * cr );
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+        const double t = cr * wr - ci * wi;
+        ci = cr * wi + ci * wr;
+        cr = t;
+      }
+    }
+  }
+}
+
+
+DCF77PRN::DCF77PRN()
+{
+  SampleRate = 192000.0;
+  CarrierFreq = 77500.0;
+  ChanCount = 1;
+  ChanIdx = 0;
+  MinPeakRatio = 5.0F;
+
+  TotalFrames = 0;
+  NewEpoch = false;
+  EpochValid = false;
+  EpochFrame = 0.0;
+  EpochBit = -1;
+  EpochPeakRatio = 0.0F;
+
+  HintFrame = -1;
+  SkipFrames = 0;
+
+  BinI = BinQ = 0;
+  RefRe = RefIm = 0;
+  WorkRe = WorkIm = 0;
+}
+
+
+DCF77PRN::~DCF77PRN()
+{
+  delete [] BinI;
+  delete [] BinQ;
+  delete [] RefRe;
+  delete [] RefIm;
+  delete [] WorkRe;
+  delete [] WorkIm;
+}
+
+
+void DCF77PRN::initCorrelation()
+{
+  int n, k;
+  int chips[512];
+  unsigned reg = 0x1FF;
+
+  if ( !BinI )
+  {
+    BinI = new float[BinCount];
+    BinQ = new float[BinCount];
+    RefRe = new float[BinCount];
+    RefIm = new float[BinCount];
+    WorkRe = new float[BinCount];
+    WorkIm = new float[BinCount];
+  }
+
+  // 9 bit linear feedback shift register with taps 5 and 9 (x^9 + x^5 + 1)
+  for ( k = 0; k < 512; ++k )
+  {
+    const unsigned fb = ( (reg >> 4) ^ (reg >> 8) ) & 1;
+    chips[k] = ( reg & 1 ) ? -1 : 1;
+    reg = ( (reg << 1) | fb ) & 0x1FF;
+  }
+
+  // sample reference at bin centers: PRN from 200 ms after second mark
+  const double chipDuration = 120.0 / CarrierFreq;
+  for ( n = 0; n < BinCount; ++n )
+  {
+    const double t = ( n + 0.5 ) / BinCount - 0.2;
+    k = (int)floor( t / chipDuration );
+    RefRe[n] = ( t >= 0.0 && k < 512 ) ? (float)chips[k] : 0.0F;
+    RefIm[n] = 0.0F;
+  }
+  fft( RefRe, RefIm, BinCount, false );
+
+  FramesPerWindow = (int)( 0.5 + SampleRate );
+  FrameInWindow = 0;
+  WindowStartFrame = TotalFrames;
+  CurrBin = 0;
+  memset( BinI, 0, BinCount * sizeof(float) );
+  memset( BinQ, 0, BinCount * sizeof(float) );
+  // touch work buffers here, not first in capture callback
+  memset( WorkRe, 0, BinCount * sizeof(float) );
+  memset( WorkIm, 0, BinCount * sizeof(float) );
+
+  OscCos = 1.0;
+  OscSin = 0.0;
+  OscStepCos = cos( 2.0 * M_PI * CarrierFreq / SampleRate );
+  OscStepSin = sin( 2.0 * M_PI * CarrierFreq / SampleRate );
+}
+
+
+void DCF77PRN::setSecondHint( long long secondStartFrame )
+{
+  HintFrame = secondStartFrame;
+}
+
+
+void DCF77PRN::newData( unsigned int framecount, const float * data )
+{
+  unsigned int i;
+  unsigned int idx = ChanIdx;
+
+  for ( i = 0; i < framecount; ++i, idx += ChanCount )
+  {
+    if ( SkipFrames > 0 )
+    {
+      --SkipFrames;
+      continue;
+    }
+
+    const long long hint = ( 0 == FrameInWindow ) ? HintFrame.exchange( -1 ) : -1;
+    if ( hint >= 0 )
+    {
+      // start window 50 ms before the expected second mark,
+      // so the whole PRN of a single second falls into one window
+      const long long now = TotalFrames + i;
+      const long long margin = FramesPerWindow / 20;
+      long long d = ( hint - margin - now ) % FramesPerWindow;
+      if ( d < 0 )
+        d += FramesPerWindow;
+      if ( d > 0 )
+      {
+        SkipFrames = (int)d - 1;
+        continue;
+      }
+    }
+
+    if ( 0 == FrameInWindow )
+      WindowStartFrame = TotalFrames + i;
+
+    // mix down to baseband and integrate into current bin
+    const float x = data[idx];
+    BinI[CurrBin] += (float)( x * OscCos );
+    BinQ[CurrBin] -= (float)( x * OscSin );
+    const double t = OscCos * OscStepCos - OscSin * OscStepSin;
+    OscSin = OscSin * OscStepCos + OscCos * OscStepSin;
+    OscCos = t;
+
+    ++FrameInWindow;
+    const int nextBin = (int)( (long long)FrameInWindow * BinCount / FramesPerWindow );
+    if ( nextBin != CurrBin )
+    {
+      // keep oscillator amplitude at 1
+      const double amp = 1.5 - 0.5 * ( OscCos * OscCos + OscSin * OscSin );
+      OscCos *= amp;
+      OscSin *= amp;
+      CurrBin = nextBin;
+    }
+
+    if ( FrameInWindow >= FramesPerWindow )
+    {
+      correlate();
+      FrameInWindow = 0;
+      CurrBin = 0;
+      memset( BinI, 0, BinCount * sizeof(float) );
+      memset( BinQ, 0, BinCount * sizeof(float) );
+    }
+  }
+  TotalFrames += framecount;
+}
+
+
+void DCF77PRN::correlate()
+{
+  int n;
+  double fr = 0.0, fi = 0.0;
+
+  // estimate residual carrier frequency offset from phase increments
+  for ( n = 1; n < BinCount; ++n )
+  {
+    fr += (double)BinI[n] * BinI[n-1] + (double)BinQ[n] * BinQ[n-1];
+    fi += (double)BinQ[n] * BinI[n-1] - (double)BinI[n] * BinQ[n-1];
+  }
+  const double dphi = atan2( fi, fr );
+
+  // derotate and determine mean carrier phase
+  double mr = 0.0, mi = 0.0;
+  for ( n = 0; n < BinCount; ++n )
+  {
+    const double c = cos( -dphi * n );
+    const double s = sin( -dphi * n );
+    const double zr = BinI[n] * c - BinQ[n] * s;
+    const double zi = BinI[n] * s + BinQ[n] * c;
+    WorkRe[n] = (float)zr;
+    WorkIm[n] = (float)zi;
+    mr += zr;
+    mi += zi;
+  }
+
+  // phase deviation per bin relative to mean phase
+  double mean = 0.0;
+  for ( n = 0; n < BinCount; ++n )
+  {
+    const double pr = WorkRe[n] * mr + WorkIm[n] * mi;
+    const double pi = WorkIm[n] * mr - WorkRe[n] * mi;
+    WorkRe[n] = (float)atan2( pi, pr );
+    mean += WorkRe[n];
+  }
+  mean /= BinCount;
+  for ( n = 0; n < BinCount; ++n )
+  {
+    WorkRe[n] -= (float)mean;
+    WorkIm[n] = 0.0F;
+  }
+
+  // circular cross correlation: IFFT( D * conj(R) )
+  fft( WorkRe, WorkIm, BinCount, false );
+  for ( n = 0; n < BinCount; ++n )
+  {
+    const float r = WorkRe[n] * RefRe[n] + WorkIm[n] * RefIm[n];
+    const float i = WorkIm[n] * RefRe[n] - WorkRe[n] * RefIm[n];
+    WorkRe[n] = r;
+    WorkIm[n] = i;
+  }
+  fft( WorkRe, WorkIm, BinCount, true );
+
+  int peak = 0;
+  double sumSq = 0.0;
+  for ( n = 0; n < BinCount; ++n )
+  {
+    sumSq += (double)WorkRe[n] * WorkRe[n];
+    if ( fabs(WorkRe[n]) > fabs(WorkRe[peak]) )
+      peak = n;
+  }
+
+  // rms of correlation outside the peak (+/- 4 bins ~ 2 ms)
+  for ( n = -4; n <= 4; ++n )
+  {
+    const float v = WorkRe[ (peak + n + BinCount) % BinCount ];
+    sumSq -= (double)v * v;
+  }
+  const double rms = sqrt( ( sumSq > 0.0 ? sumSq : 0.0 ) / ( BinCount - 9 ) );
+  const double peakVal = WorkRe[peak];
+
+  // parabolic interpolation of peak position
+  const double ym = fabs( WorkRe[ (peak - 1 + BinCount) % BinCount ] );
+  const double y0 = fabs( peakVal );
+  const double yp = fabs( WorkRe[ (peak + 1) % BinCount ] );
+  const double denom = ym - 2.0 * y0 + yp;
+  const double delta = ( denom != 0.0 ) ? 0.5 * ( ym - yp ) / denom : 0.0;
+
+  EpochPeakRatio = (float)( rms > 0.0 ? y0 / rms : 0.0 );
+  EpochValid = ( EpochPeakRatio >= MinPeakRatio );
+  EpochBit = ( peakVal < 0.0 ) ? 1 : 0;
+  EpochFrame = WindowStartFrame + ( peak + delta ) * FramesPerWindow / BinCount;
+  NewEpoch = true;
+}
+
@@ -0,0 +1,97 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77PRN_H_
+#define _U775_DCF77PRN_H_
+
+#include <atomic>
+
+// Correlator for the phase modulated pseudo random noise (PRN) of DCF77.
+//
+// Besides the AM second pulses the transmitter modulates the carrier phase
+// by +/- 15.6 degree with a 512 chip PRN sequence. Each chip lasts
+// 120 carrier periods (~1.548 ms), the whole sequence ~793 ms. It starts
+// 200 ms after the second mark and is inverted for DCF bit value 1.
+//
+// The input must be the raw 77.5 kHz antenna/IF signal, NOT the demodulated
+// output of a receiver module: SampleRate has to be > 155 kHz (e.g. 192000).
+// Each nominal second of input is mixed down, integrated into BinCount bins,
+// phase demodulated and then circularly correlated against the reference
+// sequence with an FFT. The correlation peak gives the start of the second
+// with a resolution of a few 10 us.
+
+class DCF77PRN
+{
+public:
+  DCF77PRN();
+  ~DCF77PRN();
+
+  // allocate buffers and prepare reference: call after setting SampleRate
+  void initCorrelation();
+  // align following windows to the (coarse) start of a second.
+  // may be called from another thread than newData()
+  void setSecondHint( long long secondStartFrame );
+  void newData( unsigned int framecount, const float * data );
+
+  enum { BinCount = 2048 };   // bins per nominal second: power of 2 for FFT
+
+  double          SampleRate;
+  double          CarrierFreq;
+  unsigned        ChanCount;
+  unsigned        ChanIdx;
+  float           MinPeakRatio;   // required peak to rms ratio of correlation
+
+  long long       TotalFrames;    // frames processed since initCorrelation()
+
+  // result: updated after each correlated second
+  volatile bool   NewEpoch;       // set on new result; reset by consumer
+  volatile bool   EpochValid;
+  volatile double EpochFrame;     // absolute frame of second start (fractional)
+  volatile int    EpochBit;       // DCF bit from sign of correlation
+  volatile float  EpochPeakRatio;
+
+private:
+  void correlate();
+
+  int             FramesPerWindow;
+  int             FrameInWindow;
+  long long       WindowStartFrame;
+  std::atomic<long long> HintFrame;   // from setSecondHint(), other thread
+  int             SkipFrames;
+
+  // local oscillator
+  double          OscCos;
+  double          OscSin;
+  double          OscStepCos;
+  double          OscStepSin;
+
+  int             CurrBin;
+  float *         BinI;
+  float *         BinQ;
+  float *         RefRe;        // FFT of reference sequence
+  float *         RefIm;
+  float *         WorkRe;
+  float *         WorkIm;
+};
+
+#endif /* _U775_DCF77PRN_H_ */
+
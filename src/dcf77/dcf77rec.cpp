@@ -0,0 +1,591 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "dcf77rec.h"
+#include "dcf77bytes.h"
+
+#include <string.h>
+#include <time.h>
+#include <chrono>
+
+#ifdef _MSC_VER
+  #define rec_fseek   _fseeki64
+  #define rec_ftell   _ftelli64
+#else
+  #define rec_fseek   fseeko
+  #define rec_ftell   ftello
+#endif
+
+#define REC_HEADER_SIZE   48
+#define REC_BUFREC_SIZE   24
+#define REC_CHUNKHDR_SIZE 24
+#define REC_FMT_I16_DELTA 1
+
+
+//////////////////////////////////////////////////////////////////////////
+
+DCF77Recorder::DCF77Recorder()
+  : Head(0)
+  , Tail(0)
+  , Running(false)
+{
+  SampleRate = 48000.0;
+  ChanCount = 1;
+  Decimation = 1;
+  MaxFramesPerBuffer = 480;
+  RingSlots = 512;    // ~5 seconds at 10 ms buffers
+  ChunkSeconds = 10.0;
+
+  DroppedBuffers = 0;
+  WrittenFrames = 0;
+
+  fp = 0;
+  Ring = 0;
+}
+
+
+DCF77Recorder::~DCF77Recorder()
+{
+  close();
+}
+
+
+bool DCF77Recorder::open( const char * filename, FILE * errstream )
+{
+  unsigned char hdr[REC_HEADER_SIZE];
+  unsigned i;
+
+  close();
+  if ( Decimation < 1 )
+    Decimation = 1;
+
+  fp = fopen( filename, "wb" );
+  if ( !fp )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not open recording file '%s'\n", filename);
+    return false;
+  }
+
+  memset( hdr, 0, sizeof(hdr) );
+  memcpy( hdr, "U775REC1", 8 );
+  put32( hdr + 8, REC_HEADER_SIZE );
+  put32( hdr + 12, ChanCount );
+  putDouble( hdr + 16, SampleRate / Decimation );
+  put32( hdr + 24, Decimation );
+  put32( hdr + 28, REC_FMT_I16_DELTA );
+  putDouble( hdr + 32, 1.0 / 32767.0 );
+  put64( hdr + 40, (long long)time(0) );
+  if ( 1 != fwrite( hdr, sizeof(hdr), 1, fp ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not write recording file '%s'\n", filename);
+    fclose( fp );
+    fp = 0;
+    return false;
+  }
+
+  Ring = new Slot[RingSlots];
+  // touch all slots: pushBuffer() must not page fault in capture callback
+  for ( i = 0; i < RingSlots; ++i )
+  {
+    Ring[i].data = new float[ MaxFramesPerBuffer * ChanCount ];
+    memset( Ring[i].data, 0, MaxFramesPerBuffer * ChanCount * sizeof(float) );
+  }
+  Head = 0;
+  Tail = 0;
+  CapturedFrames = 0;
+  LostBuffers = false;
+  DroppedBuffers = 0;
+  WrittenFrames = 0;
+
+  DecimAcc.assign( ChanCount, 0.0F );
+  DecimCount = 0;
+  StoredFrames = 0;
+  ChunkFirstFrame = 0;
+  ChunkFrames = 0;
+  FramesPerChunk = (unsigned)( ChunkSeconds * SampleRate / Decimation );
+  if ( FramesPerChunk < 1 )
+    FramesPerChunk = 1;
+  ChunkSamples.reserve( FramesPerChunk * ChanCount );
+  Index.clear();
+
+  Running = true;
+  Writer = std::thread( &DCF77Recorder::writerLoop, this );
+  return true;
+}
+
+
+void DCF77Recorder::close()
+{
+  unsigned i;
+  unsigned char buf[16];
+
+  if ( !fp )
+    return;
+
+  Running = false;
+  if ( Writer.joinable() )
+    Writer.join();
+  flushChunk();
+
+  // index and trailer
+  const long long indexOffset = rec_ftell( fp );
+  memcpy( buf, "INDX", 4 );
+  put32( buf + 4, (unsigned)Index.size() );
+  fwrite( buf, 8, 1, fp );
+  for ( i = 0; i < Index.size(); ++i )
+  {
+    unsigned char rec[24];
+    put64( rec, Index[i].offset );
+    put64( rec + 8, Index[i].frame );
+    putDouble( rec + 16, Index[i].adcTime );
+    fwrite( rec, sizeof(rec), 1, fp );
+  }
+  put64( buf, indexOffset );
+  memcpy( buf + 8, "U775END1", 8 );
+  fwrite( buf, 16, 1, fp );
+  fclose( fp );
+  fp = 0;
+
+  for ( i = 0; i < RingSlots; ++i )
+    delete [] Ring[i].data;
+  delete [] Ring;
+  Ring = 0;
+}
+
+
+void DCF77Recorder::pushBuffer( unsigned framecount, const float * data, double adcTime, unsigned flags )
+{
+  if ( !fp )
+    return;
+
+  while ( framecount > 0 )
+  {
+    const unsigned n = ( framecount > MaxFramesPerBuffer ) ? MaxFramesPerBuffer : framecount;
+    const unsigned head = Head.load( std::memory_order_relaxed );
+    const unsigned next = ( head + 1 ) % RingSlots;
+
+    if ( next == Tail.load( std::memory_order_acquire ) )
+    {
+      // ring full: never block the callback
+      ++DroppedBuffers;
+      LostBuffers = true;
+    }
+    else
+    {
+      Slot & s = Ring[head];
+      s.frame = CapturedFrames;
+      s.adcTime = adcTime;
+      s.flags = flags | ( LostBuffers ? FLAG_RING_OVERFLOW : 0 );
+      s.frames = n;
+      memcpy( s.data, data, n * ChanCount * sizeof(float) );
+      LostBuffers = false;
+      Head.store( next, std::memory_order_release );
+    }
+
+    CapturedFrames += n;
+    data += n * ChanCount;
+    adcTime += n / SampleRate;
+    framecount -= n;
+  }
+}
+
+
+void DCF77Recorder::writerLoop()
+{
+  for (;;)
+  {
+    const unsigned tail = Tail.load( std::memory_order_relaxed );
+    if ( tail == Head.load( std::memory_order_acquire ) )
+    {
+      if ( !Running )
+        break;
+      std::this_thread::sleep_for( std::chrono::milliseconds(20) );
+      continue;
+    }
+    processSlot( Ring[tail] );
+    Tail.store( ( tail + 1 ) % RingSlots, std::memory_order_release );
+  }
+}
+
+
+void DCF77Recorder::processSlot( const Slot & s )
+{
+  unsigned i, c;
+  const float * p = s.data;
+
+  if ( 0 == ChunkFrames && ChunkBufs.empty() )
+    ChunkFirstFrame = StoredFrames;
+
+  // buffers got lost before this one: don't average across the gap
+  if ( s.flags & FLAG_RING_OVERFLOW )
+  {
+    for ( c = 0; c < ChanCount; ++c )
+      DecimAcc[c] = 0.0F;
+    DecimCount = 0;
+  }
+
+  BufRec b;
+  b.frame = StoredFrames;   // next stored frame: first one of this buffer
+  b.adcTime = s.adcTime;
+  b.flags = s.flags;
+  b.frames = 0;         // counted in stored frames, as they complete
+  ChunkBufs.push_back( b );
+
+  for ( i = 0; i < s.frames; ++i, p += ChanCount )
+  {
+    for ( c = 0; c < ChanCount; ++c )
+      DecimAcc[c] += p[c];
+    if ( ++DecimCount < Decimation )
+      continue;
+
+    for ( c = 0; c < ChanCount; ++c )
+    {
+      float v = DecimAcc[c] / Decimation;
+      v = ( v > 1.0F ) ? 1.0F : ( v < -1.0F ) ? -1.0F : v;
+      ChunkSamples.push_back( (short)( v * 32767.0F + ( v >= 0.0F ? 0.5F : -0.5F ) ) );
+      DecimAcc[c] = 0.0F;
+    }
+    DecimCount = 0;
+    ++StoredFrames;
+    ++ChunkBufs.back().frames;
+    if ( ++ChunkFrames >= FramesPerChunk )
+    {
+      flushChunk();
+      if ( i + 1 < s.frames )
+      {
+        // rest of buffer continues in next chunk
+        b.frame = StoredFrames;
+        b.adcTime = s.adcTime + ( i + 1 ) / SampleRate;
+        ChunkBufs.push_back( b );
+      }
+    }
+  }
+}
+
+
+void DCF77Recorder::flushChunk()
+{
+  unsigned i, c;
+
+  if ( 0 == ChunkFrames && ChunkBufs.empty() )
+    return;
+
+  Coded.clear();
+  Coded.resize( REC_CHUNKHDR_SIZE + ChunkBufs.size() * REC_BUFREC_SIZE );
+  unsigned char * h = &Coded[0];
+  memcpy( h, "CHNK", 4 );
+  put64( h + 8, ChunkFirstFrame );
+  put32( h + 16, ChunkFrames );
+  put32( h + 20, (unsigned)ChunkBufs.size() );
+  for ( i = 0; i < ChunkBufs.size(); ++i )
+  {
+    unsigned char * r = &Coded[ REC_CHUNKHDR_SIZE + i * REC_BUFREC_SIZE ];
+    put64( r, ChunkBufs[i].frame );
+    putDouble( r + 8, ChunkBufs[i].adcTime );
+    put32( r + 16, ChunkBufs[i].flags );
+    put32( r + 20, ChunkBufs[i].frames );
+  }
+
+  // delta, zigzag and varint coding per channel
+  for ( c = 0; c < ChanCount; ++c )
+  {
+    int last = 0;
+    for ( i = 0; i < ChunkFrames; ++i )
+    {
+      const int v = ChunkSamples[ i * ChanCount + c ];
+      const int d = v - last;
+      unsigned z = (unsigned)( ( d << 1 ) ^ ( d >> 31 ) );
+      last = v;
+      while ( z >= 0x80 )
+      {
+        Coded.push_back( (unsigned char)( z | 0x80 ) );
+        z >>= 7;
+      }
+      Coded.push_back( (unsigned char)z );
+    }
+  }
+  put32( &Coded[4], (unsigned)Coded.size() );
+
+  IdxRec x;
+  x.offset = rec_ftell( fp );
+  x.frame = ChunkFirstFrame;
+  x.adcTime = ChunkBufs.empty() ? 0.0 : ChunkBufs[0].adcTime;
+  Index.push_back( x );
+
+  fwrite( &Coded[0], Coded.size(), 1, fp );
+  fflush( fp );
+
+  WrittenFrames += ChunkFrames;
+  ChunkFirstFrame += ChunkFrames;
+  ChunkFrames = 0;
+  ChunkSamples.clear();
+  ChunkBufs.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+DCF77RecReader::DCF77RecReader()
+{
+  fp = 0;
+  SampleRate = 0.0;
+  ChanCount = 0;
+  Decimation = 1;
+  Scale = 1.0 / 32767.0;
+  StartTime = 0;
+  FrameCount = 0;
+  DataEnd = 0;
+}
+
+
+DCF77RecReader::~DCF77RecReader()
+{
+  close();
+}
+
+
+void DCF77RecReader::close()
+{
+  if ( fp )
+    fclose( fp );
+  fp = 0;
+  Chunks.clear();
+}
+
+
+bool DCF77RecReader::open( const char * filename, FILE * errstream )
+{
+  unsigned char hdr[REC_HEADER_SIZE];
+  unsigned char trailer[16];
+  unsigned i;
+
+  close();
+  fp = fopen( filename, "rb" );
+  if ( !fp )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not open recording file '%s'\n", filename);
+    return false;
+  }
+
+  if ( 1 != fread( hdr, sizeof(hdr), 1, fp ) || memcmp( hdr, "U775REC1", 8 )
+    || REC_FMT_I16_DELTA != get32( hdr + 28 ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: '%s' is no U77,5 recording\n", filename);
+    close();
+    return false;
+  }
+  ChanCount = get32( hdr + 12 );
+  SampleRate = getDouble( hdr + 16 );
+  Decimation = get32( hdr + 24 );
+  Scale = getDouble( hdr + 32 );
+  StartTime = get64( hdr + 40 );
+
+  // try index from trailer, else scan chunks
+  rec_fseek( fp, 0, SEEK_END );
+  DataEnd = rec_ftell( fp );
+  if ( DataEnd >= REC_HEADER_SIZE + 24
+    && 0 == rec_fseek( fp, DataEnd - 16, SEEK_SET )
+    && 1 == fread( trailer, 16, 1, fp )
+    && !memcmp( trailer + 8, "U775END1", 8 ) )
+  {
+    unsigned char ih[8];
+    const long long indexOffset = get64( trailer );
+    if ( 0 == rec_fseek( fp, indexOffset, SEEK_SET )
+      && 1 == fread( ih, 8, 1, fp ) && !memcmp( ih, "INDX", 4 ) )
+    {
+      const unsigned n = get32( ih + 4 );
+      for ( i = 0; i < n; ++i )
+      {
+        unsigned char rec[24];
+        if ( 1 != fread( rec, 24, 1, fp ) )
+          break;
+        ChunkInfo ci;
+        ci.offset = get64( rec );
+        ci.frame = get64( rec + 8 );
+        ci.adcTime = getDouble( rec + 16 );
+        Chunks.push_back( ci );
+      }
+      DataEnd = indexOffset;
+      if ( Chunks.size() == n )
+      {
+        countFrames();
+        return true;
+      }
+      Chunks.clear();
+    }
+  }
+
+  if ( errstream )
+    fprintf(errstream, "Warning: '%s' has no valid index. scanning chunks\n", filename);
+  return scanChunks();
+}
+
+
+bool DCF77RecReader::scanChunks()
+{
+  long long off = REC_HEADER_SIZE;
+  unsigned char h[REC_CHUNKHDR_SIZE + REC_BUFREC_SIZE];
+
+  while ( off + (long long)sizeof(h) <= DataEnd )
+  {
+    if ( 0 != rec_fseek( fp, off, SEEK_SET ) || 1 != fread( h, sizeof(h), 1, fp )
+      || memcmp( h, "CHNK", 4 ) )
+      break;
+    const unsigned size = get32( h + 4 );
+    if ( size < REC_CHUNKHDR_SIZE || off + size > DataEnd )
+      break;    // truncated chunk
+    ChunkInfo ci;
+    ci.offset = off;
+    ci.frame = get64( h + 8 );
+    ci.adcTime = get32( h + 20 ) ? getDouble( h + REC_CHUNKHDR_SIZE + 8 ) : 0.0;
+    Chunks.push_back( ci );
+    off += size;
+  }
+  countFrames();
+  return true;
+}
+
+
+void DCF77RecReader::countFrames()
+{
+  unsigned char h[REC_CHUNKHDR_SIZE];
+
+  FrameCount = 0;
+  if ( Chunks.empty() )
+    return;
+  if ( 0 == rec_fseek( fp, Chunks.back().offset, SEEK_SET ) && 1 == fread( h, sizeof(h), 1, fp ) )
+    FrameCount = Chunks.back().frame + get32( h + 16 );
+}
+
+
+int DCF77RecReader::findChunk( long long frame ) const
+{
+  int lo = 0, hi = (int)Chunks.size() - 1;
+  if ( hi < 0 || frame < Chunks[0].frame )
+    return -1;
+  while ( lo < hi )
+  {
+    const int mid = ( lo + hi + 1 ) / 2;
+    if ( Chunks[mid].frame <= frame )
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+
+int DCF77RecReader::findChunkByTime( double adcTime ) const
+{
+  int lo = 0, hi = (int)Chunks.size() - 1;
+  if ( hi < 0 || adcTime < Chunks[0].adcTime )
+    return -1;
+  while ( lo < hi )
+  {
+    const int mid = ( lo + hi + 1 ) / 2;
+    if ( Chunks[mid].adcTime <= adcTime )
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+
+bool DCF77RecReader::readChunk( int chunkIdx, std::vector<float> & samples
+                              , std::vector<BufferInfo> & buffers, FILE * errstream )
+{
+  unsigned char h[REC_CHUNKHDR_SIZE];
+  std::vector<unsigned char> raw;
+  unsigned i, c;
+
+  samples.clear();
+  buffers.clear();
+  if ( !fp || chunkIdx < 0 || chunkIdx >= (int)Chunks.size() )
+    return false;
+
+  if ( 0 != rec_fseek( fp, Chunks[chunkIdx].offset, SEEK_SET )
+    || 1 != fread( h, sizeof(h), 1, fp ) || memcmp( h, "CHNK", 4 ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: defect chunk %d\n", chunkIdx);
+    return false;
+  }
+  const unsigned size = get32( h + 4 );
+  const unsigned frames = get32( h + 16 );
+  const unsigned nbufs = get32( h + 20 );
+  if ( size < REC_CHUNKHDR_SIZE + nbufs * REC_BUFREC_SIZE )
+    return false;
+  raw.resize( size - REC_CHUNKHDR_SIZE );
+  if ( !raw.empty() && 1 != fread( &raw[0], raw.size(), 1, fp ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: truncated chunk %d\n", chunkIdx);
+    return false;
+  }
+
+  for ( i = 0; i < nbufs; ++i )
+  {
+    const unsigned char * r = &raw[ i * REC_BUFREC_SIZE ];
+    BufferInfo b;
+    b.frame = get64( r );
+    b.adcTime = getDouble( r + 8 );
+    b.flags = get32( r + 16 );
+    b.frames = get32( r + 20 );
+    buffers.push_back( b );
+  }
+
+  samples.resize( (size_t)frames * ChanCount );
+  size_t pos = nbufs * REC_BUFREC_SIZE;
+  for ( c = 0; c < ChanCount; ++c )
+  {
+    int last = 0;
+    for ( i = 0; i < frames; ++i )
+    {
+      unsigned z = 0;
+      int shift = 0;
+      for (;;)
+      {
+        if ( pos >= raw.size() )
+          return false;
+        const unsigned char b = raw[pos++];
+        z |= (unsigned)( b & 0x7F ) << shift;
+        if ( !( b & 0x80 ) )
+          break;
+        shift += 7;
+      }
+      last += (int)( z >> 1 ) ^ -(int)( z & 1 );
+      samples[ i * ChanCount + c ] = (float)( last * Scale );
+    }
+  }
+  return true;
+}
+
@@ -0,0 +1,183 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77REC_H_
+#define _U775_DCF77REC_H_
+
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Recorder for captured input with a compact, seekable file format.
+//
+// File layout (all values little endian):
+//   header  "U775REC1", header size, channels, sample rate (after
+//           decimation), decimation, sample format, scale, unix start time
+//   chunks  "CHNK", chunk size, first frame, frame count, buffer count,
+//           per buffer: frame, ADC time, flags, frames (all frames
+//           counted after decimation, split buffers per chunk)
+//           samples: int16, delta to previous sample of same channel,
+//           zigzag + varint coded. every chunk decodes on its own
+//   index   "INDX", count, per chunk: file offset, first frame, ADC time
+//   trailer index offset, "U775END1"
+// A file without trailer (e.g. after power loss) is still readable by
+// scanning the chunks.
+//
+// pushBuffer() is meant for the audio callback: it only copies into a
+// preallocated lock-free single producer / single consumer ring and never
+// blocks. Decimation, coding and I/O happen in a background thread.
+
+class DCF77Recorder
+{
+public:
+  DCF77Recorder();
+  ~DCF77Recorder();
+
+  enum
+  {
+      FLAG_INPUT_OVERFLOW = 1   /// reported by sound driver
+    , FLAG_RING_OVERFLOW  = 2   /// buffers before this one got lost in ring
+  };
+
+  // set parameters before open()
+  double          SampleRate;         // of captured input
+  unsigned        ChanCount;
+  unsigned        Decimation;         // average over this many frames
+  unsigned        MaxFramesPerBuffer;
+  unsigned        RingSlots;
+  double          ChunkSeconds;
+
+  bool open( const char * filename, FILE * errstream );
+  void close();
+  bool isOpen() const { return fp != 0; }
+
+  // called from capture callback
+  void pushBuffer( unsigned framecount, const float * data, double adcTime, unsigned flags );
+
+  volatile unsigned  DroppedBuffers;
+  volatile long long WrittenFrames;   // stored (decimated) frames
+
+private:
+  struct Slot
+  {
+    long long   frame;      // captured frame index of first frame
+    double      adcTime;
+    unsigned    flags;
+    unsigned    frames;
+    float *     data;
+  };
+
+  struct BufRec
+  {
+    long long   frame;      // stored frame index of first frame
+    double      adcTime;
+    unsigned    flags;
+    unsigned    frames;     // stored frames of buffer in this chunk
+  };
+
+  struct IdxRec
+  {
+    long long   offset;
+    long long   frame;
+    double      adcTime;
+  };
+
+  void writerLoop();
+  void processSlot( const Slot & s );
+  void flushChunk();
+
+  FILE *              fp;
+  Slot *              Ring;
+  std::atomic<unsigned> Head;       // written by producer
+  std::atomic<unsigned> Tail;       // written by consumer
+  std::atomic<bool>   Running;
+  std::thread         Writer;
+
+  long long           CapturedFrames;
+  bool                LostBuffers;
+
+  // state of writer thread
+  std::vector<float>  DecimAcc;
+  unsigned            DecimCount;
+  long long           StoredFrames;
+  long long           ChunkFirstFrame;
+  unsigned            ChunkFrames;
+  unsigned            FramesPerChunk;
+  std::vector<short>  ChunkSamples;
+  std::vector<BufRec> ChunkBufs;
+  std::vector<IdxRec> Index;
+  std::vector<unsigned char> Coded;
+};
+
+
+// Reader for files written by DCF77Recorder
+class DCF77RecReader
+{
+public:
+  DCF77RecReader();
+  ~DCF77RecReader();
+
+  struct BufferInfo
+  {
+    long long   frame;
+    double      adcTime;
+    unsigned    flags;
+    unsigned    frames;
+  };
+
+  struct ChunkInfo
+  {
+    long long   offset;
+    long long   frame;
+    double      adcTime;
+  };
+
+  bool open( const char * filename, FILE * errstream );
+  void close();
+
+  // index of chunk containing frame, -1 if none
+  int findChunk( long long frame ) const;
+  int findChunkByTime( double adcTime ) const;
+
+  // decode chunk into interleaved float samples
+  bool readChunk( int chunkIdx, std::vector<float> & samples
+                , std::vector<BufferInfo> & buffers, FILE * errstream );
+
+  double          SampleRate;
+  unsigned        ChanCount;
+  unsigned        Decimation;
+  double          Scale;
+  long long       StartTime;     // unix time of recording start
+  long long       FrameCount;    // stored frames in all chunks
+  std::vector<ChunkInfo> Chunks;
+
+private:
+  bool scanChunks();
+  void countFrames();
+
+  FILE *          fp;
+  long long       DataEnd;
+};
+
+#endif /* _U775_DCF77REC_H_ */
+
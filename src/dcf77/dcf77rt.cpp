@@ -0,0 +1,133 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#if !defined(_MSC_VER) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE   /* pthread_setaffinity_np(); before any system header */
+#endif
+
+#include "dcf77rt.h"
+
+#include <string.h>
+#include <errno.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <alloca.h>
+#include <sys/mman.h>
+#endif
+
+
+static void appendErr( char * errbuf, size_t errlen, const char * what, const char * why )
+{
+  const size_t n = strlen( errbuf );
+  if ( n + 1 < errlen )
+    snprintf( errbuf + n, errlen - n, "%s%s: %s", n ? "; " : "", what, why );
+}
+
+
+bool dcf77SetThreadRealtime( int priority, int cpu, char * errbuf, size_t errlen )
+{
+  bool ok = true;
+
+  if ( errlen )
+    errbuf[0] = 0;
+
+#ifdef _MSC_VER
+  if ( priority > 0 && !SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL ) )
+  {
+    appendErr( errbuf, errlen, "SetThreadPriority", "failed" );
+    ok = false;
+  }
+  if ( cpu >= 0 && ( cpu >= 32 || !SetThreadAffinityMask( GetCurrentThread(), (DWORD_PTR)1 << cpu ) ) )
+  {
+    appendErr( errbuf, errlen, "SetThreadAffinityMask", "failed" );
+    ok = false;
+  }
+#else
+  if ( priority > 0 )
+  {
+    struct sched_param param;
+    memset( &param, 0, sizeof(param) );
+    param.sched_priority = priority;
+    const int err = pthread_setschedparam( pthread_self(), SCHED_FIFO, &param );
+    if ( err )
+    {
+      appendErr( errbuf, errlen, "SCHED_FIFO", ( EPERM == err ) ? "no privilege (CAP_SYS_NICE / rtprio limit)" : strerror( err ) );
+      ok = false;
+    }
+  }
+  if ( cpu >= 0 )
+  {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( cpu, &set );
+    const int err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+    if ( err )
+    {
+      appendErr( errbuf, errlen, "CPU affinity", strerror( err ) );
+      ok = false;
+    }
+#else
+    appendErr( errbuf, errlen, "CPU affinity", "not supported on this platform" );
+    ok = false;
+#endif
+  }
+#endif
+  return ok;
+}
+
+
+bool dcf77LockMemory( FILE * errstream )
+{
+#ifdef _MSC_VER
+  if ( errstream )
+    fprintf(errstream, "Error: locking memory is not supported on this platform\n");
+  return false;
+#else
+  if ( mlockall( MCL_CURRENT | MCL_FUTURE ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: mlockall() failed: %s%s\n", strerror( errno )
+             , ( EPERM == errno || ENOMEM == errno ) ? " (needs CAP_IPC_LOCK or higher memlock limit)" : "");
+    return false;
+  }
+  return true;
+#endif
+}
+
+
+void dcf77PrefaultStack( size_t bytes )
+{
+  volatile unsigned char * p = (volatile unsigned char *)alloca( bytes );
+  size_t i;
+  for ( i = 0; i < bytes; i += 4096 )
+    p[i] = 0;
+  if ( bytes )
+    p[bytes - 1] = 0;
+}
+
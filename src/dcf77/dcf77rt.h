@@ -0,0 +1,47 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77RT_H_
+#define _U775_DCF77RT_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Real-time setup of the capture thread.
+//
+// dcf77SetThreadRealtime() and dcf77PrefaultStack() act on the calling
+// thread: call them from inside the capture callback. They don't print,
+// errors are returned in errbuf for reporting from another thread.
+// Linux / POSIX: SCHED_FIFO, pthread affinity, mlockall().
+// MS Windows: time critical thread priority and affinity mask; no memory lock.
+
+// priority: 1 .. 99 (SCHED_FIFO), 0 = keep. cpu: core index, < 0 = keep
+bool dcf77SetThreadRealtime( int priority, int cpu, char * errbuf, size_t errlen );
+
+// lock current and future pages of process into RAM
+bool dcf77LockMemory( FILE * errstream );
+
+// touch bytes of stack below the caller, so that later calls don't page fault
+void dcf77PrefaultStack( size_t bytes );
+
+#endif /* _U775_DCF77RT_H_ */
+
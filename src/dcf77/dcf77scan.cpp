@@ -0,0 +1,174 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77scan.h"
+
+#include <math.h>
+
+
+DCF77PulseScan::DCF77PulseScan()
+{
+  MinScore = 0.3F;
+  init( 48000.0, 1, 10.0 );
+}
+
+
+void DCF77PulseScan::init( double sampleRate, unsigned chanCount, double maxSeconds )
+{
+  unsigned c;
+
+  ChanCount = chanCount ? chanCount : 1;
+  FramesPerBin = (unsigned)( sampleRate / BINS_PER_SEC + 0.5 );
+  if ( !FramesPerBin )
+    FramesPerBin = 1;
+  BinFrames = 0;
+  BinMax.assign( ChanCount, 0.0F );
+  BinMin.assign( ChanCount, 0.0F );
+  Pos.assign( ChanCount, std::vector<float>() );
+  Neg.assign( ChanCount, std::vector<float>() );
+  MaxBins = ( maxSeconds > 0.0 ) ? (unsigned)( maxSeconds * BINS_PER_SEC + 0.5 ) : 0;
+  for ( c = 0; c < ChanCount; ++c )
+  {
+    Pos[c].reserve( MaxBins );
+    Neg[c].reserve( MaxBins );
+  }
+}
+
+
+void DCF77PulseScan::newData( unsigned framecount, const float * data )
+{
+  unsigned i, c;
+
+  for ( i = 0; i < framecount; ++i, data += ChanCount )
+  {
+    if ( Pos[0].size() >= MaxBins )
+      return;     // full: no allocation here
+    if ( !BinFrames )
+    {
+      for ( c = 0; c < ChanCount; ++c )
+        BinMax[c] = BinMin[c] = data[c];
+    }
+    else
+    {
+      for ( c = 0; c < ChanCount; ++c )
+      {
+        if ( data[c] > BinMax[c] )
+          BinMax[c] = data[c];
+        else if ( data[c] < BinMin[c] )
+          BinMin[c] = data[c];
+      }
+    }
+    if ( ++BinFrames < FramesPerBin )
+      continue;
+    BinFrames = 0;
+    for ( c = 0; c < ChanCount; ++c )
+    {
+      Pos[c].push_back( BinMax[c] );
+      Neg[c].push_back( -BinMin[c] );
+    }
+  }
+}
+
+
+double DCF77PulseScan::seconds() const
+{
+  return (double)Pos[0].size() / BINS_PER_SEC;
+}
+
+
+float DCF77PulseScan::autoCorr( const std::vector<float> & x, unsigned lag )
+{
+  const size_t n = x.size();
+  double mean = 0.0, r0 = 0.0, r = 0.0;
+  size_t i;
+
+  if ( n <= lag )
+    return 0.0F;
+  for ( i = 0; i < n; ++i )
+    mean += x[i];
+  mean /= n;
+  for ( i = 0; i < n; ++i )
+    r0 += ( x[i] - mean ) * ( x[i] - mean );
+  for ( i = lag; i < n; ++i )
+    r += ( x[i] - mean ) * ( x[i - lag] - mean );
+  if ( r0 <= 0.0 )
+    return 0.0F;
+  return (float)( r / r0 * n / ( n - lag ) );
+}
+
+
+float DCF77PulseScan::dutyCycle( const std::vector<float> & x )
+{
+  float fold[BINS_PER_SEC] = { 0.0F };
+  float lo, hi;
+  unsigned k, high = 0;
+  size_t i;
+
+  for ( i = 0; i < x.size(); ++i )
+    fold[i % BINS_PER_SEC] += x[i];
+  lo = hi = fold[0];
+  for ( k = 1; k < BINS_PER_SEC; ++k )
+  {
+    if ( fold[k] < lo )
+      lo = fold[k];
+    if ( fold[k] > hi )
+      hi = fold[k];
+  }
+  for ( k = 0; k < BINS_PER_SEC; ++k )
+    if ( fold[k] > 0.5F * ( lo + hi ) )
+      ++high;
+  return (float)high / BINS_PER_SEC;
+}
+
+
+// correlation at 1 s, edges may move by a bin; minus correlation at 0.5 s
+float DCF77PulseScan::periodicity( const std::vector<float> & x )
+{
+  float r1 = autoCorr( x, BINS_PER_SEC );
+  const float rm = autoCorr( x, BINS_PER_SEC - 1 );
+  const float rp = autoCorr( x, BINS_PER_SEC + 1 );
+  const float rh = autoCorr( x, BINS_PER_SEC / 2 );
+  if ( rm > r1 )
+    r1 = rm;
+  if ( rp > r1 )
+    r1 = rp;
+  return r1 - ( rh > 0.0F ? rh : 0.0F );
+}
+
+
+bool DCF77PulseScan::evaluate( unsigned chan, float * score, bool * inverted ) const
+{
+  *score = 0.0F;
+  *inverted = false;
+  if ( chan >= ChanCount || Pos[chan].size() < 2 * BINS_PER_SEC )
+    return false;
+
+  // pulses are short: an envelope high most of the second shows the gaps
+  // between pulses of the other polarity
+  const float pos = ( dutyCycle( Pos[chan] ) < 0.5F ) ? periodicity( Pos[chan] ) : 0.0F;
+  const float neg = ( dutyCycle( Neg[chan] ) < 0.5F ) ? periodicity( Neg[chan] ) : 0.0F;
+  // both with edge coupling: prefer the positive spikes
+  *inverted = ( neg > pos + 0.1F );
+  *score = *inverted ? neg : pos;
+  return *score >= MinScore;
+}
@@ -0,0 +1,75 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77SCAN_H_
+#define _U775_DCF77SCAN_H_
+
+#include <vector>
+
+// Cheap detector for the 1 Hz pulse train of a DCF77 receiver, for all
+// channels of an input at once. Per channel, the maximum and the negated
+// minimum of each 10 ms are kept as envelopes of positive and negative
+// going pulses. After a few seconds, evaluate() compares the
+// autocorrelation of the envelopes at 1 s lag against 0.5 s lag:
+// receiver pulses repeat every second, noise and hum do not, and a
+// periodic tone repeats at both lags. The pulse polarity is the one of the
+// envelope, which is high only for a short part of each second.
+
+class DCF77PulseScan
+{
+public:
+  DCF77PulseScan();
+
+  enum { BINS_PER_SEC = 100 };
+
+  // restart for interleaved input of chanCount channels. allocates for
+  // maxSeconds of input: newData() may run in the capture callback and
+  // ignores any input after that
+  void init( double sampleRate, unsigned chanCount, double maxSeconds );
+  void newData( unsigned framecount, const float * data );
+
+  // seconds of input so far
+  double seconds() const;
+
+  // score of channel chan: about 1 for a clean pulse train, about 0 for
+  // noise; >= MinScore counts as a DCF77 signal. needs >= 2 s of input
+  bool evaluate( unsigned chan, float * score, bool * inverted ) const;
+  float           MinScore;
+
+private:
+  // autocorrelation of mean free x at lag, normalized by lag 0
+  static float autoCorr( const std::vector<float> & x, unsigned lag );
+  // part of the second, in which the folded envelope is high
+  static float dutyCycle( const std::vector<float> & x );
+  static float periodicity( const std::vector<float> & x );
+
+  unsigned        ChanCount;
+  unsigned        FramesPerBin;
+  unsigned        BinFrames;      // frames in current bin
+  unsigned        MaxBins;
+  std::vector<float> BinMax;      // per channel, of current bin
+  std::vector<float> BinMin;
+  std::vector< std::vector<float> > Pos;   // per channel: max per bin
+  std::vector< std::vector<float> > Neg;   // per channel: -min per bin
+};
+
+#endif /* _U775_DCF77SCAN_H_ */
@@ -0,0 +1,340 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77source.h"
+#include "dcf77bytes.h"
+
+#include <string.h>
+#include <chrono>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#endif
+
+
+DCF77AudioSource::DCF77AudioSource()
+{
+  SampleRate = 48000.0;
+  ChanCount = 1;
+  FramesPerBuffer = 480;
+  Format = FMT_FLOAT32;
+  MonotonicAdcTime = false;
+}
+
+
+DCF77AudioSource::~DCF77AudioSource()
+{
+}
+
+
+DCF77ThreadSource::DCF77ThreadSource()
+  : StopReq( false )
+  , cb( 0 )
+  , cbUserData( 0 )
+  , Running( false )
+{
+  Paced = true;
+}
+
+
+DCF77ThreadSource::~DCF77ThreadSource()
+{
+  stop();
+}
+
+
+bool DCF77ThreadSource::start( Callback callback, void * userData, FILE * errstream )
+{
+  if ( Running || Producer.joinable() )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: %s source already started\n", name());
+    return false;
+  }
+  cb = callback;
+  cbUserData = userData;
+  Buf.assign( (size_t)FramesPerBuffer * ChanCount * bytesPerSample( Format ), 0 );
+  MonotonicAdcTime = Paced;
+  StopReq = false;
+  Running = true;
+  Producer = std::thread( &DCF77ThreadSource::producerLoop, this );
+  return true;
+}
+
+
+void DCF77ThreadSource::stop()
+{
+  StopReq = true;
+  if ( Producer.joinable() )
+    Producer.join();
+  Running = false;
+}
+
+
+void DCF77ThreadSource::producerLoop()
+{
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point t0 = Clock::now();
+  const double t0Sec = std::chrono::duration<double>( t0.time_since_epoch() ).count();
+  long long frames = 0;
+
+  while ( !StopReq )
+  {
+    const unsigned n = produce( &Buf[0], FramesPerBuffer );
+    if ( !n )
+      break;
+
+    double adcTime = frames / SampleRate;
+    if ( Paced )
+    {
+      // deliver, when the last frame of the buffer would have been captured
+      adcTime += t0Sec;
+      std::this_thread::sleep_until( t0 + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>( ( frames + n ) / SampleRate ) ) );
+    }
+    cb( n, &Buf[0], adcTime, 0, cbUserData );
+    frames += n;
+  }
+  Running = false;
+}
+
+
+DCF77StreamSource::DCF77StreamSource()
+{
+  Format = FMT_INT16;   // of raw input
+  fp = 0;
+  IsStdin = false;
+}
+
+
+DCF77StreamSource::~DCF77StreamSource()
+{
+  stop();
+  close();
+}
+
+
+void DCF77StreamSource::close()
+{
+  if ( fp && !IsStdin )
+    fclose( fp );
+  fp = 0;
+}
+
+
+// read bytes, but give up on StopReq. got: bytes read; false at end of input
+bool DCF77StreamSource::readFully( void * p, size_t bytes, size_t * got )
+{
+  unsigned char * dst = (unsigned char *)p;
+  size_t n = 0;
+
+  while ( n < bytes && !Pending.empty() )
+  {
+    const size_t k = ( bytes - n < Pending.size() ) ? bytes - n : Pending.size();
+    memcpy( dst + n, &Pending[0], k );
+    Pending.erase( Pending.begin(), Pending.begin() + k );
+    n += k;
+  }
+
+#ifdef _MSC_VER
+  n += fread( dst + n, 1, bytes - n, fp );
+#else
+  // poll instead of blocking read: stop() must not hang on an idle pipe
+  const int fd = fileno( fp );
+  while ( n < bytes && !StopReq )
+  {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    const int r = poll( &pfd, 1, 100 );
+    if ( r < 0 && EINTR == errno )
+      continue;
+    if ( r < 0 )
+      break;
+    if ( 0 == r )
+      continue;
+    const ssize_t k = read( fd, dst + n, bytes - n );
+    if ( k < 0 && EINTR == errno )
+      continue;
+    if ( k <= 0 )
+      break;
+    n += (size_t)k;
+  }
+#endif
+  if ( got )
+    *got = n;
+  return n == bytes;
+}
+
+
+// after "RIFF": walk chunks up to "data"
+bool DCF77StreamSource::parseWav( FILE * errstream )
+{
+  unsigned char h[16];
+  bool haveFmt = false;
+
+  if ( !readFully( h, 8, 0 ) || memcmp( h + 4, "WAVE", 4 ) )
+    goto fail;
+  for (;;)
+  {
+    if ( !readFully( h, 8, 0 ) )
+      goto fail;
+    unsigned size = get32( h + 4 );
+    if ( !memcmp( h, "data", 4 ) )
+      break;
+    if ( !memcmp( h, "fmt ", 4 ) && size >= 16 )
+    {
+      if ( !readFully( h, 16, 0 ) )
+        goto fail;
+      const unsigned fmt = get16( h );
+      const unsigned bits = get16( h + 14 );
+      ChanCount = get16( h + 2 );
+      SampleRate = get32( h + 4 );
+      if ( 1 == fmt && 16 == bits )
+        Format = FMT_INT16;
+      else if ( 3 == fmt && 32 == bits )
+        Format = FMT_FLOAT32;
+      else
+      {
+        if ( errstream )
+          fprintf(errstream, "Error: WAV format %u with %u bits not supported. need int16 or float32\n", fmt, bits);
+        return false;
+      }
+      haveFmt = true;
+      size -= 16;
+    }
+    // skip rest of chunk, with pad byte
+    size += size & 1;
+    while ( size > 0 )
+    {
+      const unsigned k = ( size > sizeof(h) ) ? (unsigned)sizeof(h) : size;
+      if ( !readFully( h, k, 0 ) )
+        goto fail;
+      size -= k;
+    }
+  }
+  if ( haveFmt && ChanCount > 0 && SampleRate > 0.0 )
+    return true;
+
+fail:
+  if ( errstream )
+    fprintf(errstream, "Error: invalid WAV header\n");
+  return false;
+}
+
+
+bool DCF77StreamSource::open( const char * filename, FILE * errstream )
+{
+  unsigned char magic[4];
+  size_t got = 0;
+
+  close();
+  Pending.clear();
+  IsStdin = ( !filename || !strcmp( filename, "-" ) );
+  fp = IsStdin ? stdin : fopen( filename, "rb" );
+  if ( !fp )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not open '%s'\n", filename);
+    return false;
+  }
+
+  readFully( magic, sizeof(magic), &got );
+  if ( got == sizeof(magic) && !memcmp( magic, "RIFF", 4 ) )
+  {
+    if ( !parseWav( errstream ) )
+    {
+      close();
+      return false;
+    }
+  }
+  else
+    Pending.assign( magic, magic + got );   // raw samples
+
+  Raw.resize( (size_t)FramesPerBuffer * ChanCount * bytesPerSample( Format ) );
+  return true;
+}
+
+
+unsigned DCF77StreamSource::produce( void * buf, unsigned frames )
+{
+  const size_t bytesPerFrame = (size_t)bytesPerSample( Format ) * ChanCount;
+  size_t got = 0;
+  size_t i;
+
+  if ( !fp )
+    return 0;
+  readFully( &Raw[0], frames * bytesPerFrame, &got );
+  frames = (unsigned)( got / bytesPerFrame );
+
+  // input is little endian
+  const unsigned char * p = &Raw[0];
+  const size_t n = (size_t)frames * ChanCount;
+  if ( FMT_INT16 == Format )
+  {
+    short * out = (short *)buf;
+    for ( i = 0; i < n; ++i, p += 2 )
+      out[i] = (short)get16( p );
+  }
+  else
+  {
+    unsigned * out = (unsigned *)buf;
+    for ( i = 0; i < n; ++i, p += 4 )
+      out[i] = get32( p );    // int32 or float32 bits
+  }
+  return frames;
+}
+
+
+DCF77SynthSource::DCF77SynthSource()
+{
+}
+
+
+bool DCF77SynthSource::open( const char *, FILE * errstream )
+{
+  if ( !ChanCount || SampleRate < 1000.0 )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: synth source: invalid sample rate or channel count\n");
+    return false;
+  }
+  Format = FMT_FLOAT32;
+  Synth.SampleRate = SampleRate;
+  Synth.ChanCount = ChanCount;
+  if ( Synth.ChanIdx >= ChanCount )
+    Synth.ChanIdx = ChanCount - 1;
+  Synth.reset();
+  return true;
+}
+
+
+unsigned DCF77SynthSource::produce( void * buf, unsigned frames )
+{
+  Synth.generate( frames, (float *)buf );
+  return frames;
+}
+
@@ -0,0 +1,158 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77SOURCE_H_
+#define _U775_DCF77SOURCE_H_
+
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dcf77synth.h"
+
+// Audio sources for the decoder.
+//
+// A source delivers interleaved buffers in its native sample Format with
+// the capture time of their first frame to a callback, from a thread of
+// its own (or of the sound library). The decoder takes int16, int32 and
+// float32 as they are, see DCF77::newData(). Backends:
+//   DCF77PortAudioSource  dcf77pasource.h
+//   DCF77AlsaCapture      dcf77alsa.h
+//   DCF77StreamSource     WAV or raw PCM from file or stdin / pipe
+//   DCF77SynthSource      synthetic signal, see dcf77synth.h
+
+class DCF77AudioSource
+{
+public:
+  DCF77AudioSource();
+  virtual ~DCF77AudioSource();
+
+  enum
+  {
+      FLAG_INPUT_OVERFLOW = 1   /// frames got lost before this buffer
+  };
+
+  typedef enum { FMT_INT16 = 0, FMT_FLOAT32, FMT_INT32 } SampleFormat;
+  static unsigned bytesPerSample( SampleFormat fmt ) { return FMT_INT16 == fmt ? 2 : 4; }
+
+  // data: framecount interleaved frames of ChanCount channels in Format,
+  // only valid during call
+  // adcTime: capture time of first frame in seconds, 0 if unknown
+  typedef void (*Callback)( unsigned framecount, const void * data, double adcTime
+                          , unsigned flags, void * userData );
+
+  // requested parameters: set before open(). open() may change them
+  double          SampleRate;
+  unsigned        ChanCount;
+  unsigned        FramesPerBuffer;
+  SampleFormat    Format;         // default FMT_FLOAT32
+
+  // true if adcTime is steady_clock / CLOCK_MONOTONIC (see DCF77Trace::now())
+  bool            MonotonicAdcTime;
+
+  virtual const char * name() const = 0;
+  virtual bool open( const char * device, FILE * errstream ) = 0;
+  virtual void close() = 0;
+  virtual bool start( Callback cb, void * userData, FILE * errstream ) = 0;
+  virtual void stop() = 0;
+  // false after stop(), end of input or a fatal error
+  virtual bool isRunning() const = 0;
+};
+
+
+// base for sources with an own producer thread
+class DCF77ThreadSource : public DCF77AudioSource
+{
+public:
+  DCF77ThreadSource();
+  virtual ~DCF77ThreadSource();
+
+  // deliver in real time (adcTime: monotonic clock), else as fast as
+  // possible (adcTime: stream time from 0)
+  bool            Paced;
+
+  virtual bool start( Callback cb, void * userData, FILE * errstream );
+  virtual void stop();
+  virtual bool isRunning() const { return Running.load(); }
+
+protected:
+  // fill up to frames frames in Format into buf; return count, 0 at end of input
+  virtual unsigned produce( void * buf, unsigned frames ) = 0;
+  std::atomic<bool> StopReq;
+
+private:
+  void producerLoop();
+
+  Callback          cb;
+  void *            cbUserData;
+  std::atomic<bool> Running;
+  std::thread       Producer;
+  std::vector<unsigned char> Buf;
+};
+
+
+// PCM from file or stdin ("-"): WAV (int16 / float32, detected by header)
+// or raw samples in Format. Delivered in the format of the input
+class DCF77StreamSource : public DCF77ThreadSource
+{
+public:
+  DCF77StreamSource();
+  virtual ~DCF77StreamSource();
+
+  virtual const char * name() const { return "stream"; }
+  virtual bool open( const char * filename, FILE * errstream );
+  virtual void close();
+
+protected:
+  virtual unsigned produce( void * buf, unsigned frames );
+
+private:
+  bool readFully( void * p, size_t bytes, size_t * got );
+  bool parseWav( FILE * errstream );
+
+  FILE *            fp;
+  bool              IsStdin;
+  std::vector<unsigned char> Raw;
+  std::vector<unsigned char> Pending;   // header bytes of non WAV input
+};
+
+
+// synthetic DCF77 receiver signal. set parameters in Synth before open().
+// always FMT_FLOAT32
+class DCF77SynthSource : public DCF77ThreadSource
+{
+public:
+  DCF77SynthSource();
+
+  DCF77Synth      Synth;
+
+  virtual const char * name() const { return "synth"; }
+  virtual bool open( const char * device, FILE * errstream );
+  virtual void close() {}
+
+protected:
+  virtual unsigned produce( void * buf, unsigned frames );
+};
+
+#endif /* _U775_DCF77SOURCE_H_ */
+
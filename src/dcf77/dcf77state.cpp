@@ -0,0 +1,198 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77state.h"
+#include "dcf77.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+DCF77WarmState::DCF77WarmState()
+{
+  SampleRate = 0.0;
+  ChanIdx = 0;
+  Invert = false;
+  Mean = Max = 0.0F;
+  Threshold = ThresholdLow = 0.0F;
+  MeasuredRate = 0.0;
+  PulseOffsetMs = 0.0F;
+  PulseSigmaMs[0] = PulseSigmaMs[1] = 10.0F;
+  GapSigmaMs = 10.0F;
+  LastUtc = -1;
+  SavedAt = 0;
+}
+
+
+void DCF77WarmState::fromDecoder( const DCF77 & dcf, long long lastUtc, long long hostTime )
+{
+  SampleRate = dcf.SampleRate;
+  ChanIdx = dcf.ChanIdx;
+  Invert = dcf.Invert;
+  Mean = dcf.Mean;
+  Max = dcf.Max;
+  Threshold = dcf.Threshold;
+  ThresholdLow = dcf.ThresholdLow;
+  MeasuredRate = dcf.MeasuredRate;
+  PulseOffsetMs = dcf.PulseOffsetMs;
+  PulseSigmaMs[0] = dcf.PulseSigmaMs[0];
+  PulseSigmaMs[1] = dcf.PulseSigmaMs[1];
+  GapSigmaMs = dcf.GapSigmaMs;
+  LastUtc = lastUtc;
+  SavedAt = hostTime;
+}
+
+
+bool DCF77WarmState::toDecoder( DCF77 & dcf ) const
+{
+  if ( SampleRate != dcf.SampleRate || ChanIdx != dcf.ChanIdx || Invert != dcf.Invert
+    || !( Threshold > Mean ) || ThresholdLow > Threshold )
+    return false;
+
+  // a rate off by more than 1000 ppm is from another device
+  if ( MeasuredRate > 0.0 && fabs( MeasuredRate / SampleRate - 1.0 ) < 1E-3 )
+  {
+    dcf.MeasuredRate = MeasuredRate;
+    dcf.MeasuredRatePpm = 1E6 * ( MeasuredRate / SampleRate - 1.0 );
+  }
+  dcf.PulseOffsetMs = PulseOffsetMs;
+  dcf.PulseSigmaMs[0] = PulseSigmaMs[0];
+  dcf.PulseSigmaMs[1] = PulseSigmaMs[1];
+  dcf.GapSigmaMs = GapSigmaMs;
+  dcf.warmStart( Mean, Max, Threshold, ThresholdLow );
+  return true;
+}
+
+
+long long DCF77WarmState::expectedUtc( long long hostTime ) const
+{
+  if ( LastUtc < 0 )
+    return -1;
+  // nearest minute: host clock and minute edges are not in phase
+  const long long t = LastUtc + ( hostTime - SavedAt ) + 30;
+  return t - ( ( t % 60 ) + 60 ) % 60;
+}
+
+
+bool DCF77WarmState::load( const char * filename, FILE * errstream )
+{
+  FILE * fp = fopen( filename, "r" );
+  char line[128], key[32];
+  int inv = 0;
+
+  if ( !fp )
+  {
+    if ( errno != ENOENT && errstream )
+      fprintf(errstream, "Error: can not open state file '%s': %s\n", filename, strerror(errno));
+    return false;
+  }
+  if ( !fgets( line, sizeof(line), fp ) || strncmp( line, "U775STATE1", 10 ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: '%s' is no state file\n", filename);
+    fclose( fp );
+    return false;
+  }
+
+  *this = DCF77WarmState();
+  while ( fgets( line, sizeof(line), fp ) )
+  {
+    const char * v;
+    if ( 1 != sscanf( line, "%31s", key ) )
+      continue;
+    v = line + strlen( key );
+    if ( !strcmp( key, "samplerate" ) )
+      SampleRate = atof( v );
+    else if ( !strcmp( key, "chan" ) )
+      ChanIdx = (unsigned)atoi( v );
+    else if ( !strcmp( key, "invert" ) )
+      inv = atoi( v );
+    else if ( !strcmp( key, "mean" ) )
+      Mean = (float)atof( v );
+    else if ( !strcmp( key, "max" ) )
+      Max = (float)atof( v );
+    else if ( !strcmp( key, "threshold" ) )
+      sscanf( v, "%f %f", &Threshold, &ThresholdLow );
+    else if ( !strcmp( key, "measuredrate" ) )
+      MeasuredRate = atof( v );
+    else if ( !strcmp( key, "pulseoffset" ) )
+      PulseOffsetMs = (float)atof( v );
+    else if ( !strcmp( key, "pulsesigma" ) )
+      sscanf( v, "%f %f", &PulseSigmaMs[0], &PulseSigmaMs[1] );
+    else if ( !strcmp( key, "gapsigma" ) )
+      GapSigmaMs = (float)atof( v );
+    else if ( !strcmp( key, "lastutc" ) )
+      sscanf( v, "%lld %lld", &LastUtc, &SavedAt );
+  }
+  Invert = ( inv != 0 );
+  fclose( fp );
+  return true;
+}
+
+
+bool DCF77WarmState::save( const char * filename, FILE * errstream ) const
+{
+  char tmp[1024];
+  FILE * fp;
+
+  snprintf( tmp, sizeof(tmp), "%s.tmp", filename );
+  fp = fopen( tmp, "w" );
+  if ( !fp )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: can not write state file '%s': %s\n", tmp, strerror(errno));
+    return false;
+  }
+  fprintf(fp, "U775STATE1\n");
+  fprintf(fp, "samplerate %.3f\n", SampleRate);
+  fprintf(fp, "chan %u\n", ChanIdx);
+  fprintf(fp, "invert %d\n", Invert ? 1 : 0);
+  fprintf(fp, "mean %.9g\n", Mean);
+  fprintf(fp, "max %.9g\n", Max);
+  fprintf(fp, "threshold %.9g %.9g\n", Threshold, ThresholdLow);
+  fprintf(fp, "measuredrate %.6f\n", MeasuredRate);
+  fprintf(fp, "pulseoffset %.3f\n", PulseOffsetMs);
+  fprintf(fp, "pulsesigma %.3f %.3f\n", PulseSigmaMs[0], PulseSigmaMs[1]);
+  fprintf(fp, "gapsigma %.3f\n", GapSigmaMs);
+  fprintf(fp, "lastutc %lld %lld\n", LastUtc, SavedAt);
+  if ( fclose( fp ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: can not write state file '%s': %s\n", tmp, strerror(errno));
+    remove( tmp );
+    return false;
+  }
+#ifdef _MSC_VER
+  remove( filename );   // rename does not replace
+#endif
+  if ( rename( tmp, filename ) )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: can not replace state file '%s': %s\n", filename, strerror(errno));
+    remove( tmp );
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,71 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77STATE_H_
+#define _U775_DCF77STATE_H_
+
+#include <stdio.h>
+
+class DCF77;
+
+// Decoder state kept across restarts for a warm start: levels and
+// thresholds of the comparator, measured sample rate, learned pulse
+// statistics and the last valid minute.
+//
+// Text file: "U775STATE1", then one "key value" line per member. save()
+// writes <file>.tmp and renames it, so a crash never leaves half a file.
+
+struct DCF77WarmState
+{
+  DCF77WarmState();
+
+  // input the state belongs to
+  double        SampleRate;
+  unsigned      ChanIdx;
+  bool          Invert;
+
+  float         Mean;
+  float         Max;
+  float         Threshold;
+  float         ThresholdLow;
+  double        MeasuredRate;     // 0 if unknown
+  float         PulseOffsetMs;
+  float         PulseSigmaMs[2];
+  float         GapSigmaMs;
+
+  long long     LastUtc;          // last valid minute (unix time), -1 if none
+  long long     SavedAt;          // host clock (unix time) of LastUtc
+
+  // from a decoder in STATE_GET_TIME and its last valid minute
+  void fromDecoder( const DCF77 & dcf, long long lastUtc, long long hostTime );
+  // warm start of dcf. false, if the state belongs to another input
+  bool toDecoder( DCF77 & dcf ) const;
+  // minute edge expected at hostTime (nearest), from the last valid one.
+  // only as good as the host clock over the restart
+  long long expectedUtc( long long hostTime ) const;
+
+  // load: false without message, if the file does not exist
+  bool load( const char * filename, FILE * errstream );
+  bool save( const char * filename, FILE * errstream ) const;
+};
+
+#endif /* _U775_DCF77STATE_H_ */
@@ -0,0 +1,242 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77synth.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846
+#endif
+
+
+// unix time of 01:00 UTC on last sunday of month (1 .. 12)
+static long long lastSunday( int year, int month )
+{
+  struct tm t;
+  memset( &t, 0, sizeof(t) );
+  t.tm_year = year - 1900;
+  t.tm_mon = month;       // first day of following month
+  t.tm_mday = 1;
+  t.tm_hour = 1;
+  const time_t u = timegm( &t ) - 86400;
+  gmtime_r( &u, &t );
+  return (long long)u - 86400LL * t.tm_wday;
+}
+
+
+// MESZ from last sunday in march to last sunday in october, 01:00 UTC
+static bool isSummerTime( long long utc )
+{
+  struct tm t;
+  const time_t tt = (time_t)utc;
+  gmtime_r( &tt, &t );
+  const int year = t.tm_year + 1900;
+  return utc >= lastSunday( year, 3 ) && utc < lastSunday( year, 10 );
+}
+
+
+static void putBCD( int bits[60], int pos, int value, int count )
+{
+  const int bcd = ( value % 10 ) | ( ( value / 10 ) << 4 );
+  int i;
+  for ( i = 0; i < count; ++i )
+    bits[pos + i] = ( bcd >> i ) & 1;
+}
+
+
+static int parity( const int bits[60], int first, int last )
+{
+  int p = 0;
+  for ( ; first <= last; ++first )
+    p ^= bits[first];
+  return p;
+}
+
+
+void DCF77Synth::encodeMinute( long long utcMinute, int bits[60] )
+{
+  const long long next = utcMinute + 60;
+  const bool summer = isSummerTime( next );
+  const time_t local = (time_t)( next + ( summer ? 7200 : 3600 ) );
+  struct tm t;
+  gmtime_r( &local, &t );
+  const int weekday = t.tm_wday ? t.tm_wday : 7;  // 1 .. 7 == monday .. sunday
+
+  memset( bits, 0, 60 * sizeof(int) );
+  bits[16] = ( isSummerTime( next + 3600 ) != summer ) ? 1 : 0;   // change announcement
+  bits[17] = summer ? 1 : 0;
+  bits[18] = summer ? 0 : 1;
+  bits[20] = 1;
+  putBCD( bits, 21, t.tm_min, 7 );
+  bits[28] = parity( bits, 21, 27 );
+  putBCD( bits, 29, t.tm_hour, 6 );
+  bits[35] = parity( bits, 29, 34 );
+  putBCD( bits, 36, t.tm_mday, 6 );
+  putBCD( bits, 42, weekday, 3 );
+  putBCD( bits, 45, t.tm_mon + 1, 5 );
+  putBCD( bits, 50, t.tm_year % 100, 8 );
+  bits[58] = parity( bits, 36, 57 );
+}
+
+
+DCF77Synth::DCF77Synth()
+{
+  SampleRate = 48000.0;
+  ChanCount = 1;
+  ChanIdx = 0;
+  StartTime = 1200000000;   // 2008-01-10 21:20:00 UTC
+  StartOffset = 0.5;
+  Seed = 1;
+
+  eCoupling = COUPLING_EDGE;
+  Amplitude = 0.8F;
+  SpikeMs = 3.0;
+  NoiseRms = 0.01;
+  FadeDepth = 0.0;
+  FadePeriod = 30.0;
+  PulseStretchMs = 0.0;
+  EdgeJitterMs = 0.0;
+  DropoutRate = 0.0;
+  ImpulseRate = 0.0;
+  ImpulseAmp = 1.0;
+  ClockPpm = 0.0;
+
+  reset();
+}
+
+
+unsigned DCF77Synth::rnd()
+{
+  // xorshift32: same sequence on every platform
+  RndState ^= RndState << 13;
+  RndState ^= RndState >> 17;
+  RndState ^= RndState << 5;
+  return RndState;
+}
+
+
+double DCF77Synth::uniform()
+{
+  return ( rnd() >> 8 ) * ( 1.0 / 16777216.0 );
+}
+
+
+double DCF77Synth::gauss()
+{
+  // Box-Muller
+  const double u1 = uniform() + 1E-12;
+  const double u2 = uniform();
+  return sqrt( -2.0 * log( u1 ) ) * cos( 2.0 * M_PI * u2 );
+}
+
+
+void DCF77Synth::reset()
+{
+  FrameIndex = 0;
+  RndState = Seed ? Seed : 1;
+  CurrSecond = -2;
+  CurrMinute = -1;
+  HasPulse = false;
+  ImpulseUntil = -1.0;
+  ImpulseValue = 0.0;
+}
+
+
+double DCF77Synth::secondMarkFrame( long long second ) const
+{
+  return ( StartOffset + second ) * SampleRate * ( 1.0 + ClockPpm * 1E-6 );
+}
+
+
+void DCF77Synth::prepareSecond( long long second )
+{
+  const long long utc = StartTime + second;
+  const long long minute = utc - ( ( utc % 60 ) + 60 ) % 60;
+  const int secInMinute = (int)( utc - minute );
+
+  CurrSecond = second;
+  if ( minute != CurrMinute )
+  {
+    CurrMinute = minute;
+    encodeMinute( minute, Bits );
+  }
+
+  // the random sequence is consumed identically, whatever is used of it
+  const double jitRise = EdgeJitterMs * 1E-3 * ( 2.0 * uniform() - 1.0 );
+  const double jitFall = EdgeJitterMs * 1E-3 * ( 2.0 * uniform() - 1.0 );
+  const bool dropout = ( uniform() < DropoutRate );
+
+  HasPulse = ( second >= 0 && 59 != secInMinute && !dropout );
+  // rising edge never before the second mark: late only
+  EdgeRise = ( jitRise > 0.0 ) ? jitRise : 0.0;
+  EdgeFall = ( Bits[secInMinute] ? 0.2 : 0.1 ) + PulseStretchMs * 1E-3 + jitFall;
+}
+
+
+void DCF77Synth::generate( unsigned framecount, float * out )
+{
+  const double rate = SampleRate * ( 1.0 + ClockPpm * 1E-6 );
+  const double spike = SpikeMs * 1E-3;
+  const double impulseProb = ImpulseRate / SampleRate;
+  unsigned i, c;
+
+  for ( i = 0; i < framecount; ++i, ++FrameIndex, out += ChanCount )
+  {
+    const double t = FrameIndex / rate - StartOffset;
+    const long long second = (long long)floor( t );
+    if ( second != CurrSecond )
+      prepareSecond( second );
+    const double ts = t - second;
+
+    double v = 0.0;
+    if ( HasPulse )
+    {
+      if ( COUPLING_LEVEL == eCoupling )
+        v = ( ts >= EdgeRise && ts < EdgeFall ) ? 1.0 : 0.0;
+      else
+        v = ( ( ts >= EdgeRise && ts < EdgeRise + spike )
+           || ( ts >= EdgeFall && ts < EdgeFall + spike ) ) ? 1.0 : 0.0;
+    }
+    if ( FadeDepth > 0.0 )
+      v *= 1.0 - FadeDepth * ( 0.5 + 0.5 * sin( 2.0 * M_PI * t / FadePeriod ) );
+    v *= Amplitude;
+
+    if ( impulseProb > 0.0 && uniform() < impulseProb )
+    {
+      ImpulseUntil = t + 0.001;
+      ImpulseValue = ImpulseAmp * uniform();
+    }
+    if ( t < ImpulseUntil )
+      v += ImpulseValue;
+
+    for ( c = 0; c < ChanCount; ++c )
+    {
+      const double n = ( NoiseRms > 0.0 ) ? NoiseRms * gauss() : 0.0;
+      out[c] = (float)( ( c == ChanIdx ? v : 0.0 ) + n );
+    }
+  }
+}
+
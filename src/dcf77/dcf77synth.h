@@ -0,0 +1,99 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77SYNTH_H_
+#define _U775_DCF77SYNTH_H_
+
+// Deterministic synthesizer for the signal of a DCF77 receiver module,
+// as seen by the sound card. Same parameters and Seed give the same
+// samples on every machine.
+//
+// Ground truth: second mark n (n = 0, 1, ..) starts at
+//   secondMarkFrame(n) = ( StartOffset + n ) * SampleRate * ( 1 + ClockPpm * 1E-6 )
+// and belongs to unix time StartTime + n (UTC). Minute marks are those
+// with ( StartTime + n ) % 60 == 0.
+
+class DCF77Synth
+{
+public:
+  DCF77Synth();
+
+  typedef enum
+  {
+      COUPLING_EDGE   /// short spike at every transition (default, see DCF77::newData)
+    , COUPLING_LEVEL  /// plain output level of receiver module
+  }
+    Coupling;
+
+  double      SampleRate;       // nominal rate
+  unsigned    ChanCount;
+  unsigned    ChanIdx;          // channel with signal. others get noise only
+  long long   StartTime;        // unix time (UTC) of first second mark
+  double      StartOffset;      // seconds of signal before first second mark
+  unsigned    Seed;
+
+  Coupling    eCoupling;
+  float       Amplitude;
+  double      SpikeMs;          // width of spikes for COUPLING_EDGE
+  double      NoiseRms;         // gaussian noise
+  double      FadeDepth;        // 0 .. 1: sinusoidal fading of amplitude
+  double      FadePeriod;       // seconds
+  double      PulseStretchMs;   // added to every pulse width (slow RC stages)
+  double      EdgeJitterMs;     // uniform +/- per edge
+  double      DropoutRate;      // probability of a second without any pulse
+  double      ImpulseRate;      // impulsive interference per second
+  double      ImpulseAmp;
+  double      ClockPpm;         // sample clock deviation from nominal rate
+
+  // restart at frame 0 with current parameters
+  void reset();
+  // generate next framecount interleaved frames
+  void generate( unsigned framecount, float * out );
+
+  double secondMarkFrame( long long second ) const;
+  long long FrameIndex;         // frames generated since reset()
+
+  // DCF77 bits 0 .. 58 of the minute starting at utcMinute
+  // (which announce local time of the following minute)
+  static void encodeMinute( long long utcMinute, int bits[60] );
+
+private:
+  unsigned  rnd();
+  double    uniform();    // 0 .. 1
+  double    gauss();
+
+  void      prepareSecond( long long second );
+
+  unsigned  RndState;
+  long long CurrSecond;
+  long long CurrMinute;
+  int       Bits[60];
+  // edges of current second in seconds relative to its second mark
+  double    EdgeRise;
+  double    EdgeFall;
+  bool      HasPulse;
+  double    ImpulseUntil;
+  double    ImpulseValue;
+};
+
+#endif /* _U775_DCF77SYNTH_H_ */
+
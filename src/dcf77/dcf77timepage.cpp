@@ -0,0 +1,211 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77timepage.h"
+
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+DCF77TimePage::DCF77TimePage()
+{
+  Page = 0;
+}
+
+
+DCF77TimePage::~DCF77TimePage()
+{
+  close();
+}
+
+
+bool DCF77TimePage::create( const char * filename, FILE * errstream )
+{
+  close();
+#ifdef _MSC_VER
+  (void)filename;
+  if ( errstream )
+    fprintf(errstream, "Error: time page not available on this platform\n");
+  return false;
+#else
+  const int fd = ::open( filename, O_RDWR | O_CREAT, 0644 );
+  void * p = MAP_FAILED;
+  if ( fd >= 0 && 0 == ftruncate( fd, sizeof(DCF77TimePageLayout) ) )
+    p = mmap( NULL, sizeof(DCF77TimePageLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  if ( MAP_FAILED == p )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: time page '%s': %s\n", filename, strerror(errno));
+    if ( fd >= 0 )
+      ::close( fd );
+    return false;
+  }
+  fchmod( fd, 0644 );    // despite umask
+  ::close( fd );
+  Page = (DCF77TimePageLayout *)p;
+
+  // readers of an old page see an odd Seq until the first publish()
+  Page->Seq.store( Page->Seq.load( std::memory_order_relaxed ) | 1, std::memory_order_relaxed );
+  std::atomic_thread_fence( std::memory_order_release );
+  memset( &Page->Ref, 0, sizeof(Page->Ref) );
+  Page->Version = DCF77TimePageLayout::VERSION;
+  Page->Magic = DCF77TimePageLayout::MAGIC;
+  Page->Seq.store( Page->Seq.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+  return true;
+#endif
+}
+
+
+void DCF77TimePage::close()
+{
+#ifndef _MSC_VER
+  if ( Page )
+    munmap( Page, sizeof(DCF77TimePageLayout) );
+#endif
+  Page = 0;
+}
+
+
+void DCF77TimePage::publish( const DCF77TimeRef & ref )
+{
+  if ( !Page )
+    return;
+  const uint32_t seq = Page->Seq.load( std::memory_order_relaxed );
+  Page->Seq.store( seq + 1, std::memory_order_relaxed );
+  std::atomic_thread_fence( std::memory_order_release );
+  Page->Ref = ref;
+  Page->Seq.store( seq + 2, std::memory_order_release );
+}
+
+
+DCF77TimePageReader::DCF77TimePageReader()
+{
+  Page = 0;
+  Retries = 0;
+}
+
+
+DCF77TimePageReader::~DCF77TimePageReader()
+{
+  close();
+}
+
+
+bool DCF77TimePageReader::open( const char * filename, FILE * errstream )
+{
+  close();
+#ifdef _MSC_VER
+  (void)filename;
+  if ( errstream )
+    fprintf(errstream, "Error: time page not available on this platform\n");
+  return false;
+#else
+  struct stat st;
+  const int fd = ::open( filename, O_RDONLY );
+  void * p = MAP_FAILED;
+  if ( fd >= 0 && 0 == fstat( fd, &st ) && st.st_size >= (off_t)sizeof(DCF77TimePageLayout) )
+    p = mmap( NULL, sizeof(DCF77TimePageLayout), PROT_READ, MAP_SHARED, fd, 0 );
+  if ( fd >= 0 )
+    ::close( fd );
+  if ( MAP_FAILED == p )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: time page '%s': %s\n", filename, fd >= 0 ? "too small" : strerror(errno));
+    return false;
+  }
+  Page = (const DCF77TimePageLayout *)p;
+  if ( DCF77TimePageLayout::MAGIC != Page->Magic || DCF77TimePageLayout::VERSION != Page->Version )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: '%s' is no time page of version %d\n", filename, DCF77TimePageLayout::VERSION);
+    close();
+    return false;
+  }
+  return true;
+#endif
+}
+
+
+void DCF77TimePageReader::close()
+{
+#ifndef _MSC_VER
+  if ( Page )
+    munmap( (void *)Page, sizeof(DCF77TimePageLayout) );
+#endif
+  Page = 0;
+}
+
+
+bool DCF77TimePageReader::read( DCF77TimeRef * ref ) const
+{
+  uint32_t s0, s1;
+  unsigned n;
+  if ( !Page )
+    return false;
+  // publisher died while writing: give up some time
+  for ( n = 0; n < 100000; ++n )
+  {
+    s0 = Page->Seq.load( std::memory_order_acquire );
+    if ( !( s0 & 1 ) )
+    {
+      memcpy( ref, (const void *)&Page->Ref, sizeof(*ref) );
+      std::atomic_thread_fence( std::memory_order_acquire );
+      s1 = Page->Seq.load( std::memory_order_relaxed );
+      if ( s0 == s1 )
+        return true;
+    }
+    ++Retries;
+  }
+  return false;
+}
+
+
+int64_t DCF77TimePageReader::monoNs()
+{
+  return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+bool DCF77TimePageReader::now( int64_t * utcNs, double * errNs, uint32_t * status ) const
+{
+  DCF77TimeRef r;
+  *status = 0;
+  if ( !read( &r ) )
+    return false;
+  *status = r.Status;
+  if ( !( r.Status & DCF77TimeRef::STATUS_VALID ) )
+    return false;
+  const int64_t dt = monoNs() - r.RefMonoNs;
+  *utcNs = r.RefUtcNs + dt + (int64_t)( dt * r.Rate );
+  *errNs = r.ErrNs + dt * 1E-9 * r.ErrGrowth;
+  return true;
+}
@@ -0,0 +1,114 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77TIMEPAGE_H_
+#define _U775_DCF77TIMEPAGE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+// Time reference in a shared memory page for any number of local readers,
+// without locks and without syscalls (CLOCK_MONOTONIC is read through the
+// vDSO on Linux).
+//
+// The publisher maps a file, best on tmpfs (e.g. /dev/shm/dcf77-time), and
+// writes the reference under a seqlock: Seq is odd while writing. Readers
+// copy the reference and retry, if Seq changed or was odd. UTC at monotonic
+// time t (ns, steady_clock) is
+//   RefUtcNs + ( t - RefMonoNs ) * ( 1 + Rate )
+// with error bound ErrNs + ( t - RefMonoNs ) * 1E-9 * ErrGrowth.
+
+struct DCF77TimeRef
+{
+  enum
+  {
+      STATUS_VALID    = 1   /// reference available
+    , STATUS_SYNC     = 2   /// valid minute in the last 2 minutes
+    , STATUS_SIGNAL   = 4   /// decoder receives second pulses
+  };
+
+  uint32_t    Status;
+  uint32_t    Fixes;          // valid minutes in model
+  int64_t     RefMonoNs;      // minute edge of last valid minute, steady_clock
+  int64_t     RefUtcNs;       // UTC at RefMonoNs, from the holdover model
+  double      Rate;           // relative frequency of UTC against monotonic clock
+  double      ErrNs;          // 1 sigma at RefMonoNs
+  double      ErrGrowth;      // ns per second
+  double      SampleRate;     // measured audio clock, 0 if not known yet
+  int64_t     UpdateMonoNs;   // time of publishing
+};
+
+struct DCF77TimePageLayout
+{
+  enum { MAGIC = 0x35373755, VERSION = 1 };   // "U775"
+
+  uint32_t    Magic;
+  uint32_t    Version;
+  std::atomic<uint32_t> Seq;
+  uint32_t    Reserved;
+  DCF77TimeRef Ref;
+};
+
+
+class DCF77TimePage
+{
+public:
+  DCF77TimePage();
+  ~DCF77TimePage();
+
+  // create or take over filename, world readable
+  bool create( const char * filename, FILE * errstream );
+  void close();
+  bool isOpen() const { return 0 != Page; }
+
+  void publish( const DCF77TimeRef & ref );
+
+private:
+  DCF77TimePageLayout * Page;
+};
+
+
+class DCF77TimePageReader
+{
+public:
+  DCF77TimePageReader();
+  ~DCF77TimePageReader();
+
+  bool open( const char * filename, FILE * errstream );
+  void close();
+
+  // consistent copy of the reference. false if not open or the
+  // publisher hangs in the middle of an update
+  bool read( DCF77TimeRef * ref ) const;
+  // UTC now in ns since 1970 and 1 sigma bound. false without reference;
+  // status is set anyway (0 if the page could not be read)
+  bool now( int64_t * utcNs, double * errNs, uint32_t * status ) const;
+
+  static int64_t monoNs();
+  mutable unsigned Retries;   // seqlock retries, statistics
+
+private:
+  const DCF77TimePageLayout * Page;
+};
+
+#endif /* _U775_DCF77TIMEPAGE_H_ */
@@ -0,0 +1,163 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77trace.h"
+
+#include <chrono>
+#include <new>
+
+
+DCF77Trace::DCF77Trace()
+  : Enabled( false )
+  , Ring( 0 )
+  , Mask( 0 )
+  , Next( 0 )
+{
+}
+
+
+DCF77Trace::~DCF77Trace()
+{
+  delete [] Ring;
+}
+
+
+bool DCF77Trace::init( unsigned capacity )
+{
+  unsigned n = 1;
+  unsigned i;
+
+  while ( n < capacity && n < 0x80000000U )
+    n <<= 1;
+  Enabled = false;
+  delete [] Ring;
+  Ring = new (std::nothrow) Event[n];
+  if ( !Ring )
+  {
+    Mask = 0;
+    return false;
+  }
+  for ( i = 0; i < n; ++i )
+    Ring[i].seq.store( 0, std::memory_order_relaxed );
+  Mask = n - 1;
+  Next = 0;
+  return true;
+}
+
+
+long long DCF77Trace::now()
+{
+  return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+void DCF77Trace::add( EventType type, unsigned tid, long long beginNs, long long endNs
+                    , unsigned frames, long long adcAgeNs )
+{
+  if ( !Ring || !Enabled.load( std::memory_order_relaxed ) )
+    return;
+
+  const unsigned long long idx = Next.fetch_add( 1, std::memory_order_relaxed );
+  Event & e = Ring[idx & Mask];
+  // mark slot as incomplete while writing
+  e.seq.store( 0, std::memory_order_relaxed );
+  std::atomic_thread_fence( std::memory_order_release );
+  e.beginNs = beginNs;
+  e.endNs = endNs;
+  e.adcAgeNs = adcAgeNs;
+  e.frames = frames;
+  e.type = (unsigned short)type;
+  e.tid = (unsigned short)tid;
+  e.seq.store( idx + 1, std::memory_order_release );
+}
+
+
+bool DCF77Trace::dump( const char * filename, FILE * errstream ) const
+{
+  static const char * Names[EV_COUNT] =
+  { "recordCallback", "DCF77::newData", "DCF77PRN::newData", "DCF77Recorder::pushBuffer"
+  , "evalMinPulse", "setSystemTime" };
+
+  if ( !Ring )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: trace not initialized\n");
+    return false;
+  }
+
+  FILE * fp = fopen( filename, "w" );
+  if ( !fp )
+  {
+    if ( errstream )
+      fprintf(errstream, "Error: could not create trace file '%s'\n", filename);
+    return false;
+  }
+
+  const unsigned long long end = Next.load( std::memory_order_acquire );
+  const unsigned long long size = (unsigned long long)Mask + 1;
+  unsigned long long idx = ( end > size ) ? end - size : 0;
+  long long base = -1;
+  bool first = true;
+
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for ( ; idx < end; ++idx )
+  {
+    const Event & e = Ring[idx & Mask];
+    if ( e.seq.load( std::memory_order_acquire ) != idx + 1 )
+      continue;
+    const long long beginNs = e.beginNs;
+    const long long endNs = e.endNs;
+    const long long adcAgeNs = e.adcAgeNs;
+    const unsigned frames = e.frames;
+    const unsigned type = e.type;
+    const unsigned tid = e.tid;
+    std::atomic_thread_fence( std::memory_order_acquire );
+    // overwritten while copying?
+    if ( e.seq.load( std::memory_order_relaxed ) != idx + 1 || type >= EV_COUNT )
+      continue;
+
+    if ( base < 0 )
+      base = beginNs;
+    fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f"
+               ",\"args\":{\"frames\":%u"
+           , first ? "" : ",\n", Names[type], tid
+           , ( beginNs - base ) * 1E-3, ( endNs - beginNs ) * 1E-3, frames);
+    if ( adcAgeNs >= 0 )
+      fprintf(fp, ",\"adc_age_us\":%.3f", adcAgeNs * 1E-3);
+    fprintf(fp, "}}");
+    first = false;
+  }
+  fprintf(fp, "\n]}\n");
+
+  if ( ferror( fp ) )
+  {
+    fclose( fp );
+    if ( errstream )
+      fprintf(errstream, "Error: could not write trace file '%s'\n", filename);
+    return false;
+  }
+  fclose( fp );
+  return true;
+}
+
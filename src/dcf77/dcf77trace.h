@@ -0,0 +1,89 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77TRACE_H_
+#define _U775_DCF77TRACE_H_
+
+#include <stdio.h>
+#include <atomic>
+
+// Low overhead trace of the capture hot path.
+//
+// Events go into a ring of fixed size, which is allocated in init(), so
+// add() never allocates, locks or blocks and may be called from the audio
+// callback and other threads at the same time. Older events get overwritten.
+// Tracing is switched on and off at runtime with Enabled.
+// dump() writes the ring as Chrome trace event JSON, which is also read by
+// the Perfetto UI (ui.perfetto.dev) and chrome://tracing.
+
+class DCF77Trace
+{
+public:
+  DCF77Trace();
+  ~DCF77Trace();
+
+  typedef enum
+  {
+      EV_CALLBACK = 0   /// whole capture callback
+    , EV_NEWDATA        /// DCF77::newData()
+    , EV_PRN            /// DCF77PRN::newData()
+    , EV_RECORD         /// DCF77Recorder::pushBuffer()
+    , EV_EVAL           /// evaluation of minute in main loop
+    , EV_SETTIME        /// setting system time
+    , EV_COUNT
+  }
+    EventType;
+
+  // allocate ring for capacity events (rounded up to power of 2)
+  bool init( unsigned capacity );
+
+  // monotonic clock in ns
+  static long long now();
+
+  // adcAgeNs: time from ADC timestamp of buffer to begin; < 0 if unknown
+  void add( EventType type, unsigned tid, long long beginNs, long long endNs
+          , unsigned frames, long long adcAgeNs );
+
+  // write events in ring as JSON; safe while add() is called
+  bool dump( const char * filename, FILE * errstream ) const;
+
+  std::atomic<bool>   Enabled;
+
+private:
+  struct Event
+  {
+    std::atomic<unsigned long long> seq;  // index + 1 when complete
+    long long   beginNs;
+    long long   endNs;
+    long long   adcAgeNs;
+    unsigned    frames;
+    unsigned short type;
+    unsigned short tid;
+  };
+
+  Event *             Ring;
+  unsigned            Mask;
+  std::atomic<unsigned long long> Next;
+};
+
+#endif /* _U775_DCF77TRACE_H_ */
+
@@ -0,0 +1,314 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dcf77trellis.h"
+
+#include <math.h>
+#include <string.h>
+
+#define NEG_INF   -1E30F
+
+// parity fields: seconds and required parity of the field with its parity
+// bit. bits 17 / 18 (MESZ / MEZ) are a field of odd parity
+static const int FieldFirst[]  = { 17, 21, 29, 36 };
+static const int FieldLast[]   = { 18, 28, 35, 58 };
+static const int FieldParity[] = {  1,  0,  0,  0 };
+
+static int fieldOf( int sec )
+{
+  int f;
+  for ( f = 0; f < 4; ++f )
+    if ( sec >= FieldFirst[f] && sec <= FieldLast[f] )
+      return f;
+  return -1;
+}
+
+
+DCF77Trellis::DCF77Trellis()
+{
+  TolMs = 30.0F;
+  MinMargin = 3.0F;
+  reset();
+}
+
+
+void DCF77Trellis::reset()
+{
+  Locked = false;
+  MinuteReady = false;
+  MinEdgeFrame = -1;
+  ValueMaskLo = ValidMaskLo = 0;
+  ValueMaskHi = ValidMaskHi = 0;
+  RecoveredBits = 0;
+  Margin = 0.0F;
+  SlotStart = 0.0;
+  Period = 0.0;
+  Mismatches = 0;
+  Slots = 0;
+  EdgeCount = 0;
+  memset( Back, 0, sizeof(Back) );
+  memset( Observed, 0, sizeof(Observed) );
+}
+
+
+// start a new grid at second mark frame: any alignment
+void DCF77Trellis::lock( long long frame )
+{
+  int st;
+
+  Locked = true;
+  SlotStart = (double)frame;
+  Mismatches = 0;
+  Slots = 0;
+  for ( st = 0; st < NUM_STATES; ++st )
+  {
+    // odd running parity only inside a field, before its parity bit
+    const int sec = st >> 1;
+    const int f = fieldOf( sec );
+    Metric[st] = ( !( st & 1 ) || ( f >= 0 && sec != FieldLast[f] ) ) ? 0.0F : NEG_INF;
+  }
+}
+
+
+void DCF77Trellis::addEdge( long long frame, bool rising )
+{
+  if ( MAX_EDGES == EdgeCount )
+  {
+    memmove( EdgeFrame, EdgeFrame + 1, ( MAX_EDGES - 1 ) * sizeof(EdgeFrame[0]) );
+    memmove( EdgeRising, EdgeRising + 1, ( MAX_EDGES - 1 ) * sizeof(EdgeRising[0]) );
+    --EdgeCount;
+  }
+  EdgeFrame[EdgeCount] = frame;
+  EdgeRising[EdgeCount] = rising;
+  ++EdgeCount;
+}
+
+
+void DCF77Trellis::secondMark( long long frame )
+{
+  if ( !Locked || Period <= 0.0 )
+  {
+    lock( frame );
+    return;
+  }
+  // follow the phase of marks on the grid. marks off the grid in a row:
+  // the edge decoder synced to another grid
+  const double d = frame - SlotStart;
+  const double err = d - floor( d / Period + 0.5 ) * Period;
+  if ( fabs( err ) < TolMs * 1E-3 * Period )
+  {
+    SlotStart += err;
+    Mismatches = 0;
+  }
+  else if ( ++Mismatches >= 3 )
+    lock( frame );
+}
+
+
+void DCF77Trellis::advance( long long frame, double frameRate, float offsetMs, const float sigmaMs[2] )
+{
+  Period = frameRate;
+  if ( !Locked )
+    return;
+  // slot is complete, when the next second mark is past
+  const double tol = TolMs * 1E-3 * Period;
+  while ( frame >= SlotStart + Period + tol )
+  {
+    closeSlot( frameRate, offsetMs, sigmaMs );
+    SlotStart += Period;
+  }
+}
+
+
+void DCF77Trellis::closeSlot( double frameRate, float offsetMs, const float sigmaMs[2] )
+{
+  const double msPerFrame = 1000.0 / frameRate;
+  float pulse[2] = { NEG_INF, NEG_INF };
+  bool start = false;
+  bool any = false;
+  unsigned e, b;
+
+  // observations: rising edge at the second mark, pulse end 30 .. 400 ms
+  // later. log likelihood of the best fitting end edge for each bit
+  for ( e = 0; e < EdgeCount; ++e )
+  {
+    const float ms = (float)( ( EdgeFrame[e] - SlotStart ) * msPerFrame );
+    if ( EdgeRising[e] && fabsf( ms ) <= TolMs )
+      start = true;
+    else if ( ms >= 30.0F && ms < 400.0F )
+    {
+      any = true;
+      for ( b = 0; b < 2; ++b )
+      {
+        const float sigma = ( sigmaMs[b] > 3.0F ) ? sigmaMs[b] : 3.0F;
+        const float z = ( ms - ( 100.0F * ( b + 1 ) + offsetMs ) ) / sigma;
+        if ( -0.5F * z * z > pulse[b] )
+          pulse[b] = -0.5F * z * z;
+      }
+    }
+  }
+  // drop edges of this slot; keep those of the next second mark
+  const double keep = SlotStart + frameRate - TolMs * 1E-3 * frameRate;
+  for ( e = 0; e < EdgeCount && EdgeFrame[e] < keep; ++e )
+    ;
+  if ( e )
+  {
+    memmove( EdgeFrame, EdgeFrame + e, ( EdgeCount - e ) * sizeof(EdgeFrame[0]) );
+    memmove( EdgeRising, EdgeRising + e, ( EdgeCount - e ) * sizeof(EdgeRising[0]) );
+    EdgeCount -= e;
+  }
+
+  // emissions: missing pulse or second mark ~ 5 % / 10 %, spurious pulse
+  // in second 59 ~ 5 %. worst bit fit as bad as a missing pulse
+  float emitBit[2];
+  for ( b = 0; b < 2; ++b )
+  {
+    emitBit[b] = any ? ( pulse[b] > -8.0F ? pulse[b] : -8.0F ) : -3.0F;
+    if ( !start )
+      emitBit[b] -= 2.3F;
+  }
+  const float emitNone = ( start || any ) ? -3.0F : 0.0F;
+
+  // Viterbi step
+  float next[NUM_STATES];
+  unsigned char * back = Back[ Slots % HISTORY ];
+  int st;
+  for ( st = 0; st < NUM_STATES; ++st )
+    next[st] = NEG_INF;
+  for ( st = 0; st < NUM_STATES; ++st )
+  {
+    if ( Metric[st] <= 0.5F * NEG_INF )
+      continue;
+    const int p = st & 1;
+    const int sec = ( ( st >> 1 ) + 1 ) % 60;
+    if ( 59 == sec )
+    {
+      if ( Metric[st] + emitNone > next[59 << 1] )
+      {
+        next[59 << 1] = Metric[st] + emitNone;
+        back[59 << 1] = (unsigned char)p;
+      }
+      continue;
+    }
+    const int f = fieldOf( sec );
+    for ( b = 0; b < 2; ++b )
+    {
+      if ( ( 0 == sec && b ) || ( 20 == sec && !b ) )
+        continue;
+      int p2 = 0;
+      if ( f >= 0 )
+      {
+        p2 = ( sec == FieldFirst[f] ) ? (int)b : ( p ^ (int)b );
+        if ( sec == FieldLast[f] )
+        {
+          if ( p2 != FieldParity[f] )
+            continue;
+          p2 = 0;
+        }
+      }
+      const int st2 = ( sec << 1 ) | p2;
+      if ( Metric[st] + emitBit[b] > next[st2] )
+      {
+        next[st2] = Metric[st] + emitBit[b];
+        back[st2] = (unsigned char)( p | ( b << 1 ) );
+      }
+    }
+  }
+
+  // normalize to best state == 0
+  int best = 0;
+  for ( st = 1; st < NUM_STATES; ++st )
+    if ( next[st] > next[best] )
+      best = st;
+  const float norm = next[best];
+  float other = NEG_INF;    // best state of another alignment
+  for ( st = 0; st < NUM_STATES; ++st )
+  {
+    Metric[st] = ( next[st] > 0.5F * NEG_INF ) ? next[st] - norm : NEG_INF;
+    if ( ( st >> 1 ) != ( best >> 1 ) && Metric[st] > other )
+      other = Metric[st];
+  }
+  Observed[ Slots % HISTORY ] = any && fabsf( emitBit[0] - emitBit[1] ) > 2.0F;
+  ++Slots;
+
+  // end of minute, if clearly the most likely alignment
+  if ( 59 == ( best >> 1 ) && Slots >= 60 )
+  {
+    Margin = -other;
+    if ( Margin >= MinMargin )
+      decodeMinute();
+  }
+}
+
+
+// bits of seconds 0 .. 58 by traceback from second 59 in last closed slot
+void DCF77Trellis::decodeMinute()
+{
+  int bits[59];
+  bool observed[59];
+  long long j = Slots - 1;
+  int st = ( 58 << 1 ) | ( Back[ j % HISTORY ][59 << 1] & 1 );
+  int sec, f;
+
+  for ( sec = 58, --j; sec >= 0; --sec, --j )
+  {
+    const unsigned char back = Back[ j % HISTORY ][st];
+    bits[sec] = back >> 1;
+    observed[sec] = Observed[ j % HISTORY ];
+    if ( sec )
+      st = ( ( sec - 1 ) << 1 ) | ( back & 1 );
+  }
+
+  // valid: observed, fixed by the frame structure, or the only unobserved
+  // bit of a parity field
+  int unobserved[4] = { 0, 0, 0, 0 };
+  for ( sec = 0; sec < 59; ++sec )
+    if ( !observed[sec] && ( f = fieldOf( sec ) ) >= 0 )
+      ++unobserved[f];
+
+  ValueMaskLo = ValidMaskLo = 0;
+  ValueMaskHi = ValidMaskHi = 0;
+  RecoveredBits = 0;
+  for ( sec = 0; sec < 59; ++sec )
+  {
+    f = fieldOf( sec );
+    int valid = ( observed[sec] || 0 == sec || 20 == sec ) ? 1 : 0;
+    if ( !valid && f >= 0 && 1 == unobserved[f] )
+    {
+      valid = 1;
+      ++RecoveredBits;
+    }
+    if ( sec <= 28 )
+    {
+      ValueMaskLo |= bits[sec] << sec;
+      ValidMaskLo |= valid << sec;
+    }
+    else
+    {
+      ValueMaskHi |= bits[sec] << ( sec - 29 );
+      ValidMaskHi |= valid << ( sec - 29 );
+    }
+  }
+  MinEdgeFrame = (long long)floor( SlotStart + Period + 0.5 );
+  MinuteReady = true;
+}
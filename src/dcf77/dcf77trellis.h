@@ -0,0 +1,90 @@
+
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _U775_DCF77TRELLIS_H_
+#define _U775_DCF77TRELLIS_H_
+
+// Trellis decoding of the second grid and the bit stream.
+//
+// Edges are observations of one second slot each on a grid of second
+// marks. The hidden state of a slot is its second in the minute and the
+// running parity of the current parity field. A Viterbi search over the
+// 60 second frame (bit 0 == 0, bit 20 == 1, bits 17 / 18 differ, even
+// parity of minute, hour and date, no pulse in second 59) finds the
+// minute alignment and the most likely bits. A noisy or missing edge
+// costs some likelihood instead of a resync; a single missing bit of a
+// parity field gets recovered from its parity.
+//
+// The grid follows the second marks of the edge decoder (secondMark())
+// and keeps running on the sample clock while they are missing.
+
+class DCF77Trellis
+{
+public:
+  DCF77Trellis();
+
+  enum { NUM_STATES = 120, HISTORY = 64, MAX_EDGES = 64 };
+
+  float       TolMs;          // of second marks against the grid
+  float       MinMargin;      // log likelihood of minute alignment against others
+
+  void reset();
+  // every edge of the comparator, in order
+  void addEdge( long long frame, bool rising );
+  // second mark of the edge decoder
+  void secondMark( long long frame );
+  // close all slots, that ended before frame. pulse model from the edge
+  // decoder: widths 100 / 200 ms + offsetMs with sigmas
+  void advance( long long frame, double frameRate, float offsetMs, const float sigmaMs[2] );
+
+  bool        Locked;
+  // result: set by advance() at the end of second 59, reset by consumer
+  bool        MinuteReady;
+  long long   MinEdgeFrame;   // grid frame of minute mark
+  int         ValueMaskLo;    // DCF bits 28 .. 0
+  int         ValidMaskLo;
+  int         ValueMaskHi;    // DCF bits 58 .. 29
+  int         ValidMaskHi;
+  unsigned    RecoveredBits;  // by parity, in last minute
+  float       Margin;         // of last minute alignment
+
+private:
+  void lock( long long frame );
+  void closeSlot( double frameRate, float offsetMs, const float sigmaMs[2] );
+  void decodeMinute();
+
+  double      SlotStart;      // frame of second mark of open slot
+  double      Period;         // frames per second
+  unsigned    Mismatches;     // second marks off the grid in a row
+  long long   Slots;          // closed since lock
+
+  long long   EdgeFrame[MAX_EDGES];
+  bool        EdgeRising[MAX_EDGES];
+  unsigned    EdgeCount;
+
+  float       Metric[NUM_STATES];
+  // per closed slot: predecessor parity (bit 0), bit (bit 1) of each state
+  unsigned char Back[HISTORY][NUM_STATES];
+  bool        Observed[HISTORY];  // pulse seen, bit decided by observation
+};
+
+#endif /* _U775_DCF77TRELLIS_H_ */
@@ -0,0 +1,167 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <string>
+
+#include "../dcf77/dcf77.h"
+#include "../dcf77/dcf77net.h"
+
+
+// aggregator of receiver hosts, which run dcf77-settime 'net <host:port>'
+// or dcf77-decode --net <host:port>. voted minutes and fleet health go to
+// stdout as one JSON object per line, e.g. for a local test (the loops
+// each on one line):
+//   dcf77-aggregate --idle-exit 5 &
+//   for i in 1 2 3; do dcf77-synth --seed $i --dropout 0.04 $i.wav; done
+//   for i in 1 2 3; do tail -c +45 $i.wav | dcf77-decode --format f32
+//     --trellis --epoch 1199999999.5 --net 127.0.0.1:7775 --id $i > /dev/null & done
+
+static volatile sig_atomic_t Quit = 0;
+
+static void onQuit( int )
+{
+  Quit = 1;
+}
+
+
+static long long nowNs()
+{
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return (long long)tv.tv_sec * 1000000000LL + (long long)tv.tv_usec * 1000LL;
+}
+
+
+static void onVote( const DCF77NetVote & v, void * )
+{
+  fprintf(stdout, "{\"type\":\"vote\",\"edge\":%.3f,\"ok\":%s", 1E-9 * v.EdgeTimeNs
+         , v.UtcMinute >= 0 ? "true" : "false" );
+  if ( v.UtcMinute >= 0 )
+    fprintf(stdout, ",\"utc\":%lld", v.UtcMinute );
+  else
+    fprintf(stdout, ",\"error\":\"%s\"", DCF77::evalErrorText( v.ErrorCode ) );
+  fprintf(stdout, ",\"reports\":%u,\"reports_ok\":%u,\"recovered\":%u,\"misaligned\":%u,\"disputed\":%u"
+                  ",\"value\":\"%015llx\",\"valid\":\"%015llx\"}\n"
+         , v.Reports, v.ReportsOk, v.Recovered, v.Misaligned, v.Disputed, v.ValueMask, v.ValidMask );
+  fflush(stdout);
+}
+
+
+static void writeStatus( const DCF77NetAggregator & agg, const char * filename, long long now )
+{
+  const std::string tmp = std::string( filename ) + ".tmp";
+  FILE * fp = fopen( tmp.c_str(), "w" );
+  if ( !fp )
+  {
+    fprintf(stderr, "Error: could not write '%s'\n", tmp.c_str());
+    return;
+  }
+  agg.health( fp, now );
+  if ( fclose( fp ) || rename( tmp.c_str(), filename ) )
+    fprintf(stderr, "Error: could not write '%s'\n", filename);
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  const char * Listen = "7775";
+  const char * StatusName = NULL;
+  double HealthSec = 60.0;
+  double IdleExitSec = 0.0;
+  DCF77NetAggregator agg;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [--listen [<host>:]<port>] [--linger <sec>] [--timeout <sec>]\n"
+             "    [--health <sec>] [--status <file>] [--idle-exit <sec>]\n\n", argv[0]);
+      printf("  --listen: UDP port of receiver events. default: %s\n", Listen);
+      printf("  --linger: vote a minute latest after <sec>. default: 45\n");
+      printf("  --timeout: host inactive without events for <sec>. default: 120\n");
+      printf("  --health: print fleet health every <sec>. default: 60\n");
+      printf("  --status <file>: keep latest fleet health in <file>\n");
+      printf("  --idle-exit: vote all and exit after <sec> without events\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--listen") && argno +1 < argc )
+      Listen = argv[++argno];
+    else if ( !strcmp(argv[argno], "--linger") && argno +1 < argc )
+      agg.LingerNs = (long long)( 1E9 * atof(argv[++argno]) );
+    else if ( !strcmp(argv[argno], "--timeout") && argno +1 < argc )
+      agg.HostTimeoutNs = (long long)( 1E9 * atof(argv[++argno]) );
+    else if ( !strcmp(argv[argno], "--health") && argno +1 < argc )
+      HealthSec = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--status") && argno +1 < argc )
+      StatusName = argv[++argno];
+    else if ( !strcmp(argv[argno], "--idle-exit") && argno +1 < argc )
+      IdleExitSec = atof(argv[++argno]);
+    else
+    {
+      fprintf(stderr, "Error: unknown option '%s'. see --help\n", argv[argno]);
+      return 1;
+    }
+  }
+
+  if ( !agg.open( Listen, stderr ) )
+    return 1;
+  signal( SIGINT, onQuit );
+  signal( SIGTERM, onQuit );
+
+  long long lastEvent = nowNs();
+  long long lastHealth = lastEvent;
+  while ( !Quit )
+  {
+    struct pollfd pfd;
+    pfd.fd = agg.fd();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    poll( &pfd, 1, 1000 );
+
+    const long long now = nowNs();
+    if ( agg.receive( now ) )
+      lastEvent = now;
+    const bool idle = ( IdleExitSec > 0.0 && now - lastEvent >= (long long)( 1E9 * IdleExitSec ) );
+    agg.flush( now, idle, onVote, NULL );
+
+    if ( now - lastHealth >= (long long)( 1E9 * HealthSec ) || idle )
+    {
+      lastHealth = now;
+      agg.health( stdout, now );
+      fflush(stdout);
+      if ( StatusName )
+        writeStatus( agg, StatusName, now );
+    }
+    if ( idle )
+      break;
+  }
+  if ( Quit )
+    agg.flush( nowNs(), true, onVote, NULL );
+  return 0;
+}
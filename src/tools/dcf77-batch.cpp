@@ -0,0 +1,355 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../dcf77/dcf77.h"
+#include "../dcf77/dcf77file.h"
+#include "../dcf77/dcf77rec.h"
+
+
+// Batch decoder for archived captures.
+// The file is split into chunks of ChunkSec seconds. Each chunk is decoded
+// by an own DCF77 instance, starting OverlapSec earlier in STATE_GET_THRESH,
+// so that it is synchronized when its own range begins. A minute belongs to
+// the chunk, whose own range contains the minute edge: the merged result
+// is independent of the number of threads and their scheduling.
+
+struct MinuteResult
+{
+  long long   edgeFrame;
+  double      adcTime;    // only for U775REC files
+  bool        ok;
+  struct tm   tms;
+  int         tzIdx;
+};
+
+struct BatchJob
+{
+  const char *  filename;
+  bool          isRec;
+  DCF77CaptureFile  capture;    // shared, read only
+  double        SampleRate;
+  unsigned      ChanCount;
+  unsigned      ChanIdx;
+  long long     FrameCount;
+  long long     ChunkFrames;
+  long long     OverlapFrames;
+
+  std::atomic<int>  NextChunk;
+  std::vector< std::vector<MinuteResult> > Results;
+};
+
+
+// ADC time of a stored frame of a U775REC file: from the buffer containing
+// it, so that lost buffers before don't shift it. bufs sorted by frame
+static double recAdcTime( const std::vector<DCF77RecReader::BufferInfo> & bufs
+                        , long long frame, double sampleRate )
+{
+  size_t lo = 0, hi = bufs.size();
+  if ( bufs.empty() )
+    return 0.0;
+  // last buffer starting at or before frame
+  while ( hi - lo > 1 )
+  {
+    const size_t mid = ( lo + hi ) / 2;
+    if ( bufs[mid].frame <= frame )
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return bufs[lo].adcTime + ( frame - bufs[lo].frame ) / sampleRate;
+}
+
+
+// bufs: buffer records of a U775REC file, NULL: ADC time from adcBase
+static void collectMinute( DCF77 & dcf, long long chunkStart, long long ownStart
+                         , double adcBase, const std::vector<DCF77RecReader::BufferInfo> * bufs
+                         , std::vector<MinuteResult> & out )
+{
+  MinuteResult r;
+
+  if ( dcf.EvaluatedMinPulse )
+    return;
+  dcf.EvaluatedMinPulse = true;
+
+  r.edgeFrame = chunkStart + dcf.MinEdgeFrame;
+  if ( r.edgeFrame < ownStart )
+    return;   // belongs to previous chunk
+  if ( bufs )
+    r.adcTime = recAdcTime( *bufs, r.edgeFrame, dcf.frameRate() );
+  else
+    r.adcTime = adcBase + ( r.edgeFrame - chunkStart ) / dcf.frameRate();
+  memset( &r.tms, 0, sizeof(r.tms) );
+  r.tzIdx = 0;
+  r.ok = dcf.evalMinPulse( &r.tms, &r.tzIdx, NULL );
+  out.push_back( r );
+}
+
+
+static void decodeCapture( BatchJob & job, int k )
+{
+  const long long ownStart = k * job.ChunkFrames;
+  const long long start = ( ownStart > job.OverlapFrames ) ? ownStart - job.OverlapFrames : 0;
+  long long end = ownStart + job.ChunkFrames;
+  DCF77 dcf;
+  long long frame;
+
+  if ( end > job.FrameCount )
+    end = job.FrameCount;
+
+  dcf.SampleRate = job.SampleRate;
+  dcf.ChanCount = job.ChanCount;
+  dcf.ChanIdx = job.ChanIdx;
+  dcf.FramesPerBuffer = (unsigned)( job.SampleRate / 100.0 );
+  dcf.initGetThreshold();
+
+  std::vector<float> conv( dcf.FramesPerBuffer * job.ChanCount );
+  for ( frame = start; frame < end; frame += dcf.FramesPerBuffer )
+  {
+    const unsigned n = (unsigned)( ( end - frame < dcf.FramesPerBuffer ) ? end - frame : dcf.FramesPerBuffer );
+    const float * p = job.capture.floatData( frame );
+    if ( !p )
+    {
+      job.capture.readFloat( frame, n, &conv[0] );
+      p = &conv[0];
+    }
+    dcf.newData( n, p );
+    collectMinute( dcf, start, ownStart, start / job.SampleRate, NULL, job.Results[k] );
+  }
+}
+
+
+static void decodeRec( BatchJob & job, DCF77RecReader & rd, int k )
+{
+  const long long ownStart = k * job.ChunkFrames;
+  const long long start = ( ownStart > job.OverlapFrames ) ? ownStart - job.OverlapFrames : 0;
+  const long long end = ownStart + job.ChunkFrames;
+  std::vector<float> samples;
+  std::vector<DCF77RecReader::BufferInfo> bufs, seen;
+  std::vector<long long> gaps;
+  DCF77 dcf;
+  int c = rd.findChunk( start );
+  size_t b;
+
+  if ( c < 0 )
+    return;
+
+  dcf.SampleRate = job.SampleRate;
+  dcf.ChanCount = job.ChanCount;
+  dcf.ChanIdx = job.ChanIdx;
+  dcf.FramesPerBuffer = (unsigned)( job.SampleRate / 100.0 );
+  dcf.initGetThreshold();
+
+  for ( ; c < (int)rd.Chunks.size() && rd.Chunks[c].frame < end; ++c )
+  {
+    if ( !rd.readChunk( c, samples, bufs, stderr ) )
+      break;
+    const long long chunkFrame = rd.Chunks[c].frame;
+    const long long frames = samples.size() / job.ChanCount;
+    long long i = ( start > chunkFrame ) ? start - chunkFrame : 0;
+    seen.insert( seen.end(), bufs.begin(), bufs.end() );
+    // input or ring overflow: samples got lost before these buffers
+    gaps.clear();
+    for ( b = 0; b < bufs.size(); ++b )
+      if ( bufs[b].flags & ( DCF77Recorder::FLAG_INPUT_OVERFLOW | DCF77Recorder::FLAG_RING_OVERFLOW ) )
+        gaps.push_back( bufs[b].frame );
+    b = 0;
+    while ( i < frames && chunkFrame + i < end )
+    {
+      const long long frame = chunkFrame + i;
+      long long n = frames - i;
+      if ( n > dcf.FramesPerBuffer )
+        n = dcf.FramesPerBuffer;
+      if ( frame + n > end )
+        n = end - frame;
+      // restart at a gap instead of decoding across it
+      while ( b < gaps.size() && gaps[b] < frame )
+        ++b;
+      if ( b < gaps.size() && gaps[b] == frame )
+      {
+        if ( frame > start )
+          dcf.initGetThreshold();
+        ++b;
+      }
+      if ( b < gaps.size() && gaps[b] < frame + n )
+        n = gaps[b] - frame;
+      dcf.newData( (unsigned)n, &samples[ i * job.ChanCount ] );
+      collectMinute( dcf, start, ownStart, 0.0, &seen, job.Results[k] );
+      i += n;
+    }
+  }
+}
+
+
+static void worker( BatchJob * job )
+{
+  DCF77RecReader rd;
+  int k;
+
+  if ( job->isRec && !rd.open( job->filename, NULL ) )
+    return;
+
+  while ( ( k = job->NextChunk++ ) < (int)job->Results.size() )
+  {
+    if ( job->isRec )
+      decodeRec( *job, rd, k );
+    else
+      decodeCapture( *job, k );
+  }
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  unsigned i, NumThreads = std::thread::hardware_concurrency();
+  double ChunkSec = 300.0;
+  double OverlapSec = 150.0;
+  BatchJob job;
+  const char * TZStrTab[] = { "Err", "MESZ", "MEZ", "Err" };
+
+  job.filename = NULL;
+  job.ChanIdx = 0;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [--threads <n>] [--chunk <sec>] [--overlap <sec>] [--chan <idx>]\n"
+             "    [--raw s16|f32 <samplerate> <channels>] <capture file>\n\n", argv[0]);
+      printf("decodes WAV (int16/float32), raw PCM or U775REC recordings in parallel\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--threads") && argno +1 < argc )
+      NumThreads = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--chunk") && argno +1 < argc )
+      ChunkSec = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--overlap") && argno +1 < argc )
+      OverlapSec = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--chan") && argno +1 < argc )
+      job.ChanIdx = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--raw") && argno +3 < argc )
+    {
+      job.capture.SampleFormat = strcmp(argv[++argno], "s16") ? DCF77CaptureFile::FMT_FLOAT32 : DCF77CaptureFile::FMT_INT16;
+      job.capture.SampleRate = atof(argv[++argno]);
+      job.capture.ChanCount = (unsigned)atoi(argv[++argno]);
+    }
+    else
+      job.filename = argv[argno];
+  }
+
+  if ( !job.filename )
+  {
+    fprintf(stderr, "Error: no capture file given. see --help\n");
+    return 1;
+  }
+  if ( NumThreads < 1 )
+    NumThreads = 1;
+
+  {
+    DCF77RecReader rd;
+    FILE * f = fopen( job.filename, "rb" );
+    char magic[8];
+    job.isRec = ( f && 1 == fread( magic, 8, 1, f ) && !memcmp( magic, "U775REC1", 8 ) );
+    if ( f )
+      fclose( f );
+
+    if ( job.isRec )
+    {
+      if ( !rd.open( job.filename, stderr ) )
+        return 1;
+      job.SampleRate = rd.SampleRate;
+      job.ChanCount = rd.ChanCount;
+      job.FrameCount = rd.FrameCount;
+    }
+    else
+    {
+      if ( !job.capture.open( job.filename, stderr ) )
+        return 1;
+      job.SampleRate = job.capture.SampleRate;
+      job.ChanCount = job.capture.ChanCount;
+      job.FrameCount = job.capture.FrameCount;
+    }
+  }
+
+  if ( job.ChanIdx >= job.ChanCount )
+  {
+    fprintf(stderr, "Error: channel %u not in range 0 .. %u\n", job.ChanIdx, job.ChanCount -1);
+    return 1;
+  }
+
+  job.ChunkFrames = (long long)( ChunkSec * job.SampleRate );
+  job.OverlapFrames = (long long)( OverlapSec * job.SampleRate );
+  if ( job.ChunkFrames < 1 )
+    job.ChunkFrames = 1;
+  job.NextChunk = 0;
+  job.Results.resize( (size_t)( ( job.FrameCount + job.ChunkFrames - 1 ) / job.ChunkFrames ) );
+
+  fprintf(stderr, "%s: %f Hz, %u channels, %u chunks, %u threads\n"
+         , job.filename, job.SampleRate, job.ChanCount, (unsigned)job.Results.size(), NumThreads);
+
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for ( i = 0; i < NumThreads; ++i )
+    threads.push_back( std::thread( worker, &job ) );
+  for ( i = 0; i < NumThreads; ++i )
+    threads[i].join();
+  const double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+
+  // merge: chunks in order, minutes inside a chunk are in order
+  unsigned numOk = 0, numErr = 0;
+  for ( i = 0; i < job.Results.size(); ++i )
+  {
+    const std::vector<MinuteResult> & v = job.Results[i];
+    for ( size_t m = 0; m < v.size(); ++m )
+    {
+      const MinuteResult & r = v[m];
+      if ( r.ok )
+      {
+        ++numOk;
+        fprintf(stdout, "%12.3f s  Date: %04d-%02d-%02d  Time: %02d:%02d  %s\n"
+               , job.isRec ? r.adcTime : r.edgeFrame / job.SampleRate
+               , r.tms.tm_year + 1900, r.tms.tm_mon +1, r.tms.tm_mday
+               , r.tms.tm_hour, r.tms.tm_min, TZStrTab[r.tzIdx] );
+      }
+      else
+      {
+        ++numErr;
+        fprintf(stdout, "%12.3f s  Error: invalid minute\n"
+               , job.isRec ? r.adcTime : r.edgeFrame / job.SampleRate );
+      }
+    }
+  }
+
+  const double seconds = job.FrameCount / job.SampleRate;
+  fprintf(stderr, "%u minutes decoded, %u invalid. %.1f s audio in %.2f s (x %.0f realtime)\n"
+         , numOk, numErr, seconds, elapsed, elapsed > 0.0 ? seconds / elapsed : 0.0 );
+  return 0;
+}
+
@@ -0,0 +1,407 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "../dcf77/dcf77.h"
+#include "../dcf77/dcf77synth.h"
+#include "../dcf77-gst/src/dcf77core.h"
+
+
+// Micro benchmarks for the decoder hot paths:
+//   DCF77::newData() in STATE_GET_THRESH and STATE_GET_TIME, float32 and int16,
+//   DCF77::evalMinPulse() and dcf77_core_get_time() of the GStreamer element.
+// Prints ns, cycles and instructions per sample (per call for evalMinPulse)
+// and branch miss rate. Hardware counters need perf_event_open(), see
+// /proc/sys/kernel/perf_event_paranoid; without them only time is printed.
+
+class PerfCounters
+{
+public:
+  enum { CYCLES = 0, INSTRUCTIONS, BRANCHES, BRANCH_MISSES, NUM };
+
+  PerfCounters()
+  {
+    int i;
+    for ( i = 0; i < NUM; ++i )
+      fd[i] = -1;
+    Ok = false;
+#ifdef __linux__
+    static const unsigned long long cfg[NUM] =
+    { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS
+    , PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES };
+    for ( i = 0; i < NUM; ++i )
+    {
+      struct perf_event_attr attr;
+      memset( &attr, 0, sizeof(attr) );
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = cfg[i];
+      attr.disabled = ( 0 == i ) ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      fd[i] = (int)syscall( __NR_perf_event_open, &attr, 0, -1, ( 0 == i ) ? -1 : fd[0], 0 );
+      if ( fd[i] < 0 )
+        return;
+    }
+    Ok = true;
+#endif
+  }
+
+  ~PerfCounters()
+  {
+#ifdef __linux__
+    int i;
+    for ( i = 0; i < NUM; ++i )
+      if ( fd[i] >= 0 )
+        close( fd[i] );
+#endif
+  }
+
+  void start()
+  {
+#ifdef __linux__
+    if ( !Ok )
+      return;
+    ioctl( fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+#endif
+  }
+
+  void stop()
+  {
+    memset( Values, 0, sizeof(Values) );
+#ifdef __linux__
+    if ( !Ok )
+      return;
+    unsigned long long buf[1 + NUM];
+    ioctl( fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+    if ( read( fd[0], buf, sizeof(buf) ) == (ssize_t)sizeof(buf) && NUM == buf[0] )
+      memcpy( Values, buf + 1, sizeof(Values) );
+#endif
+  }
+
+  bool                Ok;
+  unsigned long long  Values[NUM];
+
+private:
+  int                 fd[NUM];
+};
+
+
+enum EdgeDensity { EDGES_NONE = 0, EDGES_DCF, EDGES_DENSE };
+static const char * DensityName[] = { "none", "dcf", "dense" };
+
+static PerfCounters * Perf = NULL;
+static double MinSeconds = 0.2;
+
+
+// input of 10 seconds: noise only, DCF77 signal or a 250 Hz square wave
+static void makeInput( double rate, unsigned chans, EdgeDensity density, std::vector<float> & out )
+{
+  DCF77Synth syn;
+  const unsigned frames = (unsigned)( 10.0 * rate );
+  unsigned i, c;
+
+  syn.SampleRate = rate;
+  syn.ChanCount = chans;
+  syn.ChanIdx = chans - 1;
+  syn.Amplitude = ( EDGES_NONE == density ) ? 0.0F : 0.8F;
+  syn.reset();
+  out.resize( (size_t)frames * chans );
+  syn.generate( frames, &out[0] );
+  if ( EDGES_DENSE == density )
+  {
+    const unsigned half = (unsigned)( rate / 500.0 );
+    for ( i = 0; i < frames; ++i )
+      for ( c = 0; c < chans; ++c )
+        out[(size_t)i * chans + c] += ( ( i / half ) & 1 ) ? 0.8F : 0.0F;
+  }
+}
+
+
+static void report( const char * name, double rate, unsigned chans, unsigned bufFrames
+                  , const char * density, double units, double ns )
+{
+  if ( rate > 0.0 )
+    fprintf(stdout, "%-12s %6.0f %2u %5u %-6s %9.3f", name, rate, chans, bufFrames, density, ns / units);
+  else
+    fprintf(stdout, "%-12s %6s %2s %5s %-6s %9.3f", name, "-", "-", "-", density, ns / units);
+  if ( Perf->Ok && Perf->Values[PerfCounters::CYCLES] )
+  {
+    const unsigned long long * v = Perf->Values;
+    fprintf(stdout, " %9.3f %9.3f %8.3f"
+           , v[PerfCounters::CYCLES] / units, v[PerfCounters::INSTRUCTIONS] / units
+           , v[PerfCounters::BRANCHES] ? 100.0 * v[PerfCounters::BRANCH_MISSES] / v[PerfCounters::BRANCHES] : 0.0);
+  }
+  else
+    fprintf(stdout, " %9s %9s %8s", "-", "-", "-");
+  fprintf(stdout, "\n");
+}
+
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedNs( const Clock::time_point & t0 )
+{
+  return std::chrono::duration<double, std::nano>( Clock::now() - t0 ).count();
+}
+
+
+static void benchNewData( DCF77::State state, double rate, unsigned chans, unsigned bufFrames, EdgeDensity density
+                        , bool int16 )
+{
+  std::vector<float> in;
+  std::vector<short> in16;
+  DCF77 dcf;
+  makeInput( rate, chans, density, in );
+  const unsigned frames = (unsigned)( in.size() / chans );
+  if ( int16 )
+  {
+    size_t i;
+    in16.resize( in.size() );
+    for ( i = 0; i < in.size(); ++i )
+    {
+      const float v = in[i] * 32768.0F;
+      in16[i] = (short)( v > 32767.0F ? 32767.0F : ( v < -32768.0F ? -32768.0F : v ) );
+    }
+  }
+  const unsigned numBufs = frames / bufFrames;
+  double units = 0.0, ns;
+  unsigned b;
+
+  dcf.SampleRate = rate;
+  dcf.ChanCount = chans;
+  dcf.ChanIdx = chans - 1;
+  dcf.Threshold = 0.5F;
+  dcf.ThresholdLow = 0.25F;
+  if ( DCF77::STATE_GET_TIME == state )
+    dcf.initGetTime();
+
+  Perf->start();
+  const Clock::time_point t0 = Clock::now();
+  do
+  {
+    for ( b = 0; b < numBufs; ++b )
+    {
+      if ( int16 )
+        dcf.newData( bufFrames, &in16[(size_t)b * bufFrames * chans] );
+      else
+        dcf.newData( bufFrames, &in[(size_t)b * bufFrames * chans] );
+      // stay in measured state
+      if ( dcf.eState != state )
+      {
+        if ( DCF77::STATE_GET_TIME == state )
+        {
+          dcf.Threshold = 0.5F;
+          dcf.ThresholdLow = 0.25F;
+          dcf.initGetTime();
+        }
+        else
+          dcf.initGetThreshold();
+      }
+      dcf.EvaluatedMinPulse = true;
+    }
+    units += (double)numBufs * bufFrames;
+    ns = elapsedNs( t0 );
+  } while ( ns < MinSeconds * 1E9 );
+  Perf->stop();
+
+  report( DCF77::STATE_GET_TIME == state ? ( int16 ? "s16-time" : "newData-time" )
+                                          : ( int16 ? "s16-thr" : "newData-thr" )
+        , rate, chans, bufFrames, DensityName[density], units, ns );
+}
+
+
+static void benchGstCore( unsigned bufFrames, EdgeDensity density )
+{
+  std::vector<float> in;
+  makeInput( 48000.0, 1, density, in );
+  std::vector<short> in16( in.size() );
+  const unsigned numBufs = (unsigned)( in.size() / bufFrames );
+  Dcf77Core core;
+  double units = 0.0, ns;
+  unsigned b;
+
+  for ( b = 0; b < in.size(); ++b )
+  {
+    const float v = in[b] * 32767.0F;
+    in16[b] = (short)( v > 32767.0F ? 32767 : ( v < -32768.0F ? -32768 : v ) );
+  }
+  dcf77_core_init_get_time( &core );
+  core.threshold = 16384;
+
+  Perf->start();
+  const Clock::time_point t0 = Clock::now();
+  do
+  {
+    for ( b = 0; b < numBufs; ++b )
+    {
+      if ( dcf77_core_get_time( &core, &in16[(size_t)b * bufFrames], (int)bufFrames ) & DCF77_CORE_RESYNC )
+      {
+        dcf77_core_init_get_time( &core );
+        core.threshold = 16384;
+      }
+    }
+    units += (double)numBufs * bufFrames;
+    ns = elapsedNs( t0 );
+  } while ( ns < MinSeconds * 1E9 );
+  Perf->stop();
+
+  report( "gst-core", 48000.0, 1, bufFrames, DensityName[density], units, ns );
+}
+
+
+static void benchEval()
+{
+  enum { NUM = 64 };
+  int masks[NUM][4];
+  int bits[60];
+  unsigned m, i;
+  DCF77 dcf;
+  struct tm tms;
+  int tz;
+  double units = 0.0, ns;
+  volatile int sink = 0;
+
+  // valid minutes, every 4th with a parity error
+  for ( m = 0; m < NUM; ++m )
+  {
+    DCF77Synth::encodeMinute( 1200000000LL + 3607LL * 60 * m, bits );
+    if ( 3 == ( m & 3 ) )
+      bits[30] ^= 1;
+    masks[m][0] = masks[m][2] = 0;
+    for ( i = 0; i < 29; ++i )
+      masks[m][0] |= bits[i] << i;
+    for ( i = 29; i < 59; ++i )
+      masks[m][2] |= bits[i] << ( i - 29 );
+    masks[m][1] = 0x1FFFFFFF;
+    masks[m][3] = 0x3FFFFFFF;
+  }
+
+  Perf->start();
+  const Clock::time_point t0 = Clock::now();
+  do
+  {
+    for ( i = 0; i < 4096; ++i )
+    {
+      m = i % NUM;
+      dcf.EvalValueMaskLo = masks[m][0];
+      dcf.EvalValidMaskLo = masks[m][1];
+      dcf.EvalValueMaskHi = masks[m][2];
+      dcf.EvalValidMaskHi = masks[m][3];
+      sink = sink + ( dcf.evalMinPulse( &tms, &tz, NULL ) ? 1 : 0 );
+    }
+    units += 4096.0;
+    ns = elapsedNs( t0 );
+  } while ( ns < MinSeconds * 1E9 );
+  Perf->stop();
+
+  report( "evalMinPulse", 0.0, 0, 0, "-", units, ns );
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  bool Quick = false;
+  const char * Only = NULL;
+  PerfCounters perf;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [--time <sec>] [--quick] [thr|time|s16|eval|gst]\n\n", argv[0]);
+      printf("  --time <sec>: minimum duration of each run. default 0.2\n");
+      printf("  --quick: only 48 kHz mono and one buffer size\n");
+      printf("  s16: newData() with int16 samples in both states\n");
+      printf("  units: per sample (frame) for newData and gst-core, per call for evalMinPulse\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--time") && argno +1 < argc )
+      MinSeconds = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--quick") )
+      Quick = true;
+    else
+      Only = argv[argno];
+  }
+
+  Perf = &perf;
+  if ( !perf.Ok )
+    fprintf(stderr, "no hardware counters (perf_event_open failed): printing time only\n");
+
+  static const double Rates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+  static const unsigned Chans[] = { 1, 2 };
+  static const unsigned Buffers[] = { 64, 480, 4096 };
+  const unsigned numRates = Quick ? 1 : sizeof(Rates) / sizeof(Rates[0]);
+  const unsigned numChans = Quick ? 1 : sizeof(Chans) / sizeof(Chans[0]);
+  const unsigned numBufs = Quick ? 1 : sizeof(Buffers) / sizeof(Buffers[0]);
+  unsigned r, c, b, d;
+
+  fprintf(stdout, "%-12s %6s %2s %5s %-6s %9s %9s %9s %8s\n"
+         , "bench", "rate", "ch", "buf", "edges", "ns", "cycles", "instr", "brmiss%");
+
+  for ( r = 0; r < numRates; ++r )
+    for ( c = 0; c < numChans; ++c )
+      for ( b = 0; b < numBufs; ++b )
+      {
+        const double rate = Quick ? 48000.0 : Rates[r];
+        const unsigned buf = Quick ? 480 : Buffers[b];
+        if ( !Only || !strcmp( Only, "thr" ) )
+          benchNewData( DCF77::STATE_GET_THRESH, rate, Chans[c], buf, EDGES_DCF, false );
+        if ( !Only || !strcmp( Only, "time" ) )
+          for ( d = EDGES_NONE; d <= EDGES_DENSE; ++d )
+            benchNewData( DCF77::STATE_GET_TIME, rate, Chans[c], buf, (EdgeDensity)d, false );
+        if ( !Only || !strcmp( Only, "s16" ) )
+        {
+          benchNewData( DCF77::STATE_GET_THRESH, rate, Chans[c], buf, EDGES_DCF, true );
+          for ( d = EDGES_NONE; d <= EDGES_DENSE; ++d )
+            benchNewData( DCF77::STATE_GET_TIME, rate, Chans[c], buf, (EdgeDensity)d, true );
+        }
+      }
+
+  if ( !Only || !strcmp( Only, "eval" ) )
+    benchEval();
+
+  // the element is fixed to 48 kHz mono 16 bit
+  if ( !Only || !strcmp( Only, "gst" ) )
+    for ( b = 0; b < numBufs; ++b )
+      for ( d = EDGES_NONE; d <= EDGES_DENSE; ++d )
+        benchGstCore( Quick ? 480 : Buffers[b], (EdgeDensity)d );
+
+  return 0;
+}
+
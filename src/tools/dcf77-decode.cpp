@@ -0,0 +1,406 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <vector>
+#include <sys/time.h>
+
+#ifdef _MSC_VER
+#include <io.h>
+#define read    _read
+#define open    _open
+#define close   _close
+#define O_RDONLY  _O_RDONLY
+#else
+#include <unistd.h>
+#endif
+
+#include "../dcf77/dcf77.h"
+#include "../dcf77/dcf77log.h"
+#include "../dcf77/dcf77multi.h"
+#include "../dcf77/dcf77net.h"
+
+
+// Decoder as filter: raw PCM from stdin or a FIFO, line delimited JSON to
+// stdout. e.g.
+//   arecord -t raw -f S16_LE -r 48000 -c 2 | dcf77-decode --format s16 --rate 48000 --chans 2
+// Input is read in large blocks straight into the sample buffer and
+// decoded from there in its own format, without any copy or conversion.
+// With --net, events also go to dcf77-aggregate, stamped with the input
+// position after --epoch: replays of recordings act as receiver hosts.
+// With --all-chans, every channel is decoded as an own stream (DCF77Multi),
+// e.g. a farm of receivers recorded side by side; events get a "chan".
+
+typedef enum { FMT_S16, FMT_S32, FMT_F32 } SampleFormat;
+
+
+// read until full or end of input. returns bytes read
+static size_t readBlock( int fd, void * buf, size_t bytes )
+{
+  unsigned char * p = (unsigned char *)buf;
+  size_t n = 0;
+  while ( n < bytes )
+  {
+    const int k = (int)read( fd, p + n, (unsigned)( bytes - n ) );
+    if ( k < 0 && EINTR == errno )
+      continue;
+    if ( k <= 0 )
+      break;
+    n += (size_t)k;
+  }
+  return n;
+}
+
+
+// "{"type":<type>[,"chan":<chan>]" of an event. chan < 0: single stream
+static void printType( const char * type, int chan )
+{
+  fprintf(stdout, "{\"type\":\"%s\"", type);
+  if ( chan >= 0 )
+    fprintf(stdout, ",\"chan\":%d", chan);
+}
+
+
+static void printSecond( const DCF77 & dcf, long long secEdge, int chan )
+{
+  const long long minEdge = dcf.MinEdgeFrame;
+  const int sec = ( minEdge >= 0 && secEdge >= minEdge )
+                ? (int)( ( secEdge - minEdge ) / dcf.frameRate() + 0.5 ) : -1;
+  printType( "second", chan );
+  fprintf(stdout, ",\"frame\":%lld,\"time\":%.6f,\"sec\":%d,\"bit\":%d}\n"
+         , secEdge, secEdge / dcf.frameRate(), sec, dcf.LastBit );
+}
+
+
+// host clock (UTC) of an input frame
+static long long frameTimeNs( const DCF77 & dcf, double epoch, long long frame )
+{
+  return (long long)( 1E9 * ( epoch + frame / dcf.frameRate() ) );
+}
+
+
+static bool printMinute( DCF77 & dcf, DCF77NetSender & net, double epoch, int chan )
+{
+  const char * TZStrTab[] = { "Err", "MESZ", "MEZ", "Err" };
+  const long long edge = dcf.MinEdgeFrame;
+  struct tm tms;
+  int tzIdx = 0;
+
+  memset( &tms, 0, sizeof(tms) );
+  const bool ok = dcf.evalMinPulse( &tms, &tzIdx, NULL );
+  const unsigned long long value = ( (unsigned long long)(unsigned)dcf.EvalValueMaskHi << 29 ) | (unsigned)dcf.EvalValueMaskLo;
+  const unsigned long long valid = ( (unsigned long long)(unsigned)dcf.EvalValidMaskHi << 29 ) | (unsigned)dcf.EvalValidMaskLo;
+
+  printType( "minute", chan );
+  fprintf(stdout, ",\"frame\":%lld,\"time\":%.6f,\"ok\":%s"
+         , edge, edge / dcf.frameRate(), ok ? "true" : "false" );
+  if ( ok )
+    fprintf(stdout, ",\"utc\":%lld,\"local\":\"%04d-%02d-%02dT%02d:%02d\",\"tz\":\"%s\""
+           , dcf77ToUtc( &tms, tzIdx ), tms.tm_year + 1900, tms.tm_mon +1, tms.tm_mday
+           , tms.tm_hour, tms.tm_min, TZStrTab[tzIdx] );
+  else
+    fprintf(stdout, ",\"error\":\"%s\"", DCF77::evalErrorText( dcf.EvalError ) );
+  fprintf(stdout, ",\"value\":\"%015llx\",\"valid\":\"%015llx\"", value, valid );
+  if ( dcf.MeasuredRate > 0.0 )
+    fprintf(stdout, ",\"rate\":%.3f,\"ppm\":%.2f", dcf.MeasuredRate, dcf.MeasuredRatePpm );
+  fprintf(stdout, "}\n");
+
+  if ( net.isOpen() )
+  {
+    DCF77MinuteRecord rec;
+    memset( &rec, 0, sizeof(rec) );
+    rec.fromDecoder( dcf, &tms, tzIdx, ok );
+    rec.EdgeTimeNs = frameTimeNs( dcf, epoch, edge );
+    net.minute( rec );
+  }
+  return ok;
+}
+
+
+// --all-chans: k frames, every channel a stream of multi
+static void decodeAllChans( DCF77Multi & multi, SampleFormat format, const void * data, unsigned k
+                          , std::vector<float> & conv, std::vector<long long> & lastSecEdge
+                          , std::vector<int> & lastBit, bool seconds, DCF77NetSender & net )
+{
+  const unsigned n = multi.size();
+  const float * p = (const float *)data;
+  size_t i;
+  unsigned c;
+
+  if ( FMT_F32 != format )
+  {
+    conv.resize( (size_t)k * n );
+    for ( i = 0; i < conv.size(); ++i )
+      conv[i] = ( FMT_S16 == format ) ? (float)( ( (const short *)data )[i] * ( 1.0 / 32768.0 ) )
+                                      : (float)( ( (const int *)data )[i] * ( 1.0 / 2147483648.0 ) );
+    p = &conv[0];
+  }
+  multi.newData( k, p, n );
+
+  for ( c = 0; c < n; ++c )
+  {
+    DCF77 & dcf = multi.stream( c );
+    if ( seconds && dcf.LastBit >= 0 && dcf.SecEdgeFrame >= 0
+      && ( lastBit[c] < 0 || dcf.SecEdgeFrame != lastSecEdge[c] ) )
+      printSecond( dcf, dcf.SecEdgeFrame, (int)c );
+    lastBit[c] = dcf.LastBit;
+    lastSecEdge[c] = dcf.SecEdgeFrame;
+    if ( !dcf.EvaluatedMinPulse )
+    {
+      printMinute( dcf, net, 0.0, (int)c );
+      dcf.EvaluatedMinPulse = true;
+      fflush(stdout);
+    }
+  }
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  SampleFormat Format = FMT_S16;
+  double SampleRate = 48000.0;
+  unsigned ChanCount = 1;
+  unsigned ChanIdx = 0;
+  double BlockSec = 1.0;
+  bool Seconds = true;
+  const char * InputName = NULL;
+  const char * NetDest = NULL;
+  unsigned NetId = 0;
+  double Epoch = -1.0;
+  bool AllChans = false;
+  DCF77 dcf;
+  DCF77Multi multi;
+  DCF77NetSender net;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [--format s16|s32|f32] [--rate <Hz>] [--chans <n>] [--chan <idx>]\n"
+             "    [--block <sec>] [--invert] [--trellis] [--minutes-only] [--all-chans]\n"
+             "    [--net <host:port> [--id <n>] [--epoch <unixtime>]] [<fifo>]\n\n", argv[0]);
+      printf("decodes raw little endian PCM from stdin or <fifo>\n");
+      printf("writes one JSON object per line to stdout:\n");
+      printf("  {\"type\":\"second\",\"frame\":..,\"time\":..,\"sec\":..,\"bit\":..}\n");
+      printf("  {\"type\":\"minute\",\"frame\":..,\"time\":..,\"ok\":true,\"utc\":..,\"local\":..,\"tz\":..,..}\n");
+      printf("  frame / time: position of second / minute mark in input\n");
+      printf("  rate / ppm: measured sample rate, once known\n");
+      printf("  --block <sec>: size of read blocks. default: 1\n");
+      printf("  --invert: signal pulses go negative\n");
+      printf("  --trellis: decode minutes with the trellis decoder\n");
+      printf("  --all-chans: decode every channel, events with \"chan\"\n");
+      printf("  --net: send events to dcf77-aggregate as host <id>\n");
+      printf("  --epoch: host time of input start. default: now\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--format") && argno +1 < argc )
+    {
+      ++argno;
+      if ( !strcmp(argv[argno], "s16") )
+        Format = FMT_S16;
+      else if ( !strcmp(argv[argno], "s32") )
+        Format = FMT_S32;
+      else if ( !strcmp(argv[argno], "f32") )
+        Format = FMT_F32;
+      else
+      {
+        fprintf(stderr, "Error: unknown format '%s'\n", argv[argno]);
+        return 1;
+      }
+    }
+    else if ( !strcmp(argv[argno], "--rate") && argno +1 < argc )
+      SampleRate = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--chans") && argno +1 < argc )
+      ChanCount = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--chan") && argno +1 < argc )
+      ChanIdx = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--block") && argno +1 < argc )
+      BlockSec = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--invert") )
+      dcf.Invert = true;
+    else if ( !strcmp(argv[argno], "--trellis") )
+      dcf.UseTrellis = true;
+    else if ( !strcmp(argv[argno], "--minutes-only") )
+      Seconds = false;
+    else if ( !strcmp(argv[argno], "--all-chans") )
+      AllChans = true;
+    else if ( !strcmp(argv[argno], "--net") && argno +1 < argc )
+      NetDest = argv[++argno];
+    else if ( !strcmp(argv[argno], "--id") && argno +1 < argc )
+      NetId = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--epoch") && argno +1 < argc )
+      Epoch = atof(argv[++argno]);
+    else
+      InputName = argv[argno];
+  }
+
+  if ( SampleRate < 1000.0 || ChanCount < 1 || ChanIdx >= ChanCount )
+  {
+    fprintf(stderr, "Error: invalid rate, channel count or channel. see --help\n");
+    return 1;
+  }
+
+  if ( NetDest && AllChans )
+  {
+    fprintf(stderr, "Error: --net sends a single channel, not with --all-chans\n");
+    return 1;
+  }
+  if ( NetDest && !net.open( NetDest, NetId, stderr ) )
+    return 1;
+  if ( Epoch < 0.0 )
+  {
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    Epoch = tv.tv_sec + 1E-6 * tv.tv_usec;
+  }
+
+  int fd = 0;
+  if ( InputName && strcmp( InputName, "-" ) )
+  {
+    fd = open( InputName, O_RDONLY );
+    if ( fd < 0 )
+    {
+      fprintf(stderr, "Error: could not open '%s': %s\n", InputName, strerror(errno));
+      return 1;
+    }
+  }
+#ifdef _MSC_VER
+  else
+    _setmode( 0, _O_BINARY );
+#endif
+
+  dcf.SampleRate = SampleRate;
+  dcf.ChanCount = ChanCount;
+  dcf.ChanIdx = ChanIdx;
+  dcf.FramesPerBuffer = (unsigned)( SampleRate / 100.0 );   // 10 ms steps for events
+  dcf.initGetThreshold();
+  if ( AllChans )
+  {
+    unsigned c;
+    multi.init( ChanCount, SampleRate );
+    for ( c = 0; c < ChanCount; ++c )
+    {
+      multi.stream( c ).Invert = dcf.Invert;
+      multi.stream( c ).UseTrellis = dcf.UseTrellis;
+    }
+  }
+  std::vector<float> conv;
+  std::vector<long long> chanSecEdge( ChanCount, -1 );
+  std::vector<int> chanBit( ChanCount, -1 );
+
+  const size_t bytesPerSample = ( FMT_S16 == Format ) ? 2 : 4;
+  const size_t bytesPerFrame = bytesPerSample * ChanCount;
+  size_t BlockFrames = (size_t)( BlockSec * SampleRate );
+  if ( BlockFrames < dcf.FramesPerBuffer )
+    BlockFrames = dcf.FramesPerBuffer;
+
+  // int elements: aligned for all formats
+  std::vector<int> samples( ( BlockFrames * bytesPerFrame + sizeof(int) - 1 ) / sizeof(int) );
+  void * readBuf = &samples[0];
+
+  long long lastSecEdge = -1;
+  int lastBit = -1;
+  long long lastQuality = 0;
+  DCF77NetQuality quality;
+  memset( &quality, 0, sizeof(quality) );
+  quality.HoldSigmaMs = -1.0F;
+  size_t rest = 0;      // bytes of incomplete frame at end of last block
+  std::vector<unsigned char> restBuf( bytesPerFrame );
+
+  for (;;)
+  {
+    unsigned char * dst = (unsigned char *)readBuf;
+    memcpy( dst, &restBuf[0], rest );
+    const size_t got = rest + readBlock( fd, dst + rest, BlockFrames * bytesPerFrame - rest );
+    const size_t frames = got / bytesPerFrame;
+    size_t i;
+
+    rest = got - frames * bytesPerFrame;
+    if ( !frames )
+      break;
+    memcpy( &restBuf[0], dst + frames * bytesPerFrame, rest );
+
+    for ( i = 0; i < frames; i += dcf.FramesPerBuffer )
+    {
+      const unsigned k = (unsigned)( ( frames - i < dcf.FramesPerBuffer ) ? frames - i : dcf.FramesPerBuffer );
+      if ( AllChans )
+      {
+        decodeAllChans( multi, Format, (const unsigned char *)readBuf + i * bytesPerFrame, k
+                      , conv, chanSecEdge, chanBit, Seconds, net );
+        continue;
+      }
+      if ( FMT_S16 == Format )
+        dcf.newData( k, (const short *)readBuf + i * ChanCount );
+      else if ( FMT_S32 == Format )
+        dcf.newData( k, (const int *)readBuf + i * ChanCount );
+      else
+        dcf.newData( k, (const float *)readBuf + i * ChanCount );
+
+      // bit of second gets known at end of its pulse
+      if ( dcf.LastBit >= 0 && dcf.SecEdgeFrame >= 0
+        && ( lastBit < 0 || dcf.SecEdgeFrame != lastSecEdge ) )
+      {
+        if ( Seconds )
+          printSecond( dcf, dcf.SecEdgeFrame, -1 );
+        if ( net.isOpen() && dcf.MinEdgeFrame >= 0 )
+          net.second( frameTimeNs( dcf, Epoch, dcf.SecEdgeFrame )
+                    , (int)( ( dcf.SecEdgeFrame - dcf.MinEdgeFrame ) / dcf.frameRate() + 0.5 ) );
+      }
+      lastBit = dcf.LastBit;
+      lastSecEdge = dcf.SecEdgeFrame;
+
+      if ( net.isOpen() && dcf.TotalFrames - lastQuality >= (long long)( 10.0 * SampleRate ) )
+      {
+        lastQuality = dcf.TotalFrames;
+        quality.State = dcf.eState;
+        quality.Signal = ( dcf.FramesSinceLastPulse < 2.0 * dcf.frameRate() );
+        quality.RatePpm = (float)dcf.MeasuredRatePpm;
+        quality.Threshold = dcf.Threshold;
+        net.quality( quality );
+      }
+
+      if ( !dcf.EvaluatedMinPulse )
+      {
+        if ( printMinute( dcf, net, Epoch, -1 ) )
+          ++quality.ValidMinutes;
+        else
+          ++quality.FailedMinutes;
+        dcf.EvaluatedMinPulse = true;
+        fflush(stdout);
+      }
+    }
+    if ( Seconds )
+      fflush(stdout);
+  }
+
+  if ( fd )
+    close( fd );
+  return 0;
+}
+
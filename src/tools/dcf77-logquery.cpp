@@ -0,0 +1,194 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "../dcf77/dcf77.h"
+#include "../dcf77/dcf77log.h"
+
+
+// query tool for minute logs written with dcf77-settime 'log <file>'
+
+struct QueryState
+{
+  int       Filter;     // 0: all, 1: only valid, -1: only failed
+  bool      Print;
+  long long Ok;
+  long long Failed;
+  std::vector<float> Jitter;
+};
+
+
+// "YYYY-MM-DD[THH:MM[:SS]]" in UTC to ns. -1 on error
+static long long parseTime( const char * s )
+{
+  struct tm t;
+  memset( &t, 0, sizeof(t) );
+  const int n = sscanf( s, "%d-%d-%d%*c%d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday
+                      , &t.tm_hour, &t.tm_min, &t.tm_sec );
+  if ( n < 3 )
+    return -1;
+  t.tm_year -= 1900;
+  t.tm_mon -= 1;
+  return (long long)timegm( &t ) * 1000000000LL;
+}
+
+
+static void printTime( long long ns, char * buf, size_t len )
+{
+  const time_t sec = (time_t)( ns / 1000000000LL );
+  struct tm t;
+  gmtime_r( &sec, &t );
+  const size_t n = strftime( buf, len, "%Y-%m-%d %H:%M:%S", &t );
+  snprintf( buf + n, len - n, ".%03d", (int)( ( ns / 1000000 ) % 1000 ) );
+}
+
+
+static bool onRecord( const DCF77MinuteRecord & rec, void * ctx )
+{
+  QueryState * q = (QueryState *)ctx;
+  const bool ok = ( 0 == rec.ErrorCode );
+  char edge[64], dcf[64];
+
+  if ( ( q->Filter > 0 && !ok ) || ( q->Filter < 0 && ok ) )
+    return true;
+  if ( ok )
+    ++q->Ok;
+  else
+    ++q->Failed;
+  if ( rec.PulseCount )
+    q->Jitter.push_back( rec.JitterMeanMs );
+
+  if ( q->Print )
+  {
+    printTime( rec.EdgeTimeNs, edge, sizeof(edge) );
+    if ( ok )
+    {
+      printTime( rec.UtcMinute * 1000000000LL, dcf, sizeof(dcf) );
+      dcf[16] = 0;    // minute resolution
+    }
+    fprintf(stdout, "%s UTC  dev %u  %s  jitter %.2f/%.2f ms  pulses %u  mask %015llx/%015llx\n"
+           , edge, rec.DeviceId, ok ? dcf : DCF77::evalErrorText( rec.ErrorCode )
+           , rec.JitterMeanMs, rec.JitterMaxMs, rec.PulseCount
+           , rec.ValueMask, rec.ValidMask );
+  }
+  return true;
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  const char * LogFileName = NULL;
+  long long FromNs = -0x7FFFFFFFFFFFFFFFLL;
+  long long ToNs = 0x7FFFFFFFFFFFFFFFLL;
+  int Device = -1;
+  bool JitterStats = false;
+  QueryState q;
+  DCF77MinuteLogReader rd;
+
+  q.Filter = 0;
+  q.Print = true;
+  q.Ok = q.Failed = 0;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [--from <date>] [--to <date>] [--device <id>] [--ok|--failed]\n"
+             "    [--jitter] [--count] <logfile>\n\n", argv[0]);
+      printf("  <date>: YYYY-MM-DD[THH:MM[:SS]] in UTC. --to is exclusive\n");
+      printf("  --jitter: print distribution of mean second jitter per minute\n");
+      printf("  --count: print only number of matching minutes\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--from") && argno +1 < argc )
+      FromNs = parseTime( argv[++argno] );
+    else if ( !strcmp(argv[argno], "--to") && argno +1 < argc )
+      ToNs = parseTime( argv[++argno] );
+    else if ( !strcmp(argv[argno], "--device") && argno +1 < argc )
+      Device = atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--ok") )
+      q.Filter = 1;
+    else if ( !strcmp(argv[argno], "--failed") )
+      q.Filter = -1;
+    else if ( !strcmp(argv[argno], "--jitter") )
+    {
+      JitterStats = true;
+      q.Print = false;
+    }
+    else if ( !strcmp(argv[argno], "--count") )
+      q.Print = false;
+    else
+      LogFileName = argv[argno];
+  }
+
+  if ( !LogFileName || -1 == FromNs || -1 == ToNs )
+  {
+    fprintf(stderr, "Error: missing log file or invalid date. see --help\n");
+    return 1;
+  }
+  if ( !rd.open( LogFileName, stderr ) )
+    return 1;
+
+  rd.query( FromNs, ToNs, Device, onRecord, &q );
+
+  fprintf(stdout, "%lld minutes: %lld valid, %lld failed\n", q.Ok + q.Failed, q.Ok, q.Failed);
+  fprintf(stderr, "%lld records in log, %lld blocks scanned\n", rd.RecordCount, rd.BlocksScanned);
+
+  if ( JitterStats && !q.Jitter.empty() )
+  {
+    const float pct[] = { 0.0F, 0.1F, 0.5F, 0.9F, 0.99F, 1.0F };
+    const unsigned NumBins = 20;
+    const float BinMs = 0.5F;
+    unsigned bins[NumBins + 1];
+    size_t i;
+
+    std::sort( q.Jitter.begin(), q.Jitter.end() );
+    for ( i = 0; i < sizeof(pct) / sizeof(pct[0]); ++i )
+      fprintf(stdout, "  %3.0f %% percentile: %.3f ms\n", 100.0F * pct[i]
+             , q.Jitter[ (size_t)( pct[i] * ( q.Jitter.size() - 1 ) ) ] );
+
+    memset( bins, 0, sizeof(bins) );
+    for ( i = 0; i < q.Jitter.size(); ++i )
+    {
+      const unsigned b = (unsigned)( q.Jitter[i] / BinMs );
+      ++bins[ b < NumBins ? b : NumBins ];
+    }
+    for ( i = 0; i <= NumBins; ++i )
+    {
+      if ( !bins[i] )
+        continue;
+      if ( i < NumBins )
+        fprintf(stdout, "  %5.1f .. %5.1f ms: %u\n", i * BinMs, ( i + 1 ) * BinMs, bins[i]);
+      else
+        fprintf(stdout, "  >= %5.1f ms: %u\n", i * BinMs, bins[i]);
+    }
+  }
+  return 0;
+}
+
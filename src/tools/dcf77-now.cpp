@@ -0,0 +1,118 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <thread>
+
+#include "../dcf77/dcf77timepage.h"
+
+
+// reader of the time page published by dcf77-settime 'timepage <file>'
+
+static void printNow( const DCF77TimePageReader & rd )
+{
+  DCF77TimeRef ref;
+  int64_t utcNs = 0;
+  double errNs = 0.0;
+  uint32_t status = 0;
+  char buf[64];
+
+  if ( !rd.now( &utcNs, &errNs, &status ) || !rd.read( &ref ) )
+  {
+    fprintf(stdout, "no reference%s\n", ( status & DCF77TimeRef::STATUS_SIGNAL ) ? ", receiving" : "");
+    return;
+  }
+  const time_t sec = (time_t)( utcNs / 1000000000LL );
+  struct tm t;
+  gmtime_r( &sec, &t );
+  strftime( buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &t );
+  fprintf(stdout, "%s.%06d UTC  +/- %.3f ms  %s%s  rate %+.3f ppm  %u fixes  audio %.3f Hz\n"
+         , buf, (int)( ( utcNs / 1000 ) % 1000000 ), 1E-6 * errNs
+         , ( status & DCF77TimeRef::STATUS_SYNC ) ? "sync" : "holdover"
+         , ( status & DCF77TimeRef::STATUS_SIGNAL ) ? "" : ", no signal"
+         , 1E6 * ref.Rate, ref.Fixes, ref.SampleRate);
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  const char * PageName = "/dev/shm/dcf77-time";
+  bool Watch = false;
+  bool Bench = false;
+  DCF77TimePageReader rd;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [--watch] [--bench] [<page>]\n\n", argv[0]);
+      printf("  <page>: file of dcf77-settime 'timepage'. default: %s\n", PageName);
+      printf("  --watch: print time every second\n");
+      printf("  --bench: measure cost of reading the time\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--watch") )
+      Watch = true;
+    else if ( !strcmp(argv[argno], "--bench") )
+      Bench = true;
+    else
+      PageName = argv[argno];
+  }
+
+  if ( !rd.open( PageName, stderr ) )
+    return 1;
+
+  if ( Bench )
+  {
+    const unsigned N = 10000000;
+    int64_t utcNs = 0, sum = 0;
+    double errNs = 0.0;
+    uint32_t status = 0;
+    unsigned i, failed = 0;
+    const int64_t t0 = DCF77TimePageReader::monoNs();
+    for ( i = 0; i < N; ++i )
+    {
+      if ( rd.now( &utcNs, &errNs, &status ) )
+        sum += utcNs;
+      else
+        ++failed;
+    }
+    const int64_t t1 = DCF77TimePageReader::monoNs();
+    fprintf(stdout, "%.1f ns per read, %u seqlock retries, %u without reference (%lld)\n"
+           , (double)( t1 - t0 ) / N, rd.Retries, failed, (long long)( sum & 1 ));
+    return 0;
+  }
+
+  do
+  {
+    printNow( rd );
+    fflush(stdout);
+    if ( Watch )
+      std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
+  } while ( Watch );
+  return 0;
+}
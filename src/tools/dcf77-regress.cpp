@@ -0,0 +1,386 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "../dcf77/dcf77.h"
+#include "../dcf77/dcf77log.h"
+#include "../dcf77/dcf77multi.h"
+#include "../dcf77/dcf77synth.h"
+
+
+// Regression corpus for the decoder: each scenario synthesizes some minutes
+// of signal with DCF77Synth (deterministic seed), decodes them like
+// dcf77-settime does and compares against the ground truth.
+// Exit code is non-zero if any scenario misses its limits.
+// --multi <n>: n streams of each scenario (seeds seed .. seed + n-1) through
+// DCF77Multi and through n DCF77 objects: minutes must be identical.
+
+struct Scenario
+{
+  const char *  name;
+  double        rate;
+  unsigned      chans;
+  unsigned      minutes;
+  bool          level;
+  double        noise;
+  double        fadeDepth;
+  double        stretchMs;
+  double        jitterMs;
+  double        dropout;
+  double        impulseRate;
+  double        impulseAmp;
+  double        ppm;
+  // limits
+  double        minDecodeRate;    // valid minutes / decodable minutes
+  unsigned      maxWrong;         // valid but wrong minutes
+  double        maxEdgeErrMs;     // abs error of minute edge
+};
+
+static const Scenario Corpus[] =
+{
+  //  name           rate   ch min level noise fade stretch jit  drop  imp  iamp  ppm    rate wrong edge
+  { "clean",         48000, 1, 10, false, 0.01, 0.0,  0.0,  0.0, 0.0,  0.0, 0.0,   0.0, 1.00, 0,   0.1 },
+  { "clean-192k",   192000, 1,  5, false, 0.01, 0.0,  0.0,  0.0, 0.0,  0.0, 0.0,   0.0, 1.00, 0,   0.1 },
+  { "stereo-44k1",   44100, 2,  5, false, 0.01, 0.0,  0.0,  0.0, 0.0,  0.0, 0.0,   0.0, 1.00, 0,   0.1 },
+  { "noise",         48000, 1, 10, false, 0.03, 0.0,  0.0,  0.0, 0.0,  0.0, 0.0,   0.0, 0.90, 0,   0.1 },
+  // noise peaks lift the threshold close to the pulses: hysteresis keeps edges clean
+  { "noise-heavy",   48000, 1, 10, false, 0.06, 0.0,  0.0,  0.0, 0.0,  0.0, 0.0,   0.0, 0.90, 0,   0.1 },
+  { "fading",        48000, 1, 10, false, 0.01, 0.3,  0.0,  0.0, 0.0,  0.0, 0.0,   0.0, 0.90, 0,   0.1 },
+  { "stretch-20ms",  48000, 1, 10, false, 0.01, 0.0, 20.0,  0.0, 0.0,  0.0, 0.0,   0.0, 1.00, 0,   0.1 },
+  // beyond the nominal windows: needs the learned pulse offset
+  { "stretch-60ms",  48000, 1, 10, false, 0.01, 0.0, 60.0,  0.0, 0.0,  0.0, 0.0,   0.0, 1.00, 0,   0.1 },
+  { "jitter-2ms",    48000, 1, 10, false, 0.01, 0.0,  0.0,  2.0, 0.0,  0.0, 0.0,   0.0, 1.00, 0,   2.5 },
+  { "dropouts",      48000, 1, 10, false, 0.01, 0.0,  0.0,  0.0, 0.01, 0.0, 0.0,   0.0, 0.50, 0,   0.1 },
+  { "impulses",      48000, 1, 10, false, 0.01, 0.0,  0.0,  0.0, 0.0,  0.2, 0.6,   0.0, 0.40, 0,   0.1 },
+  { "clock-200ppm",  48000, 1, 10, false, 0.01, 0.0,  0.0,  0.0, 0.0,  0.0, 0.0, 200.0, 1.00, 0,   0.1 },
+  // plain level signal: bits from the falling edges
+  { "level",         48000, 1,  5, true,  0.01, 0.0,  0.0,  0.0, 0.0,  0.0, 0.0,   0.0, 1.00, 0,   0.1 },
+};
+
+
+struct Result
+{
+  unsigned  expected;     // minute marks after threshold phase and a full minute
+  unsigned  valid;
+  unsigned  wrong;
+  unsigned  invalid;
+  double    ttffSec;      // time to first correct minute, -1 if none
+  double    maxEdgeErrMs;
+  double    nsPerSample;
+};
+
+
+static void setupSynth( DCF77Synth & syn, const Scenario & sc, unsigned seed )
+{
+  syn.SampleRate = sc.rate;
+  syn.ChanCount = sc.chans;
+  syn.ChanIdx = sc.chans - 1;
+  syn.StartTime = 1200000000 + 17;    // decoder starts within a minute
+  syn.Seed = seed;
+  syn.eCoupling = sc.level ? DCF77Synth::COUPLING_LEVEL : DCF77Synth::COUPLING_EDGE;
+  syn.NoiseRms = sc.noise;
+  syn.FadeDepth = sc.fadeDepth;
+  syn.PulseStretchMs = sc.stretchMs;
+  syn.EdgeJitterMs = sc.jitterMs;
+  syn.DropoutRate = sc.dropout;
+  syn.ImpulseRate = sc.impulseRate;
+  syn.ImpulseAmp = sc.impulseAmp;
+  syn.ClockPpm = sc.ppm;
+  syn.reset();
+}
+
+
+struct MinuteMark
+{
+  long long frame;
+  int       mask[4];
+};
+
+// new minute of decoder, if any
+static void takeMinute( DCF77 & dcf, std::vector<MinuteMark> & out )
+{
+  MinuteMark m;
+  if ( dcf.EvaluatedMinPulse )
+    return;
+  dcf.EvaluatedMinPulse = true;
+  m.frame = dcf.MinEdgeFrame;
+  m.mask[0] = dcf.EvalValueMaskLo;
+  m.mask[1] = dcf.EvalValidMaskLo;
+  m.mask[2] = dcf.EvalValueMaskHi;
+  m.mask[3] = dcf.EvalValidMaskHi;
+  out.push_back( m );
+}
+
+
+// returns number of streams with differing minutes
+static unsigned runMulti( const Scenario & sc, unsigned seed, unsigned streams, bool trellis
+                        , unsigned * minutes, double * nsSingle, double * nsMulti )
+{
+  const unsigned BufFrames = (unsigned)( sc.rate / 100.0 );
+  const long long totalFrames = (long long)( ( sc.minutes < 3 ? sc.minutes : 3 ) * 60.0 * sc.rate );
+  std::vector<DCF77Synth> syn( streams );
+  std::vector<DCF77> dcf( streams );
+  std::vector< std::vector<MinuteMark> > single( streams ), multi( streams );
+  std::vector<float> gen( BufFrames * sc.chans );
+  std::vector<float> buf( (size_t)BufFrames * streams );
+  DCF77Multi engine;
+  long long frame;
+  unsigned s, i, differ = 0;
+
+  engine.init( streams, sc.rate );
+  for ( s = 0; s < streams; ++s )
+  {
+    setupSynth( syn[s], sc, seed + s );
+    dcf[s].SampleRate = sc.rate;
+    dcf[s].UseTrellis = trellis;
+    engine.stream( s ).UseTrellis = trellis;
+  }
+
+  *nsSingle = *nsMulti = 0.0;
+  for ( frame = 0; frame + BufFrames <= totalFrames; frame += BufFrames )
+  {
+    for ( s = 0; s < streams; ++s )
+    {
+      syn[s].generate( BufFrames, &gen[0] );
+      for ( i = 0; i < BufFrames; ++i )
+        buf[(size_t)i * streams + s] = gen[(size_t)i * sc.chans + sc.chans - 1];
+    }
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for ( s = 0; s < streams; ++s )
+    {
+      dcf[s].ChanCount = streams;
+      dcf[s].ChanIdx = s;
+      dcf[s].newData( BufFrames, &buf[0] );
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    engine.newData( BufFrames, &buf[0], streams );
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    *nsSingle += std::chrono::duration<double, std::nano>( t1 - t0 ).count();
+    *nsMulti += std::chrono::duration<double, std::nano>( t2 - t1 ).count();
+
+    for ( s = 0; s < streams; ++s )
+    {
+      takeMinute( dcf[s], single[s] );
+      takeMinute( engine.stream( s ), multi[s] );
+    }
+  }
+
+  *minutes = 0;
+  for ( s = 0; s < streams; ++s )
+  {
+    *minutes += (unsigned)single[s].size();
+    if ( single[s].size() != multi[s].size()
+      || ( !single[s].empty() && memcmp( &single[s][0], &multi[s][0], single[s].size() * sizeof(MinuteMark) ) ) )
+      ++differ;
+  }
+  *nsSingle /= (double)frame * streams;
+  *nsMulti /= (double)frame * streams;
+  return differ;
+}
+
+
+static void runScenario( const Scenario & sc, unsigned seed, bool verbose, bool trellis, Result & res )
+{
+  DCF77Synth syn;
+  DCF77 dcf;
+  const unsigned BufFrames = (unsigned)( sc.rate / 100.0 );   // 10 ms buffers
+  std::vector<float> buf( BufFrames * sc.chans );
+  const long long totalFrames = (long long)( sc.minutes * 60.0 * sc.rate );
+  long long frame;
+  double decodeNs = 0.0;
+
+  setupSynth( syn, sc, seed );
+
+  dcf.SampleRate = sc.rate;
+  dcf.ChanCount = sc.chans;
+  dcf.ChanIdx = sc.chans - 1;
+  dcf.UseTrellis = trellis;
+
+  memset( &res, 0, sizeof(res) );
+  res.ttffSec = -1.0;
+
+  // minute marks, for which a complete minute of bits can be received:
+  // threshold phase takes 10 s, then the decoder needs the previous minute mark
+  {
+    long long sec;
+    bool sawMark = false;
+    for ( sec = 0; syn.secondMarkFrame( sec ) < (double)totalFrames - sc.rate; ++sec )
+    {
+      if ( ( syn.StartTime + sec ) % 60 || syn.secondMarkFrame( sec ) < 11.0 * sc.rate )
+        continue;
+      if ( sawMark )
+        ++res.expected;
+      sawMark = true;
+    }
+  }
+
+  for ( frame = 0; frame + BufFrames <= totalFrames; frame += BufFrames )
+  {
+    syn.generate( BufFrames, &buf[0] );
+
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    dcf.newData( BufFrames, &buf[0] );
+    decodeNs += std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - t0 ).count();
+
+    if ( dcf.ThreshFinishMessage )
+      dcf.ThreshFinishMessage = false;
+    if ( dcf.EvaluatedMinPulse )
+      continue;
+
+    struct tm tms;
+    int tzIdx = 0;
+    const bool ok = dcf.evalMinPulse( &tms, &tzIdx, NULL );
+    dcf.EvaluatedMinPulse = true;
+    if ( !ok )
+    {
+      ++res.invalid;
+      continue;
+    }
+
+    // nearest true second mark
+    const double edge = (double)dcf.MinEdgeFrame;
+    const double framesPerSec = syn.secondMarkFrame( 1 ) - syn.secondMarkFrame( 0 );
+    const long long sec = (long long)floor( ( edge - syn.secondMarkFrame( 0 ) ) / framesPerSec + 0.5 );
+    const long long truth = syn.StartTime + sec;
+    const long long decoded = dcf77ToUtc( &tms, tzIdx );
+    const double errMs = 1E3 * ( edge - syn.secondMarkFrame( sec ) ) / sc.rate;
+
+    if ( decoded != truth )
+    {
+      ++res.wrong;
+      if ( verbose )
+        fprintf(stderr, "  %s: wrong minute at %.3f s: decoded %lld, truth %lld\n"
+               , sc.name, edge / sc.rate, decoded, truth);
+      continue;
+    }
+    ++res.valid;
+    if ( res.ttffSec < 0.0 )
+      res.ttffSec = ( frame + BufFrames ) / sc.rate;
+    if ( fabs( errMs ) > res.maxEdgeErrMs )
+      res.maxEdgeErrMs = fabs( errMs );
+  }
+
+  res.nsPerSample = decodeNs / (double)( frame ? frame : 1 );
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  unsigned Seed = 1;
+  bool Verbose = false;
+  bool Trellis = false;
+  unsigned Multi = 0;
+  const char * Only = NULL;
+  unsigned i, failed = 0, run = 0;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [--seed <n>] [--verbose] [--trellis] [--multi <n>] [--list] [<scenario>]\n\n", argv[0]);
+      printf("decodes the built-in corpus of synthetic signals and checks\n"
+             "decode rate, wrong minutes and minute edge error against limits\n");
+      printf("  --trellis: decode minutes with the trellis decoder\n");
+      printf("  --multi <n>: compare DCF77Multi with <n> single decoders over 3 minutes\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--seed") && argno +1 < argc )
+      Seed = (unsigned)strtoul(argv[++argno], NULL, 0);
+    else if ( !strcmp(argv[argno], "--verbose") )
+      Verbose = true;
+    else if ( !strcmp(argv[argno], "--trellis") )
+      Trellis = true;
+    else if ( !strcmp(argv[argno], "--multi") && argno +1 < argc )
+      Multi = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--list") )
+    {
+      for ( i = 0; i < sizeof(Corpus) / sizeof(Corpus[0]); ++i )
+        printf("%s\n", Corpus[i].name);
+      return 0;
+    }
+    else
+      Only = argv[argno];
+  }
+
+  if ( Multi )
+  {
+    fprintf(stdout, "%-14s %7s %7s %7s %9s %9s  %s\n"
+           , "scenario", "streams", "minutes", "differ", "ns single", "ns multi", "result");
+    for ( i = 0; i < sizeof(Corpus) / sizeof(Corpus[0]); ++i )
+    {
+      const Scenario & sc = Corpus[i];
+      unsigned minutes, differ;
+      double nsSingle, nsMulti;
+      if ( Only && strcmp( Only, sc.name ) )
+        continue;
+      ++run;
+      differ = runMulti( sc, Seed, Multi, Trellis, &minutes, &nsSingle, &nsMulti );
+      if ( differ )
+        ++failed;
+      fprintf(stdout, "%-14s %7u %7u %7u %9.2f %9.2f  %s\n"
+             , sc.name, Multi, minutes, differ, nsSingle, nsMulti, differ ? "FAILED" : "ok");
+    }
+    fprintf(stdout, "%u of %u scenarios failed\n", failed, run);
+    return failed ? 1 : 0;
+  }
+
+  fprintf(stdout, "%-14s %5s %5s %5s %5s %8s %9s %9s  %s\n"
+         , "scenario", "exp", "valid", "wrong", "inval", "ttff s", "edge ms", "ns/smp", "result");
+  for ( i = 0; i < sizeof(Corpus) / sizeof(Corpus[0]); ++i )
+  {
+    const Scenario & sc = Corpus[i];
+    Result res;
+
+    if ( Only && strcmp( Only, sc.name ) )
+      continue;
+    ++run;
+    runScenario( sc, Seed, Verbose, Trellis, res );
+
+    const double rate = res.expected ? (double)res.valid / res.expected : 0.0;
+    const bool pass = ( rate + 1E-9 >= sc.minDecodeRate )
+                   && ( res.wrong <= sc.maxWrong )
+                   && ( res.valid == 0 || res.maxEdgeErrMs <= sc.maxEdgeErrMs );
+    if ( !pass )
+      ++failed;
+    fprintf(stdout, "%-14s %5u %5u %5u %5u %8.1f %9.3f %9.2f  %s\n"
+           , sc.name, res.expected, res.valid, res.wrong, res.invalid
+           , res.ttffSec, res.maxEdgeErrMs, res.nsPerSample, pass ? "ok" : "FAILED");
+  }
+
+  if ( !run )
+  {
+    fprintf(stderr, "Error: unknown scenario '%s'. see --list\n", Only);
+    return 1;
+  }
+  fprintf(stdout, "%u of %u scenarios failed\n", failed, run);
+  return failed ? 1 : 0;
+}
+
@@ -31,9 +31,30 @@
 #include <string.h>
 #include <errno.h>
 #include <math.h>
-#include <portaudio.h>
+#include <signal.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include "../dcf77/dcf77.h"
+#include "../dcf77/dcf77prn.h"
+#include "../dcf77/dcf77rec.h"
+#include "../dcf77/dcf77log.h"
+#include "../dcf77/dcf77trace.h"
+#include "../dcf77/dcf77rt.h"
+#include "../dcf77/dcf77alsa.h"
+#include "../dcf77/dcf77pasource.h"
+#include "../dcf77/dcf77source.h"
+#include "../dcf77/dcf77notify.h"
+#include "../dcf77/dcf77hold.h"
+#include "../dcf77/dcf77scan.h"
+#include "../dcf77/dcf77state.h"
+#include "../dcf77/dcf77nmea.h"
+#include "../dcf77/dcf77net.h"
+#include "../dcf77/dcf77ntpshm.h"
+#include "../dcf77/dcf77timepage.h"
 
 
 // FramesPerBuffer (=10ms) should be the accuracy of the clock
@@ -50,65 +71,299 @@
 //      to being executed.
 //
 
-// a bit annoying having to discriminate the API version
-// why do they change the API?
-// however: thanks for providing a usable platform independent Sound Lib
-#define VER_18_1  ( ( 18 << 16 ) | 1 )
-#define VER_19    ( ( 19 << 16 ) | 0 )
+// everything the capture callback needs
+struct CaptureContext
+{
+  DCF77 *     dcf;
+  DCF77PRN *  prn;    // NULL, if PRN correlation is not activated
+  DCF77Recorder * rec;  // NULL, if not recording
+  DCF77Trace * trace;   // NULL, if not tracing
+  bool        MonotonicAdcTime;   // of audio source
+  DCF77AudioSource::SampleFormat Format;  // of audio source
+  float *     Conv;         // float32 copy of integer samples for recorder and PRN
+  unsigned    ConvFrames;
+  DCF77Notify * notify; // wakes main loop
+  // real-time setup, done by the capture thread in its first callback
+  int         RtPriority;   // 0: keep scheduling
+  int         RtCpu;        // < 0: no pinning
+  volatile bool RtDone;
+  volatile bool RtOk;
+  char        RtErr[256];
+};
 
-#ifdef _MSC_VER
-  // i've installed/compiled pa_stable_v19_20071207.tar.gz
-  // on MS Windows with MS Visual C++ 2003.NET
-  // pa_stable_v19_20071207.tar.gz contains PortAudio Version 19.0
-  #define PORTAUDIO_LIB_VERSION  VER_19
-#else
-  // Ubuntu Linux 6.06.1 LTS comes with PortAudio 18.1
-  #define PORTAUDIO_LIB_VERSION  VER_18_1
+// trace thread ids
+#define TRACE_TID_CALLBACK  1
+#define TRACE_TID_MAIN      2
+
+
+#ifndef _MSC_VER
+// SIGUSR1 toggles tracing, SIGUSR2 dumps trace. handled in main loop
+static volatile sig_atomic_t TraceToggleReq = 0;
+static volatile sig_atomic_t TraceDumpReq = 0;
+static DCF77Notify * SignalNotify = NULL;
+
+static void traceSignalHandler( int sig )
+{
+  if ( SIGUSR1 == sig )
+    TraceToggleReq = 1;
+  else
+    TraceDumpReq = 1;
+  if ( SignalNotify )
+    SignalNotify->signal();
+}
 #endif
 
 
-static void
-pa_error_handler (PaError pa_error)
+// float32 samples of frames [first, first + *frames) for recorder and PRN
+// correlation: integer samples get converted, at most ConvFrames
+static const float * floatFrames( CaptureContext *ctx, const void *inputBuffer, unsigned long first, unsigned long *frames )
 {
-  printf("PortAudio error: %s\n", Pa_GetErrorText(pa_error));
+  const unsigned chans = ctx->dcf->ChanCount;
+  const size_t off = (size_t)first * chans;
+
+  if ( DCF77AudioSource::FMT_FLOAT32 == ctx->Format )
+    return (const float *)inputBuffer + off;
+  if ( *frames > ctx->ConvFrames )
+    *frames = ctx->ConvFrames;
 
-  Pa_Terminate();
-  exit (1);
+  const size_t n = (size_t)*frames * chans;
+  size_t i;
+  if ( DCF77AudioSource::FMT_INT16 == ctx->Format )
+  {
+    const short *in = (const short *)inputBuffer + off;
+    for ( i = 0; i < n; ++i )
+      ctx->Conv[i] = in[i] * ( 1.0F / 32768.0F );
+  }
+  else
+  {
+    const int *in = (const int *)inputBuffer + off;
+    for ( i = 0; i < n; ++i )
+      ctx->Conv[i] = in[i] * ( 1.0F / 2147483648.0F );
+  }
+  return ctx->Conv;
 }
 
+// processing of captured buffer in ctx->Format, shared by all capture backends.
+// adcTime in clock of backend, adcAge in ns: -1 if unknown
+static void processCapture( CaptureContext *ctx, unsigned long framesPerBuffer, const void *inputBuffer
+                          , double adcTime, long long adcAge, unsigned recFlags )
+{
+  unsigned long off, n;
 
-/* This routine will be called by the PortAudio engine when audio is needed.
-** It may be called at interrupt level on some machines so don't do anything
-** that could mess up the system like calling malloc() or free().
-*/
+  DCF77Trace *trace = ( ctx->trace && ctx->trace->Enabled.load( std::memory_order_relaxed ) ) ? ctx->trace : NULL;
+  long long tBegin = 0, t = 0, tEnd;
+  const bool firstCall = !ctx->RtDone;
 
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
+  if ( firstCall )
+  {
+    ctx->RtOk = ( ctx->RtPriority <= 0 && ctx->RtCpu < 0 )
+             || dcf77SetThreadRealtime( ctx->RtPriority, ctx->RtCpu, ctx->RtErr, sizeof(ctx->RtErr) );
+    // stack for decoder, PRN correlation (FFT) and recorder
+    dcf77PrefaultStack( 256 * 1024 );
+    ctx->RtDone = true;
+  }
 
-static int recordCallback(
-    const void *inputBuffer
-  , void *outputBuffer
-  , unsigned long framesPerBuffer
-  , const PaStreamCallbackTimeInfo* timeInfo
-  , PaStreamCallbackFlags statusFlags
-  , void *userData
-  )
+  if ( trace )
+    tBegin = t = DCF77Trace::now();
 
-#else
+  if ( ctx->rec )
+  {
+    for ( off = 0; off < framesPerBuffer; off += n )
+    {
+      n = framesPerBuffer - off;
+      const float *f = floatFrames( ctx, inputBuffer, off, &n );
+      ctx->rec->pushBuffer( n, f, ( off && adcTime > 0.0 ) ? adcTime + off / ctx->dcf->frameRate() : adcTime
+                          , off ? 0 : recFlags );
+    }
+    if ( trace )
+    {
+      tEnd = DCF77Trace::now();
+      trace->add( DCF77Trace::EV_RECORD, TRACE_TID_CALLBACK, t, tEnd, framesPerBuffer, adcAge < 0 ? -1 : adcAge + t - tBegin );
+      t = tEnd;
+    }
+  }
 
-static int recordCallback(
-    void *inputBuffer
-  , void *outputBuffer
-  , unsigned long framesPerBuffer
-  , PaTimestamp timeInfo
-  , void *userData
-  )
+  // decoder takes the samples as they are
+  if ( DCF77AudioSource::FMT_INT16 == ctx->Format )
+    ctx->dcf->pushData( framesPerBuffer, (const short *)inputBuffer, adcTime );
+  else if ( DCF77AudioSource::FMT_INT32 == ctx->Format )
+    ctx->dcf->pushData( framesPerBuffer, (const int *)inputBuffer, adcTime );
+  else
+    ctx->dcf->pushData( framesPerBuffer, (const float *)inputBuffer, adcTime );
+  if ( trace )
+  {
+    tEnd = DCF77Trace::now();
+    trace->add( DCF77Trace::EV_NEWDATA, TRACE_TID_CALLBACK, t, tEnd, framesPerBuffer, adcAge < 0 ? -1 : adcAge + t - tBegin );
+    t = tEnd;
+  }
 
-#endif
+  if ( ctx->prn )
+  {
+    for ( off = 0; off < framesPerBuffer; off += n )
+    {
+      n = framesPerBuffer - off;
+      ctx->prn->newData( n, floatFrames( ctx, inputBuffer, off, &n ) );
+    }
+    if ( trace )
+    {
+      tEnd = DCF77Trace::now();
+      trace->add( DCF77Trace::EV_PRN, TRACE_TID_CALLBACK, t, tEnd, framesPerBuffer, adcAge < 0 ? -1 : adcAge + t - tBegin );
+      t = tEnd;
+    }
+  }
+
+  if ( trace )
+    trace->add( DCF77Trace::EV_CALLBACK, TRACE_TID_CALLBACK, tBegin, t, framesPerBuffer, adcAge );
+
+  // wake main loop only, when there is something to do
+  const DCF77 *dcf = ctx->dcf;
+  if ( firstCall || dcf->PrintDiff || !dcf->EvaluatedMinPulse
+    || dcf->ThreshStartMessage || dcf->ThreshFinishMessage || dcf->FastFixPending
+    || ( ctx->prn && ctx->prn->NewEpoch ) )
+    ctx->notify->signal();
+}
+
+// called by the thread of the audio source
+static void sourceCallback( unsigned framecount, const void * data, double adcTime
+                          , unsigned flags, void * userData )
+{
+  CaptureContext *ctx = (CaptureContext*)userData;
+  long long adcAge = -1;  // ns from ADC timestamp to begin of processing
+
+  if ( ctx->MonotonicAdcTime && adcTime > 0.0 && ctx->trace && ctx->trace->Enabled.load( std::memory_order_relaxed ) )
+    adcAge = DCF77Trace::now() - (long long)( 1E9 * adcTime );
+  processCapture( ctx, framecount, data, adcTime, adcAge
+                , ( flags & DCF77AudioSource::FLAG_INPUT_OVERFLOW ) ? DCF77Recorder::FLAG_INPUT_OVERFLOW : 0 );
+}
+
+
+static void scanCallback( unsigned framecount, const void * data, double, unsigned, void * userData )
+{
+  ( (DCF77PulseScan *)userData )->newData( framecount, (const float *)data );
+}
+
+
+struct ScanHit
+{
+  float     Score;
+  int       DeviceNo;
+  unsigned  ChanIdx;
+  unsigned  ChanCount;
+  bool      Inverted;
+};
+
+static bool operator<( const ScanHit & a, const ScanHit & b )
+{
+  return a.Score > b.Score;   // best first
+}
+
+
+// capture from all PortAudio input devices at once for a few seconds and
+// rank their channels by DCF77PulseScan. the best one is taken for dcf
+// and device; false if no channel carries a DCF77 signal
+static bool scanInputs( DCF77 * dcf, char * device, size_t len )
+{
+  const unsigned ScanMs = 6000;
+  const unsigned MaxChans = 8;    // of devices with many virtual channels
+  std::vector<int> devs;
+  std::vector<unsigned> chans;
+  std::vector<ScanHit> hits;
+  size_t i;
+  unsigned c;
+
+  if ( !DCF77PortAudioSource::inputDevices( devs, chans, stderr ) )
+    return false;
+
+  std::vector<DCF77PortAudioSource *> srcs( devs.size(), (DCF77PortAudioSource *)NULL );
+  std::vector<DCF77PulseScan> scans( devs.size() );
+  for ( i = 0; i < devs.size(); ++i )
+  {
+    DCF77PortAudioSource * s = new DCF77PortAudioSource();
+    char no[16];
+    snprintf( no, sizeof(no), "%d", devs[i] );
+    s->SampleRate = dcf->SampleRate;
+    s->ChanCount = ( chans[i] < MaxChans ) ? chans[i] : MaxChans;
+    s->FramesPerBuffer = dcf->FramesPerBuffer;
+    // some spare for the time until stop()
+    scans[i].init( dcf->SampleRate, s->ChanCount, ScanMs * 1E-3 + 2.0 );
+    if ( !s->open( no, NULL ) || !s->start( scanCallback, &scans[i], NULL ) )
+    {
+      printf("  %d: can not capture %u channels at %.0f Hz\n", devs[i], s->ChanCount, dcf->SampleRate);
+      delete s;
+      continue;
+    }
+    srcs[i] = s;
+  }
+
+  printf("Scanning inputs for %.0f s\n", ScanMs * 1E-3); fflush(stdout);
+  std::this_thread::sleep_for( std::chrono::milliseconds( ScanMs ) );
+
+  for ( i = 0; i < devs.size(); ++i )
+  {
+    if ( !srcs[i] )
+      continue;
+    srcs[i]->stop();
+    for ( c = 0; c < srcs[i]->ChanCount; ++c )
+    {
+      ScanHit h;
+      scans[i].evaluate( c, &h.Score, &h.Inverted );
+      h.DeviceNo = devs[i];
+      h.ChanIdx = c;
+      h.ChanCount = srcs[i]->ChanCount;
+      hits.push_back( h );
+    }
+    printf("  %d: %s\n", devs[i], srcs[i]->DeviceName);
+    delete srcs[i];
+  }
+
+  std::sort( hits.begin(), hits.end() );
+  for ( i = 0; i < hits.size(); ++i )
+    printf("  device %d channel %u: score %.2f%s%s\n", hits[i].DeviceNo, hits[i].ChanIdx, hits[i].Score
+          , hits[i].Inverted ? ", inverted" : ""
+          , hits[i].Score >= scans[0].MinScore ? "  DCF77" : "");
+  if ( hits.empty() || hits[0].Score < scans[0].MinScore )
+  {
+    fprintf(stderr, "Error: no input with DCF77 signal found\n");
+    return false;
+  }
+
+  snprintf( device, len, "%d", hits[0].DeviceNo );
+  dcf->ChanIdx = hits[0].ChanIdx;
+  dcf->ChanCount = hits[0].ChanCount;
+  dcf->Invert = hits[0].Inverted;
+  printf("Scan := device %d, channel %u%s\n", hits[0].DeviceNo, hits[0].ChanIdx
+        , hits[0].Inverted ? ", inverted" : "");
+  return true;
+}
+
+// reference of the holdover model at the last valid minute edge
+static void publishTimePage( DCF77TimePage & page, const DCF77Holdover & hold, const DCF77 & dcf )
 {
-  DCF77 *data = (DCF77*)userData;
+  const long long now = DCF77Trace::now();
+  double utc, sigma, utc1, sigma1;
+  DCF77TimeRef r;
 
-  data->newData( framesPerBuffer, (const float *)inputBuffer );
-  return 0; // Continue
+  memset( &r, 0, sizeof(r) );
+  r.UpdateMonoNs = now;
+  r.SampleRate = dcf.MeasuredRate;
+  r.Fixes = hold.Fixes;
+  if ( DCF77::STATE_GET_TIME == dcf.eState && dcf.FramesSinceLastPulse < 2.0 * dcf.SampleRate )
+    r.Status |= DCF77TimeRef::STATUS_SIGNAL;
+  if ( hold.estimate( hold.LastFixLocal, &utc, &sigma )
+    && hold.estimate( hold.LastFixLocal + 3600.0, &utc1, &sigma1 ) )
+  {
+    r.Status |= DCF77TimeRef::STATUS_VALID;
+    if ( 1E-9 * now - hold.LastFixLocal < 120.0 )
+      r.Status |= DCF77TimeRef::STATUS_SYNC;
+    r.RefMonoNs = (long long)floor( 1E9 * hold.LastFixLocal + 0.5 );
+    // whole seconds apart: no loss of the fraction of utc
+    const double sec = floor( utc );
+    r.RefUtcNs = (long long)sec * 1000000000LL + (long long)floor( 1E9 * ( utc - sec ) + 0.5 );
+    r.Rate = ( utc1 - utc ) / 3600.0 - 1.0;
+    r.ErrNs = 1E9 * sigma;
+    r.ErrGrowth = 1E9 * ( sigma1 - sigma ) / 3600.0;
+  }
+  page.publish( r );
 }
 
 
@@ -116,12 +371,57 @@ int main( int argc, char *argv[] )
 {
   int argno;
   int ListDevices = 0;
-  int DeviceCount = 0;
-  int DeviceNo = 0;
-  PaError pa_error;
   DCF77 data;
+  DCF77PRN prn;
+  CaptureContext ctx;
+  DCF77Recorder rec;
+  const char * RecFileName = NULL;
+  unsigned RecDroppedReported = 0;
+  int PrnChanIdx = -1;
+  long long PrnHintFrame = -1;
   double sumJitter = 0.0;
   double cntJitter = 0.0;
+  DCF77MinuteLog minLog;
+  const char * LogFileName = NULL;
+  unsigned LogDeviceId = 0;
+  DCF77WarmState warm;
+  const char * StateFileName = NULL;
+  bool WarmCheck = false;           // first minute after warm start unconfirmed
+  long long WarmPrevUtc = -1;
+  DCF77NmeaPty nmea;
+  const char * NmeaLink = NULL;
+  DCF77NtpShm ntpShm;
+  int NtpShmUnit = -1;
+  long long OutSecEdge = -1;        // last second mark sent to NMEA / NTP SHM / net
+  DCF77NetSender net;
+  const char * NetDest = NULL;
+  unsigned NetId = 0;
+  DCF77NetQuality netQuality;
+  long long NetQualityAt = 0;       // last quality event
+  DCF77TimePage timePage;
+  const char * TimePageName = NULL;
+  long long TimePageAt = 0;         // last publish
+  double minJitterSum = 0.0;    // statistics for minute log
+  double minJitterMax = 0.0;
+  unsigned minPulses = 0;
+  DCF77Trace trace;
+  const char * TraceFileName = NULL;
+  int RtPriority = 0;
+  int RtCpu = -1;
+  int LockMemory = 0;
+  bool RtReported = false;
+  DCF77PortAudioSource pa;
+  DCF77AlsaCapture alsa;
+  DCF77StreamSource stream;
+  DCF77SynthSource synth;
+  DCF77AudioSource * src = &pa;
+  DCF77Notify notify;
+  DCF77Holdover holdover;
+  std::vector<float> ConvBuf;
+  long long HoldMinute = -1;        // last minute decoded or served by holdover
+  const char * SrcDevice = NULL;    // device / file name for src->open()
+  bool ScanInputs = false;
+  char ScanDevice[16];
   const char * TZStrTab[] =
   {   "Err"
     , "MESZ (UTC+2)"
@@ -138,42 +438,56 @@ int main( int argc, char *argv[] )
     , "Saturday"
   };
 
-  printf("Pa_Initialize()\n");
-  pa_error = Pa_Initialize();
-  if (pa_error != paNoError)
-    pa_error_handler (pa_error);
-  printf("Pa_Initialize() done\n\n");
-
-
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-  DeviceCount = Pa_GetDeviceCount();
-#else
-  DeviceCount = Pa_CountDevices();
-#endif
-
-  if (DeviceCount < 0 )
-    pa_error_handler(DeviceCount);
-
-  if (DeviceCount == 0)
-  {
-    fprintf (stderr, "No PortAudio devices found\n");
-    exit(0);
-  }
-
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-  DeviceNo = Pa_GetDefaultInputDevice(); /* default input device */;
-#else
-  DeviceNo = Pa_GetDefaultInputDeviceID();
-#endif
-
-  printf("Default Input Device = %d\n", DeviceNo);
-
   printf("\nParsing Command Lines Arguments\n");
   for ( argno = 1; argno < argc; ++argno )
   {
     if ( !strcmp(argv[argno], "--help") )
     {
-      printf("%s [--help] [--list] [left|right] [44100|48000] [setsystime] [<deviceno>]\n\n", argv[0]);
+      printf("%s [--help] [--list] [left|right] [invert] [44100|48000|192000] [prn <chan>] [record <file> [recdecim <n>]]\n"
+             "    [log <file> [logdevice <id>]] [state <file>] [nmea <link>] [ntpshm <unit>]\n"
+             "    [timepage <file>] [net <host:port> [netid <id>]] [trace <file>] [rtprio <prio>] [cpu <core>] [mlock]\n"
+             "    [alsa <pcm> | file <file> | stdin s16|s32|f32 | synth | scan | <deviceno>] [int16|int32]\n"
+             "    [hysteresis <frac>] [debounce <ms>] [fixedwindows] [mlbits] [trellis]\n"
+             "    [fast] [setsystime]\n\n", argv[0]);
+      printf("  invert: signal pulses go negative. detected by scan\n");
+      printf("  prn <chan>: correlate PRN phase modulation of raw 77.5 kHz signal in channel <chan>\n");
+      printf("              for fine timing of the minute edge. needs SampleRate 192000\n");
+      printf("  record <file>: record captured input with ADC timestamps to compact, seekable file\n");
+      printf("  recdecim <n>: average <n> frames per recorded frame. default: 1\n");
+      printf("  log <file>: append evaluated minutes to binary log. see dcf77-logquery\n");
+      printf("  logdevice <id>: device id for log records. default: 0\n");
+      printf("  state <file>: keep levels, sample rate and pulse statistics in <file> for a\n");
+      printf("                warm start without threshold phase. saved every valid minute\n");
+      printf("  nmea <link>: $GPRMC / $GPZDA every second on a pty, symlinked as <link>\n");
+      printf("  ntpshm <unit>: second marks as PPS samples for ntpd / chrony SHM refclock <unit>\n");
+      printf("  timepage <file>: publish time reference for lock-free readers in shared\n");
+      printf("                   memory, e.g. /dev/shm/dcf77-time. see dcf77-now\n");
+      printf("  net <host:port>: send minutes, second marks and reception quality to\n");
+      printf("                   dcf77-aggregate, which votes over several receivers\n");
+      printf("  netid <id>: id of this receiver for dcf77-aggregate. default: 0\n");
+      printf("  trace <file>: trace capture callback and evaluation; written as Chrome/Perfetto\n");
+      printf("                JSON at exit. SIGUSR1 toggles tracing, SIGUSR2 writes file now\n");
+      printf("  rtprio <prio>: run capture and decoding with SCHED_FIFO priority 1 .. 99\n");
+      printf("  cpu <core>: pin capture and decoding thread to core\n");
+      printf("  mlock: lock all memory, so that the capture thread never page faults\n");
+      printf("  alsa <pcm>: capture with native ALSA mmap access instead of PortAudio,\n");
+      printf("              e.g. 'alsa hw:1,0'. uses driver timestamps\n");
+      printf("  file <file>: replay WAV (int16/float32) or raw int16 file in real time\n");
+      printf("  stdin s16|s32|f32: read WAV or raw little endian samples from stdin\n");
+      printf("  synth: decode a synthetic signal of the current time (testing)\n");
+      printf("  scan: capture a few seconds from all PortAudio inputs at once, rank their\n");
+      printf("        channels by their 1 Hz pulse train and take the best one\n");
+      printf("  <deviceno>: PortAudio input device. default: default input device\n");
+      printf("  int16|int32: capture integer samples instead of float32 (PortAudio, ALSA).\n");
+      printf("               decoded without conversion\n");
+      printf("  hysteresis <frac>: low threshold below high by <frac> of Max - Mean. default 0.3\n");
+      printf("  debounce <ms>: minimum dwell beyond a threshold for an edge. default 0.5\n");
+      printf("  fixedwindows: nominal pulse windows instead of learned ones\n");
+      printf("  mlbits: bit of higher likelihood of learned pulse widths instead of windows\n");
+      printf("  trellis: decode minutes by a Viterbi search over second grid and bits;\n");
+      printf("           tolerates missing and noisy pulses without resync\n");
+      printf("  fast: report the last minute mark from partial frames as soon as minute,\n");
+      printf("        hour and date are known, up to a minute earlier after (re)sync\n\n");
     }
     else if ( !strcmp(argv[argno], "--list") )
       ListDevices = 1;
@@ -187,6 +501,16 @@ int main( int argc, char *argv[] )
       data.ChanIdx = 1;
       printf("Channl := Right (=1)\n");
     }
+    else if ( !strcmp(argv[argno], "invert") )
+    {
+      data.Invert = true;
+      printf("Polarity := inverted\n");
+    }
+    else if ( !strcmp(argv[argno], "scan") )
+    {
+      ScanInputs = true;
+      printf("Input := scan of all PortAudio inputs\n");
+    }
     else if ( !strcmp(argv[argno], "48000") )
     {
       data.SampleRate = atof(argv[argno]);
@@ -199,159 +523,355 @@ int main( int argc, char *argv[] )
       data.FramesPerBuffer = 441; // = 10 * 44100 / 1000 == 10 ms
       printf("SampleRate := %f\n", data.SampleRate);
     }
+    else if ( !strcmp(argv[argno], "192000") )
+    {
+      data.SampleRate = atof(argv[argno]);
+      data.FramesPerBuffer = 1920; // = 10 * 192000 / 1000 == 10 ms
+      printf("SampleRate := %f\n", data.SampleRate);
+    }
+    else if ( !strcmp(argv[argno], "prn") && argno +1 < argc )
+    {
+      PrnChanIdx = atoi(argv[++argno]);
+      printf("PRN Channel := %d\n", PrnChanIdx);
+    }
+    else if ( !strcmp(argv[argno], "record") && argno +1 < argc )
+    {
+      RecFileName = argv[++argno];
+      printf("Record to := %s\n", RecFileName);
+    }
+    else if ( !strcmp(argv[argno], "recdecim") && argno +1 < argc )
+    {
+      rec.Decimation = (unsigned)atoi(argv[++argno]);
+      printf("Record Decimation := %u\n", rec.Decimation);
+    }
+    else if ( !strcmp(argv[argno], "log") && argno +1 < argc )
+    {
+      LogFileName = argv[++argno];
+      printf("Minute Log := %s\n", LogFileName);
+    }
+    else if ( !strcmp(argv[argno], "logdevice") && argno +1 < argc )
+    {
+      LogDeviceId = (unsigned)atoi(argv[++argno]);
+      printf("Minute Log Device := %u\n", LogDeviceId);
+    }
+    else if ( !strcmp(argv[argno], "state") && argno +1 < argc )
+    {
+      StateFileName = argv[++argno];
+      printf("State File := %s\n", StateFileName);
+    }
+    else if ( !strcmp(argv[argno], "nmea") && argno +1 < argc )
+    {
+      NmeaLink = argv[++argno];
+      printf("NMEA pty := %s\n", NmeaLink);
+    }
+    else if ( !strcmp(argv[argno], "ntpshm") && argno +1 < argc )
+    {
+      NtpShmUnit = atoi(argv[++argno]);
+      printf("NTP SHM unit := %d\n", NtpShmUnit);
+    }
+    else if ( !strcmp(argv[argno], "timepage") && argno +1 < argc )
+    {
+      TimePageName = argv[++argno];
+      printf("Time Page := %s\n", TimePageName);
+    }
+    else if ( !strcmp(argv[argno], "net") && argno +1 < argc )
+    {
+      NetDest = argv[++argno];
+      printf("Aggregator := %s\n", NetDest);
+    }
+    else if ( !strcmp(argv[argno], "netid") && argno +1 < argc )
+    {
+      NetId = (unsigned)atoi(argv[++argno]);
+      printf("Receiver Id := %u\n", NetId);
+    }
+    else if ( !strcmp(argv[argno], "trace") && argno +1 < argc )
+    {
+      TraceFileName = argv[++argno];
+      printf("Trace to := %s\n", TraceFileName);
+    }
+    else if ( !strcmp(argv[argno], "rtprio") && argno +1 < argc )
+    {
+      RtPriority = atoi(argv[++argno]);
+      printf("Realtime Priority := %d\n", RtPriority);
+    }
+    else if ( !strcmp(argv[argno], "cpu") && argno +1 < argc )
+    {
+      RtCpu = atoi(argv[++argno]);
+      printf("Capture CPU := %d\n", RtCpu);
+    }
+    else if ( !strcmp(argv[argno], "mlock") )
+    {
+      LockMemory = 1;
+    }
+    else if ( !strcmp(argv[argno], "alsa") && argno +1 < argc )
+    {
+      src = &alsa;
+      SrcDevice = argv[++argno];
+      printf("ALSA Device := %s\n", SrcDevice);
+    }
+    else if ( !strcmp(argv[argno], "file") && argno +1 < argc )
+    {
+      src = &stream;
+      SrcDevice = argv[++argno];
+      printf("Input File := %s\n", SrcDevice);
+    }
+    else if ( !strcmp(argv[argno], "stdin") && argno +1 < argc )
+    {
+      src = &stream;
+      SrcDevice = "-";
+      ++argno;
+      stream.Format = !strcmp(argv[argno], "f32") ? DCF77AudioSource::FMT_FLOAT32
+                    : !strcmp(argv[argno], "s32") ? DCF77AudioSource::FMT_INT32 : DCF77AudioSource::FMT_INT16;
+      printf("Input := stdin, %s\n", argv[argno]);
+    }
+    else if ( !strcmp(argv[argno], "synth") )
+    {
+      src = &synth;
+      printf("Input := synthetic signal\n");
+    }
+    else if ( !strcmp(argv[argno], "int16") || !strcmp(argv[argno], "int32") )
+    {
+      pa.Format = alsa.Format = ( '1' == argv[argno][3] ) ? DCF77AudioSource::FMT_INT16 : DCF77AudioSource::FMT_INT32;
+      printf("Sample Format := %s\n", argv[argno]);
+    }
+    else if ( !strcmp(argv[argno], "hysteresis") && argno +1 < argc )
+    {
+      data.Hysteresis = (float)atof(argv[++argno]);
+      printf("Hysteresis := %.3f\n", data.Hysteresis);
+    }
+    else if ( !strcmp(argv[argno], "debounce") && argno +1 < argc )
+    {
+      data.DebounceMs = (float)atof(argv[++argno]);
+      printf("Debounce := %.3f ms\n", data.DebounceMs);
+    }
+    else if ( !strcmp(argv[argno], "fixedwindows") )
+    {
+      data.AdaptiveWindows = false;
+      printf("Adaptive Windows := off\n");
+    }
+    else if ( !strcmp(argv[argno], "mlbits") )
+    {
+      data.MLBits = true;
+      printf("Maximum Likelihood Bits := on\n");
+    }
+    else if ( !strcmp(argv[argno], "trellis") )
+    {
+      data.UseTrellis = true;
+      printf("Trellis Decoding := on\n");
+    }
+    else if ( !strcmp(argv[argno], "fast") )
+    {
+      data.FastFix = true;
+      printf("Fast Fix := on\n");
+    }
     else if ( !strcmp(argv[argno], "setsystime") )
     {
       data.SetSysTime = 1;
     }
-    else
+    else if ( argv[argno][0] >= '0' && argv[argno][0] <= '9' )
     {
-      int tmp = atoi(argv[argno]);
-      if ( tmp >= 0 && tmp < DeviceCount )
-      {
-        DeviceNo = tmp;
-      }
-      else
-        fprintf(stderr, "ignoring argument '%s'! DeviceNo not in Range 0 .. %d\n", argv[argno], DeviceCount-1 );
+      src = &pa;
+      SrcDevice = argv[argno];
     }
+    else
+      fprintf(stderr, "ignoring argument '%s'!\n", argv[argno] );
   }
   printf("End of Parsing Command Lines Arguments\n\n");
 
-  if ( ListDevices )
-  {
-    printf("\n\nListing Devices\n");
-    int i;
-    for ( i = 0; i < DeviceCount; ++i )
-    {
-      const PaDeviceInfo *device_info = Pa_GetDeviceInfo(i);
+  ctx.dcf = &data;
+  ctx.prn = NULL;
+  ctx.rec = NULL;
+  ctx.trace = NULL;
+  ctx.MonotonicAdcTime = false;
+  ctx.Format = DCF77AudioSource::FMT_FLOAT32;
+  ctx.Conv = NULL;
+  ctx.ConvFrames = 0;
+  ctx.notify = &notify;
 
-      printf("%d: %s\n", i, device_info->name);
-      printf("  maxInputChannels = %d\n", device_info->maxInputChannels);
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-      printf("  default SampleRate = %f\n", device_info->defaultSampleRate);
+  if ( !notify.open( stderr ) )
+    return 1;
+#ifndef _MSC_VER
+  SignalNotify = &notify;
 #endif
+  ctx.RtPriority = RtPriority;
+  ctx.RtCpu = RtCpu;
+  ctx.RtDone = false;
+  ctx.RtOk = true;
+  ctx.RtErr[0] = 0;
 
-      if (device_info->maxInputChannels < 1)
-        continue;
-
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-
-      PaStreamParameters input_param;
-
-      memset (&input_param, sizeof(input_param), 0);
-
-      input_param.device = i;
-      input_param.channelCount = data.ChanCount = device_info->maxInputChannels;
-      input_param.sampleFormat = paFloat32;
-      input_param.hostApiSpecificStreamInfo = NULL;
-
-      pa_error = Pa_IsFormatSupported(&input_param, NULL, data.SampleRate);
-      if (pa_error == paFormatIsSupported)
-        printf ("  supports SampleRate and Format\n");
-      else
-      {
-        printf ("  does NOT support SampleRate and Format\n");
-        printf ("  PortAudio error: %s\n", Pa_GetErrorText(pa_error));
-      }
-
+  if ( TraceFileName )
+  {
+    // ~ 20 minutes of events with 10 ms buffers
+    if ( trace.init( 1 << 18 ) )
+    {
+      trace.Enabled = true;
+      ctx.trace = &trace;
+#ifndef _MSC_VER
+      signal( SIGUSR1, traceSignalHandler );
+      signal( SIGUSR2, traceSignalHandler );
 #endif
+    }
+    else
+      fprintf(stderr, "ignoring trace! could not allocate trace buffer\n");
+  }
 
+  if ( LogFileName && !minLog.open( LogFileName, stderr ) )
+    LogFileName = NULL;
 
-    }
+  if ( NmeaLink )
+  {
+    if ( nmea.open( NmeaLink, stderr ) )
+      printf("NMEA output on %s -> %s\n", NmeaLink, nmea.slaveName());
+  }
+  if ( NtpShmUnit >= 0 && ntpShm.open( NtpShmUnit, stderr ) )
+    printf("NTP SHM unit %d\n", NtpShmUnit);
+  if ( TimePageName && timePage.create( TimePageName, stderr ) )
+    printf("Time page %s\n", TimePageName);
+  if ( NetDest && net.open( NetDest, NetId, stderr ) )
+    printf("Events to aggregator %s as receiver %u\n", NetDest, NetId);
+  memset( &netQuality, 0, sizeof(netQuality) );
+
+  if ( ListDevices )
+  {
+    printf("\n\nListing Devices\n");
+    DCF77PortAudioSource::listDevices( stdout, data.SampleRate, stderr );
     printf("End of Listing Devices\n\n\n");
   }
 
-  do
+  if ( ScanInputs )
   {
-    int i = DeviceNo;
-    const PaDeviceInfo *device_info = Pa_GetDeviceInfo(i);
+    if ( src != &pa )
+      fprintf(stderr, "ignoring scan! only for PortAudio devices\n");
+    else if ( !scanInputs( &data, ScanDevice, sizeof(ScanDevice) ) )
+      goto done;
+    else
+      SrcDevice = ScanDevice;
+  }
 
-    printf("%d: %s\n", i, device_info->name);
-    printf("  maxInputChannels = %d\n", device_info->maxInputChannels);
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-    printf("  default SampleRate = %f\n", device_info->defaultSampleRate);
-#endif
+  {
+    data.frameIndex = 0;
 
-    if (device_info->maxInputChannels < 1)
-      break;
+    if ( PrnChanIdx >= 0 && ( data.ChanCount <= (unsigned)PrnChanIdx || data.ChanCount <= data.ChanIdx ) )
+      data.ChanCount = ( (unsigned)PrnChanIdx > data.ChanIdx ? PrnChanIdx : data.ChanIdx ) + 1;
 
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-    PaStreamParameters input_param;
-    memset (&input_param, sizeof(input_param), 0);
+    src->SampleRate = data.SampleRate;
+    src->ChanCount = data.ChanCount;
+    src->FramesPerBuffer = data.FramesPerBuffer;
+    if ( src == &synth )
+    {
+      // second marks aligned to the host clock
+      synth.Synth.ChanIdx = data.ChanIdx;
+      synth.Synth.StartTime = (long long)time(NULL) + 1;
+    }
+    if ( !src->open( SrcDevice, stderr ) )
+      goto done;
+    // file and stream sources bring their own format
+    data.SampleRate = src->SampleRate;
+    data.ChanCount = src->ChanCount;
+    data.FramesPerBuffer = src->FramesPerBuffer;
+    if ( data.ChanIdx >= data.ChanCount )
+    {
+      fprintf(stderr, "Error: channel %u not available in %u channel input\n", data.ChanIdx, data.ChanCount);
+      goto done;
+    }
+    ctx.MonotonicAdcTime = src->MonotonicAdcTime;
+    ctx.Format = src->Format;
+    if ( DCF77AudioSource::FMT_FLOAT32 != ctx.Format )
+    {
+      ConvBuf.assign( (size_t)data.FramesPerBuffer * data.ChanCount, 0.0F );
+      ctx.Conv = &ConvBuf[0];
+      ctx.ConvFrames = data.FramesPerBuffer;
+    }
 
-    input_param.device = i;
-    input_param.channelCount = device_info->maxInputChannels;
-    input_param.sampleFormat = paFloat32;
-    input_param.hostApiSpecificStreamInfo = NULL;
+    if ( src == &pa )
+      printf("PortAudio Device %d: %s\n", pa.DeviceNo, pa.DeviceName);
+    else if ( src == &alsa )
+      printf("ALSA: period %u frames, directly from DMA ring\n", alsa.FramesPerBuffer);
+    printf("Input: %s, %.0f Hz, %u channels, %u frames per buffer, %s\n"
+          , src->name(), data.SampleRate, data.ChanCount, data.FramesPerBuffer
+          , DCF77AudioSource::FMT_INT16 == ctx.Format ? "int16"
+          : DCF77AudioSource::FMT_INT32 == ctx.Format ? "int32" : "float32");
 
-    pa_error = Pa_IsFormatSupported(&input_param, NULL, data.SampleRate);
-    if (pa_error == paFormatIsSupported)
-      printf ("  supports SampleRate and Format\n");
-    else
+    if ( StateFileName && warm.load( StateFileName, stderr ) )
     {
-      printf ("  does NOT support SampleRate and Format\n");
-      printf ("  PortAudio error: %s\n", Pa_GetErrorText(pa_error));
+      if ( warm.toDecoder( data ) )
+      {
+        WarmCheck = true;
+        printf("Warm start from %s\n", StateFileName);
+        printf(" => Threshold = %.3f / %.3f (high / low)\n", data.Threshold, data.ThresholdLow);
+        if ( data.MeasuredRate > 0.0 )
+          printf(" => Sample clock: %.3f Hz (%+.2f ppm)\n", data.MeasuredRate, data.MeasuredRatePpm);
+      }
+      else
+        fprintf(stderr, "ignoring state file! saved for other rate, channel or polarity\n");
     }
-#endif
-  } while (0);
-
-  {
-    PaStream*           stream;
-    PaError             err = paNoError;
 
-    data.frameIndex = 0;
+    if ( PrnChanIdx >= 0 )
+    {
+      if ( data.SampleRate < 2.0 * prn.CarrierFreq )
+        fprintf(stderr, "ignoring prn! SampleRate %f too low for carrier %f\n", data.SampleRate, prn.CarrierFreq);
+      else if ( (unsigned)PrnChanIdx >= data.ChanCount )
+        fprintf(stderr, "ignoring prn! channel %d not available\n", PrnChanIdx);
+      else
+      {
+        prn.SampleRate = data.SampleRate;
+        prn.ChanCount = data.ChanCount;
+        prn.ChanIdx = PrnChanIdx;
+        prn.initCorrelation();
+        ctx.prn = &prn;
+      }
+    }
 
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-    PaStreamParameters  inputParameters;
-    inputParameters.device = DeviceNo;
-    inputParameters.channelCount = data.ChanCount;
-    inputParameters.sampleFormat = paFloat32;
-    inputParameters.suggestedLatency = Pa_GetDeviceInfo( inputParameters.device )->defaultLowInputLatency;
-    inputParameters.hostApiSpecificStreamInfo = NULL;
-
-    /* Record some audio. -------------------------------------------- */
-    err = Pa_OpenStream(
-              &stream
-            , &inputParameters
-            , NULL                  /* &outputParameters, */
-            , data.SampleRate
-            , data.FramesPerBuffer
-            , paClipOff      /* we won't output out of range samples so don't bother clipping them */
-            , recordCallback
-            , &data
-            );
-#else
-    err = Pa_OpenStream(
-              &stream
-            , DeviceNo   // inputDevice
-            , data.ChanCount     // numInputChannels
-            , paFloat32  // inputSampleFormat
-            , NULL       // void *inputDriverInfo
-            , paNoDevice // outputDevice
-            , 0          // numOutputChannels
-            , 0          // outputSampleFormat
-            , NULL       // void *outputDriverInfo
-            , data.SampleRate // sampleRate
-            , data.FramesPerBuffer // framesPerBuffer
-            , (int)ceil(data.SampleRate * 0.100 / (double)data.FramesPerBuffer) // numberOfBuffers
-            , paNoFlag   // streamFlags
-            , recordCallback // PortAudioCallback *callback
-            , &data      // void *userData
-            );
-#endif
+    if ( RecFileName )
+    {
+      rec.SampleRate = data.SampleRate;
+      rec.ChanCount = data.ChanCount;
+      rec.MaxFramesPerBuffer = data.FramesPerBuffer;
+      if ( rec.open( RecFileName, stderr ) )
+        ctx.rec = &rec;
+    }
 
-    if( err != paNoError ) goto done;
+    // after all allocations: recorder ring, PRN buffers, trace ring and source
+    if ( LockMemory )
+    {
+      if ( dcf77LockMemory( stderr ) )
+        printf("Memory locked\n");
+      else
+        fprintf(stderr, "Warning: continuing without locked memory\n");
+    }
 
-    err = Pa_StartStream( stream );
-    if( err != paNoError ) goto done;
+    if ( !src->start( sourceCallback, &ctx, stderr ) )
+      goto done;
     printf("\n\nNow recording!!\n"); fflush(stdout);
 
-#if ( PORTAUDIO_LIB_VERSION >= VER_19 )
-    while( 1 == ( err = Pa_IsStreamActive( stream ) ) )
-#else
-    while( 1 == ( err = Pa_StreamActive( stream ) ) )
-#endif
+    // sleep until the capture thread or a signal has work for us. the
+    // timeout is for housekeeping: end of source, recorder drops
+    while ( src->isRunning() )
     {
-      Pa_Sleep(100);
+      int waitMs = 1000;
+      double holdUtc, holdSigma;
+
+      // without decode 1 s after a minute edge: serve it from holdover
+      if ( holdover.estimate( 1E-9 * DCF77Trace::now(), &holdUtc, &holdSigma ) )
+      {
+        const double due = ( HoldMinute + 1 ) * 60.0 + 1.0;
+        if ( holdUtc >= due )
+        {
+          const long long minute = (long long)floor( holdUtc / 60.0 );
+          const time_t tim = (time_t)( minute * 60 );
+          const struct tm * utm = gmtime( &tim );
+          fprintf(stdout, "Holdover: %04d-%02d-%02d  Time: %02d:%02d  UTC  +/- %.1f ms  (%.0f min without fix)\n"
+                        , utm->tm_year + 1900, utm->tm_mon +1, utm->tm_mday, utm->tm_hour, utm->tm_min
+                        , 1000.0 * holdSigma
+                        , ( 1E-9 * DCF77Trace::now() - holdover.LastFixLocal ) / 60.0 );
+          fflush(stdout);
+          HoldMinute = minute;
+        }
+        else if ( ( due - holdUtc ) * 1000.0 < waitMs )
+          waitMs = (int)( ( due - holdUtc ) * 1000.0 ) + 1;
+      }
+
+      notify.wait( waitMs );
 
       if ( data.ThreshStartMessage )
       {
@@ -363,22 +883,116 @@ int main( int argc, char *argv[] )
       if ( data.ThreshFinishMessage )
       {
         fprintf(stdout, " => Mean = %.3f\n", data.Mean );
-        fprintf(stdout, " => Threshold = %.3f\n", data.Threshold);
+        fprintf(stdout, " => Threshold = %.3f / %.3f (high / low)\n", data.Threshold, data.ThresholdLow);
         fprintf(stdout, " => Max  = %.3f\n\n", data.Max );
         fflush(stdout);
         data.ThreshFinishMessage = false;
       }
 
+      if ( ctx.prn )
+      {
+        if ( data.SecEdgeFrame != PrnHintFrame )
+        {
+          PrnHintFrame = data.SecEdgeFrame;
+          prn.setSecondHint( PrnHintFrame );
+        }
+        if ( prn.NewEpoch )
+        {
+          prn.NewEpoch = false;
+          if ( prn.EpochValid )
+            data.setPrnEpoch( prn.EpochFrame );
+        }
+      }
+
+      // status changes and holdover at least every second; new references
+      // right after a valid minute, below
+      if ( timePage.isOpen() && DCF77Trace::now() - TimePageAt >= 1000000000LL )
+      {
+        TimePageAt = DCF77Trace::now();
+        publishTimePage( timePage, holdover, data );
+      }
+
+      // NMEA / NTP SHM: each new second mark, UTC from the holdover model.
+      // aggregator: second mark on the host clock
+      if ( ( nmea.isOpen() || ntpShm.isOpen() || net.isOpen() ) && data.SecEdgeFrame != OutSecEdge )
+      {
+        double secLocal, secUtc, secSigma;
+        OutSecEdge = data.SecEdgeFrame;
+        secLocal = src->MonotonicAdcTime ? data.adcTimeOfFrame( OutSecEdge ) : 0.0;
+        if ( secLocal <= 0.0 )
+          secLocal = 1E-9 * DCF77Trace::now() - ( data.TotalFrames - OutSecEdge ) / data.frameRate();
+        const double realNow = std::chrono::duration<double>( std::chrono::system_clock::now().time_since_epoch() ).count();
+        if ( OutSecEdge >= 0 && data.SecInMinute >= 0 )
+          net.second( (long long)( 1E9 * ( realNow - ( 1E-9 * DCF77Trace::now() - secLocal ) ) ), data.SecInMinute );
+        // noise edges are off the second
+        if ( OutSecEdge >= 0 && holdover.estimate( secLocal, &secUtc, &secSigma )
+          && fabs( secUtc - floor( secUtc + 0.5 ) ) < 0.05 )
+        {
+          const long long sec = (long long)floor( secUtc + 0.5 );
+          // from a recent valid minute, else holdover only
+          const bool fresh = ( secLocal - holdover.LastFixLocal < 120.0 );
+          nmea.second( sec, fresh );
+          if ( fresh )
+            ntpShm.pulse( sec, realNow - ( 1E-9 * DCF77Trace::now() - secLocal ) );
+        }
+      }
+
+      if ( net.isOpen() && DCF77Trace::now() - NetQualityAt >= 10000000000LL )
+      {
+        double utc, sigma;
+        NetQualityAt = DCF77Trace::now();
+        netQuality.State = data.eState;
+        netQuality.Signal = ( DCF77::STATE_GET_TIME == data.eState && data.FramesSinceLastPulse < 2.0 * data.SampleRate );
+        netQuality.RatePpm = (float)data.MeasuredRatePpm;
+        netQuality.Threshold = data.Threshold;
+        netQuality.HoldSigmaMs = holdover.estimate( 1E-9 * NetQualityAt, &utc, &sigma ) ? (float)( 1000.0 * sigma ) : -1.0F;
+        net.quality( netQuality );
+      }
+
+      if ( ctx.RtDone && !RtReported )
+      {
+        RtReported = true;
+        if ( !ctx.RtOk )
+          fprintf(stderr, "Warning: real-time setup of capture thread incomplete: %s\n", ctx.RtErr);
+        else if ( RtPriority > 0 || RtCpu >= 0 )
+          printf("Capture thread: priority %d, cpu %d\n", RtPriority, RtCpu);
+      }
+
+#ifndef _MSC_VER
+      if ( ctx.trace && TraceToggleReq )
+      {
+        TraceToggleReq = 0;
+        trace.Enabled = !trace.Enabled;
+        fprintf(stderr, "Tracing %s\n", trace.Enabled ? "enabled" : "disabled");
+      }
+      if ( ctx.trace && TraceDumpReq )
+      {
+        TraceDumpReq = 0;
+        if ( trace.dump( TraceFileName, stderr ) )
+          fprintf(stderr, "Trace written to %s\n", TraceFileName);
+      }
+#endif
+
+      if ( ctx.rec && rec.DroppedBuffers != RecDroppedReported )
+      {
+        RecDroppedReported = rec.DroppedBuffers;
+        fprintf(stderr, "Warning: recorder dropped %u buffers\n", RecDroppedReported);
+      }
+
       if ( data.PrintDiff )
       {
         data.PrintDiff = 0;
         if ( data.aiDiffFrames[1-data.iDiffIdx] > data.aiDiffFrames[data.iDiffIdx] )
         {
-          double jitter = data.SampleRate - data.aiDiffFrames[0] - data.aiDiffFrames[1];
-          if ( fabs(jitter) < 0.5*data.SampleRate )
+          double jitter = data.frameRate() - data.aiDiffFrames[0] - data.aiDiffFrames[1];
+          if ( fabs(jitter) < 0.5*data.frameRate() )
           {
             sumJitter += jitter;
             cntJitter += 1.0;
+            minJitterSum += fabs(jitter);
+            if ( fabs(jitter) > minJitterMax )
+              minJitterMax = fabs(jitter);
+            ++minPulses;
 #if 0
             double meanJitter = sumJitter / cntJitter;
             fprintf(stdout, "Pulse: %.1f %.1f\n", jitter, meanJitter );
@@ -386,17 +1000,104 @@ int main( int argc, char *argv[] )
           }
         }
       }
-      if ( !data.EvaluatedMinPulse )
+      // fast fix: last minute mark from partial frames, before this frame completes
+      bool fastFix = false;
+      if ( data.FastFixPending )
+      {
+        data.FastFixPending = false;
+        fastFix = data.EvaluatedMinPulse && !data.FastFixDone;
+      }
+      if ( !data.EvaluatedMinPulse || fastFix )
       {
         struct tm tms;
         int DCF_TZ_idx;
         // int Year, Month, Day, Weekday, Hour, Minute;
-        if (data.evalMinPulse(&tms,&DCF_TZ_idx,stderr))
+        const long long tEval = DCF77Trace::now();
+        // age of decision: time since minute edge
+        const long long minAge = (long long)( 1E9 * data.FramesSinceLastMinPulse / data.frameRate() );
+        const bool evalOk = fastFix ? data.evalFastFix(&tms,&DCF_TZ_idx,stderr)
+                                    : data.evalMinPulse(&tms,&DCF_TZ_idx,stderr);
+        if ( fastFix && !evalOk )
+          continue;   // fields still missing
+        if ( ( LogFileName || net.isOpen() ) && !fastFix )
+        {
+          DCF77MinuteRecord logRec;
+          logRec.fromDecoder( data, &tms, DCF_TZ_idx, evalOk );
+          logRec.DeviceId = LogDeviceId;
+          logRec.JitterMeanMs = (float)( minPulses ? 1000.0 * minJitterSum / minPulses / data.frameRate() : 0.0 );
+          logRec.JitterMaxMs = (float)( 1000.0 * minJitterMax / data.frameRate() );
+          logRec.PulseCount = minPulses;
+          if ( LogFileName && !minLog.append( logRec ) )
+            fprintf(stderr, "Error writing minute log\n");
+          net.minute( logRec );
+          if ( evalOk )
+            ++netQuality.ValidMinutes;
+          else
+            ++netQuality.FailedMinutes;
+        }
+        if ( !fastFix )
+        {
+          minJitterSum = minJitterMax = 0.0;
+          minPulses = 0;
+        }
+        trace.add( DCF77Trace::EV_EVAL, TRACE_TID_MAIN, tEval, DCF77Trace::now(), 0, minAge );
+        if ( evalOk )
         {
+          data.FastFixDone = true;
+          // seconds since minute edge, PRN corrected if available
+          const double sinceEdge = ( data.FramesSinceLastMinPulse
+                                   - ( data.PrnCorrValid ? data.PrnCorrFrames : 0.0 ) ) / data.frameRate();
+          // local time of minute edge: from ADC timestamps, if on steady clock
+          double edgeLocal = src->MonotonicAdcTime ? data.adcTimeOfMinEdge() : 0.0;
+          if ( edgeLocal <= 0.0 )
+            edgeLocal = 1E-9 * tEval - sinceEdge;
+          const long long utc = dcf77ToUtc( &tms, DCF_TZ_idx );
+          const long long hostEdge = (long long)time(NULL) - (long long)sinceEdge;
+          // after a warm start: first minute as expected by the host clock,
+          // else confirmed by the following one
+          if ( WarmCheck )
+          {
+            const long long expected = warm.expectedUtc( hostEdge );
+            if ( ( expected >= 0 && llabs( utc - expected ) <= 120 )
+              || ( WarmPrevUtc >= 0 && utc - WarmPrevUtc >= 60 && utc - WarmPrevUtc <= 120 ) )
+              WarmCheck = false;
+            else
+            {
+              fprintf(stderr, "Warning: %04d-%02d-%02d %02d:%02d not as expected after warm start, waiting for next minute\n"
+                            , tms.tm_year + 1900, tms.tm_mon +1, tms.tm_mday, tms.tm_hour, tms.tm_min);
+              WarmPrevUtc = utc;
+              if ( !fastFix )
+                data.EvaluatedMinPulse = true;
+              continue;
+            }
+          }
+          if ( StateFileName && !fastFix )
+          {
+            warm.fromDecoder( data, utc, hostEdge );
+            warm.save( StateFileName, stderr );
+          }
+          if ( holdover.addFix( edgeLocal, utc ) )
+          {
+            HoldMinute = utc / 60;
+            if ( timePage.isOpen() )
+            {
+              TimePageAt = DCF77Trace::now();
+              publishTimePage( timePage, holdover, data );
+            }
+            if ( holdover.Fixes > 1 )
+              fprintf(stdout, "Holdover model: %+.3f ppm, drift %+.3f ppm/day, %u fixes\n"
+                            , holdover.freqPpm(), holdover.driftPpmPerDay(), holdover.Fixes );
+          }
+          else
+            fprintf(stderr, "Warning: minute off holdover prediction by %.1f ms, ignored by model\n"
+                          , 1000.0 * holdover.LastInnovation );
+
           if (data.SetSysTime)
           {
+            const long long tSet = DCF77Trace::now();
             time_t tim;
-            tim = mktime(&tms);
+            // plus seconds since minute edge: ~ 30 for fast fix
+            tim = mktime(&tms) + (time_t)sinceEdge;
 #ifdef _MSC_VER
             tms = * gmtime(&tim); // convert to UTC
             // and set to Windows system time structure
@@ -415,34 +1116,62 @@ int main( int argc, char *argv[] )
             if ( -1 == stime(&tim))
               fprintf(stderr, "Error setting system time: '%s'\n", strerror(errno) );
 #endif
+            trace.add( DCF77Trace::EV_SETTIME, TRACE_TID_MAIN, tSet, DCF77Trace::now(), 0
+                     , minAge + DCF77Trace::now() - tEval );
           }
-          fprintf(stdout, "Date: %s, %04d-%02d-%02d  Time: %02d:%02d  %s  %f ms\n"
+          fprintf(stdout, "%sDate: %s, %04d-%02d-%02d  Time: %02d:%02d  %s  %f ms\n"
+                        , fastFix ? "Fast fix: " : ""
                         , WeekDayStrTab[tms.tm_wday], tms.tm_year + 1900, tms.tm_mon +1, tms.tm_mday
                         , tms.tm_hour, tms.tm_min
                         , TZStrTab[DCF_TZ_idx]
-                        , (1000.0 * data.FramesSinceLastMinPulse / data.SampleRate)
+                        , (1000.0 * data.FramesSinceLastMinPulse / data.frameRate())
                         );
+          if ( data.MeasuredRate > 0.0 )
+            fprintf(stdout, "  Sample clock: %.3f Hz (%+.2f ppm)\n", data.MeasuredRate, data.MeasuredRatePpm );
+          if ( data.AdaptiveWindows )
+            fprintf(stdout, "  Pulses: %.1f / %.1f ms +/- %.1f / %.1f ms, marks +/- %.1f ms\n"
+                          , 100.0F + data.PulseOffsetMs, 200.0F + data.PulseOffsetMs
+                          , data.PulseSigmaMs[0], data.PulseSigmaMs[1], data.GapSigmaMs );
+          if ( data.UseTrellis && !fastFix )
+            fprintf(stdout, "  Trellis: margin %.1f, %u bits from parity\n"
+                          , data.Trellis.Margin, data.Trellis.RecoveredBits );
+          if ( data.PrnCorrValid )
+            fprintf(stdout, "  PRN corrected: %f ms  (correction %+.1f us)\n"
+                          , 1000.0 * sinceEdge
+                          , 1000000.0 * data.PrnCorrFrames / data.frameRate()
+                          );
           if (data.SetSysTime)
             goto done;
         }
-        data.EvaluatedMinPulse = true;
+        if ( !fastFix )
+          data.EvaluatedMinPulse = true;
         fflush(stdout);
-      } // end if ( !data.EvaluatedMinPulse )
-    } // end while( 1 == ( err = Pa_StreamActive( stream ) ) )
+      } // end if ( !data.EvaluatedMinPulse || fastFix )
+    } // end while source is running
+  }
 
-    if( err < 0 )
-      goto done;
+done:
 
-    err = Pa_CloseStream( stream );
-    if( err != paNoError )
-      goto done;
+  src->stop();
+#ifndef _MSC_VER
+  SignalNotify = NULL;
+#endif
+  if ( src == &alsa && alsa.Xruns )
+    fprintf(stderr, "Warning: ALSA capture had %u overruns\n", alsa.Xruns);
+  src->close();
 
+  if ( ctx.trace )
+  {
+    trace.Enabled = false;
+    if ( trace.dump( TraceFileName, stderr ) )
+      printf("Trace written to %s\n", TraceFileName);
   }
 
-done:
-
-  printf("\n\nPa_Terminate()\n");
-  Pa_Terminate();
+  if ( ctx.rec )
+  {
+    rec.close();
+    printf("Recorded %lld frames to %s\n", (long long)rec.WrittenFrames, RecFileName);
+  }
 
   return 0;
 }
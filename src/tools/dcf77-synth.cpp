@@ -0,0 +1,203 @@
+/*
+ * U77,5 - a set of USB sound / DCF77 tools
+ * Copyright (C) 2008 Hayati Ayguen <h_ayguen@web.de>
+ * License: GNU LGPL (GNU Lesser Public License, see COPYING)
+ *
+ * This file is part of U77,5.
+ *
+ * U77,5 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * U77,5 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with U77,5.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "../dcf77/dcf77synth.h"
+#include "../dcf77/dcf77bytes.h"
+
+
+// writes a synthetic DCF77 receiver signal as float32 WAV file.
+// ground truth (frame of each minute mark and its UTC time) goes to stdout
+
+static bool writeWavHeader( FILE * fp, unsigned rate, unsigned chans, unsigned long long frames )
+{
+  unsigned char h[44];
+  const unsigned long long dataBytes = frames * chans * 4;
+  if ( dataBytes > 0xFFFFFFFFULL - 36 )
+    return false;
+  memcpy( h, "RIFF", 4 );
+  put32( h + 4, (unsigned)( 36 + dataBytes ) );
+  memcpy( h + 8, "WAVEfmt ", 8 );
+  put32( h + 16, 16 );
+  put16( h + 20, 3 );     // IEEE float
+  put16( h + 22, chans );
+  put32( h + 24, rate );
+  put32( h + 28, rate * chans * 4 );
+  put16( h + 32, chans * 4 );
+  put16( h + 34, 32 );
+  memcpy( h + 36, "data", 4 );
+  put32( h + 40, (unsigned)dataBytes );
+  return 1 == fwrite( h, sizeof(h), 1, fp );
+}
+
+
+static bool isLittleEndian()
+{
+  const unsigned one = 1;
+  return 1 == *(const unsigned char *)&one;
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int argno;
+  const char * OutFileName = NULL;
+  double Minutes = 5.0;
+  DCF77Synth syn;
+
+  for ( argno = 1; argno < argc; ++argno )
+  {
+    if ( !strcmp(argv[argno], "--help") )
+    {
+      printf("%s [options] <out.wav>\n\n", argv[0]);
+      printf("  --rate <Hz>            sample rate. default 48000\n");
+      printf("  --chans <n> --chan <i> channel count and channel with signal\n");
+      printf("  --minutes <m>          length. default 5\n");
+      printf("  --start <unixtime>     UTC of first second mark\n");
+      printf("  --offset <sec>         signal before first second mark\n");
+      printf("  --seed <n>\n");
+      printf("  --level                receiver level instead of edge spikes\n");
+      printf("  --noise <rms> --amp <a> --spike <ms>\n");
+      printf("  --fade <depth> <period sec>\n");
+      printf("  --stretch <ms> --jitter <ms> --dropout <rate>\n");
+      printf("  --impulses <per sec> <amp>\n");
+      printf("  --ppm <deviation of sample clock>\n");
+      return 0;
+    }
+    else if ( !strcmp(argv[argno], "--rate") && argno +1 < argc )
+      syn.SampleRate = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--chans") && argno +1 < argc )
+      syn.ChanCount = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--chan") && argno +1 < argc )
+      syn.ChanIdx = (unsigned)atoi(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--minutes") && argno +1 < argc )
+      Minutes = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--start") && argno +1 < argc )
+      syn.StartTime = atoll(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--offset") && argno +1 < argc )
+      syn.StartOffset = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--seed") && argno +1 < argc )
+      syn.Seed = (unsigned)strtoul(argv[++argno], NULL, 0);
+    else if ( !strcmp(argv[argno], "--level") )
+      syn.eCoupling = DCF77Synth::COUPLING_LEVEL;
+    else if ( !strcmp(argv[argno], "--noise") && argno +1 < argc )
+      syn.NoiseRms = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--amp") && argno +1 < argc )
+      syn.Amplitude = (float)atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--spike") && argno +1 < argc )
+      syn.SpikeMs = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--fade") && argno +2 < argc )
+    {
+      syn.FadeDepth = atof(argv[++argno]);
+      syn.FadePeriod = atof(argv[++argno]);
+    }
+    else if ( !strcmp(argv[argno], "--stretch") && argno +1 < argc )
+      syn.PulseStretchMs = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--jitter") && argno +1 < argc )
+      syn.EdgeJitterMs = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--dropout") && argno +1 < argc )
+      syn.DropoutRate = atof(argv[++argno]);
+    else if ( !strcmp(argv[argno], "--impulses") && argno +2 < argc )
+    {
+      syn.ImpulseRate = atof(argv[++argno]);
+      syn.ImpulseAmp = atof(argv[++argno]);
+    }
+    else if ( !strcmp(argv[argno], "--ppm") && argno +1 < argc )
+      syn.ClockPpm = atof(argv[++argno]);
+    else
+      OutFileName = argv[argno];
+  }
+
+  if ( !OutFileName )
+  {
+    fprintf(stderr, "Error: no output file given. see --help\n");
+    return 1;
+  }
+  if ( !syn.ChanCount || syn.ChanIdx >= syn.ChanCount || syn.SampleRate < 1000.0 )
+  {
+    fprintf(stderr, "Error: invalid channel or sample rate\n");
+    return 1;
+  }
+  if ( !isLittleEndian() )
+  {
+    fprintf(stderr, "Error: WAV output needs little endian host\n");
+    return 1;
+  }
+
+  const unsigned rate = (unsigned)( syn.SampleRate + 0.5 );
+  const unsigned long long totalFrames = (unsigned long long)( Minutes * 60.0 * rate );
+  const unsigned BlockFrames = 4096;
+  std::vector<float> buf( BlockFrames * syn.ChanCount );
+  unsigned long long done = 0;
+
+  FILE * fp = fopen( OutFileName, "wb" );
+  if ( !fp )
+  {
+    fprintf(stderr, "Error: could not create '%s'\n", OutFileName);
+    return 1;
+  }
+  if ( !writeWavHeader( fp, rate, syn.ChanCount, totalFrames ) )
+  {
+    fprintf(stderr, "Error: could not write '%s'\n", OutFileName);
+    fclose( fp );
+    return 1;
+  }
+
+  syn.reset();
+  while ( done < totalFrames )
+  {
+    const unsigned n = ( totalFrames - done < BlockFrames ) ? (unsigned)( totalFrames - done ) : BlockFrames;
+    syn.generate( n, &buf[0] );
+    if ( n != fwrite( &buf[0], syn.ChanCount * sizeof(float), n, fp ) )
+    {
+      fprintf(stderr, "Error: could not write '%s'\n", OutFileName);
+      fclose( fp );
+      return 1;
+    }
+    done += n;
+  }
+  fclose( fp );
+
+  // ground truth
+  long long sec;
+  for ( sec = 0; syn.secondMarkFrame( sec ) < (double)totalFrames; ++sec )
+  {
+    const long long utc = syn.StartTime + sec;
+    if ( utc % 60 )
+      continue;
+    const time_t t = (time_t)utc;
+    struct tm tms;
+    char str[32];
+    gmtime_r( &t, &tms );
+    strftime( str, sizeof(str), "%Y-%m-%d %H:%M", &tms );
+    fprintf(stdout, "%14.3f frame  %12.3f s  %s UTC\n"
+           , syn.secondMarkFrame( sec ), syn.secondMarkFrame( sec ) / syn.SampleRate, str);
+  }
+  return 0;
+}
+